@@ -0,0 +1,170 @@
+/*
+ * Affinity.cc
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#include "Affinity.hh"
+
+#include <cstdio>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include "Parallel.hh"
+#include "Exec.hh"
+
+using namespace std;
+
+
+namespace Affinity {
+
+// upper limit on memory node numbers searched by cpuNode
+const int maxnodes = 64;
+
+#ifdef __linux__
+// the CPUs the process was started on, saved by init() before
+// any thread is pinned (pinning leaves the calling thread on
+// just one CPU)
+static cpu_set_t procset;
+static bool saved = false;
+#endif
+
+
+// memory node of a CPU, found from sysfs (-1 if unknown)
+static int cpuNode(const int cpu) {
+#ifdef __linux__
+    char path[80];
+    for (int n = 0; n < maxnodes; ++n) {
+        snprintf(path, sizeof(path),
+                "/sys/devices/system/cpu/cpu%d/node%d", cpu, n);
+        if (access(path, F_OK) == 0) return n;
+    }
+#endif
+    return -1;
+}
+
+
+void init() {
+#ifdef __linux__
+    saved = (sched_getaffinity(0, sizeof(procset), &procset) == 0);
+#endif
+}
+
+
+void pinThreads() {
+#ifdef __linux__
+    if (!saved) return;
+    vector<int> cpus;
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &procset)) cpus.push_back(c);
+    if (cpus.empty()) return;
+
+    const int nth = Exec::numThreads();
+    int first = 0;
+    if (Parallel::numdomains > 1) {
+        // in-process domains share the process's CPUs, in PE order
+        first = Parallel::mype * nth;
+    }
+#ifdef USE_MPI
+    else {
+        // ranks on a node which were started on the same CPUs share
+        // them, in node-local rank order; ranks the launcher has
+        // already bound to disjoint CPUs each start at their first
+        MPI_Comm nodecomm = Parallel::nodeComm();
+        int nodepe, numnodepe;
+        MPI_Comm_rank(nodecomm, &nodepe);
+        MPI_Comm_size(nodecomm, &numnodepe);
+        vector<cpu_set_t> sets(numnodepe);
+        MPI_Allgather(&procset, sizeof(cpu_set_t), MPI_BYTE,
+                &sets[0], sizeof(cpu_set_t), MPI_BYTE, nodecomm);
+        int numsharing = 0;
+        for (int pe = 0; pe < numnodepe; ++pe) {
+            cpu_set_t both;
+            CPU_AND(&both, &sets[pe], &procset);
+            if (CPU_COUNT(&both) == 0) continue;
+            if (pe < nodepe) first += nth;
+            numsharing += 1;
+        }
+        int over = (numsharing * nth > (int) cpus.size());
+        Parallel::globalMax(over);
+        if (over && Parallel::mype == 0)
+            cerr << "Warning:  more threads than CPUs on a node; "
+                 << "some threads are pinned to the same CPU" << endl;
+    }
+#endif
+    Exec::onEachThread([&](const int t) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[(first + t) % cpus.size()], &set);
+        // pid 0 means the calling thread
+        sched_setaffinity(0, sizeof(set), &set);
+    });
+#endif
+}
+
+
+void report() {
+    using Parallel::numpe;
+    using Parallel::mype;
+
+    // for each thread:  current CPU, its memory node, and the
+    // number of CPUs the thread may run on
+    const int nth = Exec::numThreads();
+    vector<int> info(3 * nth, -1);
+    Exec::onEachThread([&](const int t) {
+#ifdef __linux__
+        int cpu = sched_getcpu();
+        cpu_set_t set;
+        int ncpus = -1;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            ncpus = CPU_COUNT(&set);
+        info[3 * t] = cpu;
+        info[3 * t + 1] = cpuNode(cpu);
+        info[3 * t + 2] = ncpus;
+#endif
+    });
+
+    vector<int> nthpe(numpe);
+    Parallel::gather(nth, &nthpe[0]);
+    vector<int> numinfo(numpe), allinfo(1);
+    if (mype == 0) {
+        int ntot = 0;
+        for (int pe = 0; pe < numpe; ++pe) {
+            numinfo[pe] = 3 * nthpe[pe];
+            ntot += numinfo[pe];
+        }
+        allinfo.resize(ntot);
+    }
+    Parallel::gatherv(&info[0], 3 * nth, &allinfo[0], &numinfo[0]);
+
+    if (mype == 0) {
+        cout << "--- Thread Affinity ---" << endl;
+        int i = 0;
+        for (int pe = 0; pe < numpe; ++pe) {
+            for (int t = 0; t < nthpe[pe]; ++t) {
+                cout << "PE " << setw(4) << pe
+                     << "  thread " << setw(4) << t
+                     << ":  CPU " << setw(4) << allinfo[i]
+                     << "  node " << setw(2) << allinfo[i + 1]
+                     << "  (" << allinfo[i + 2] << " CPUs allowed)"
+                     << endl;
+                i += 3;
+            }
+        }
+        cout << "-----------------------" << endl;
+    }
+}
+
+
+}  // namespace Affinity
+
@@ -0,0 +1,39 @@
+/*
+ * Affinity.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef AFFINITY_HH_
+#define AFFINITY_HH_
+
+
+// Namespace Affinity provides functions to bind the threads of the
+// execution backend (see Exec.hh) to CPUs, and to report where
+// threads are running.  Binding is only
+// supported on Linux; elsewhere these functions do nothing.
+
+namespace Affinity {
+
+    // save the set of CPUs the process was started with; called
+    // once from main, before any in-process domains start
+    void init();
+
+    // pin each thread to a single CPU, taken in order from
+    // the set of CPUs the process was started with (so that an
+    // MPI launcher's binding of ranks is respected); threads wrap
+    // around if there are more threads than CPUs
+    void pinThreads();
+
+    // print the CPU and memory node of each thread on each PE
+    void report();
+
+}  // namespace Affinity
+
+
+#endif /* AFFINITY_HH_ */
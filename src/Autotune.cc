@@ -0,0 +1,453 @@
+/*
+ * Autotune.cc
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#include "Autotune.hh"
+
+#include <cstdlib>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include "Parallel.hh"
+#include "Exec.hh"
+#include "Affinity.hh"
+#include "InputFile.hh"
+#include "Mesh.hh"
+#include "Hydro.hh"
+#include "QCS.hh"
+
+using namespace std;
+
+
+namespace {
+
+// chunk sizes tried, in addition to the one from the input file
+const int stdsizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+
+double wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.e-6;
+}
+
+template <typename T>
+void saveArray(vector<T>& v, const T* ptr, const int n) {
+    v.assign(ptr, ptr + n);
+}
+
+template <typename T>
+void restoreArray(const vector<T>& v, T* ptr) {
+    copy(v.begin(), v.end(), ptr);
+}
+
+void saveArray(vector<double2>& v, double2cptr ptr, const int n) {
+    v.resize(n);
+    for (int i = 0; i < n; ++i)
+        v[i] = ptr[i];
+}
+
+#ifdef USE_SOA
+void restoreArray(const vector<double2>& v, double2ptr ptr) {
+    for (int i = 0; i < v.size(); ++i)
+        ptr[i] = v[i];
+}
+#endif
+
+}  // namespace
+
+
+Autotune::Autotune(const InputFile* inp, Mesh* m, Hydro* h)
+        : mesh(m), hydro(h), numtrials(0) {
+    using Parallel::mype;
+
+    mode = inp->getInt("autotune", 0);
+    ncycles = inp->getInt("autotunecycles", 3);
+    if (ncycles < 1) {
+        if (mype == 0)
+            cerr << "Error: bad autotunecycles " << ncycles << endl;
+        exit(1);
+    }
+    cachefile = inp->getString("autotunefile", "pennant.tune");
+    pinthreads = inp->getInt("pinthreads", 0);
+
+    // schedules only matter with more than one thread
+    if (Exec::numThreads() > 1) {
+#ifdef _OPENMP
+        schedules.push_back("omp");
+        schedules.push_back("ompdynamic");
+        schedules.push_back("ompguided");
+        schedules.push_back("tasks");
+#endif
+        schedules.push_back("pool");
+    }
+    // make sure the starting schedule is a candidate
+    string sched0 = (hydro->taskgraph ? "tasks" : Exec::name());
+    if (find(schedules.begin(), schedules.end(), sched0) ==
+            schedules.end())
+        schedules.push_back(sched0);
+
+    // use the same chunk sizes on all PEs, so that they all run
+    // the same number of trial cycles; sizes at least as big as
+    // the number of sides, points or zones all give a single
+    // chunk of that kind, so only try one
+    maxsizes[0] = mesh->nums;
+    maxsizes[1] = mesh->nump;
+    maxsizes[2] = mesh->numz;
+    int chunksize = mesh->chunksize;
+    Parallel::globalMax(chunksize);
+    for (int k = 0; k < 3; ++k) {
+        Parallel::globalMax(maxsizes[k]);
+        vector<int>& ksizes = sizes[k];
+        for (int i = 0; i < sizeof(stdsizes) / sizeof(int); ++i)
+            if (stdsizes[i] < maxsizes[k]) ksizes.push_back(stdsizes[i]);
+        if (chunksize > 0) ksizes.push_back(min(chunksize, maxsizes[k]));
+        ksizes.push_back(maxsizes[k]);
+        sort(ksizes.begin(), ksizes.end());
+        ksizes.erase(unique(ksizes.begin(), ksizes.end()), ksizes.end());
+    }
+
+    key = cacheKey();
+
+}
+
+
+Autotune::~Autotune() {}
+
+
+void Autotune::run(const double dt) {
+
+    Config cfg;
+    double tunetime = 0.;
+    bool cached = (mode == 1 && readCache(cfg));
+    if (!cached) {
+        double tbegin = wallTime();
+        saveState();
+        tune(dt, cfg);
+        restoreState();
+        tunetime = wallTime() - tbegin;
+        if (Parallel::mype == 0) writeCache(cfg);
+    }
+    apply(cfg);
+    report(cfg, cached, tunetime);
+
+}
+
+
+Autotune::Config Autotune::current() {
+
+    Config cfg;
+    cfg.schsize = mesh->schsize;
+    cfg.pchsize = mesh->pchsize;
+    cfg.zchsize = mesh->zchsize;
+    string sched = (hydro->taskgraph ? "tasks" : Exec::name());
+    cfg.sched = find(schedules.begin(), schedules.end(), sched) -
+            schedules.begin();
+    cfg.fusegeom = mesh->fusegeom;
+    cfg.fuseforce = hydro->fuseforce;
+    cfg.fuseqcs = hydro->qcs->fused;
+    return cfg;
+
+}
+
+
+void Autotune::apply(const Config& cfg) {
+
+    const bool rechunk = (cfg.schsize != mesh->schsize ||
+            cfg.pchsize != mesh->pchsize ||
+            cfg.zchsize != mesh->zchsize);
+    if (rechunk) {
+        mesh->setChunkSizes(cfg.schsize, cfg.pchsize, cfg.zchsize);
+        hydro->resetChunks();
+    }
+
+    // the task graph runs on OpenMP threads, with the default
+    // backend for everything else
+    const string& sched = schedules[cfg.sched];
+    const bool tasks = (sched == "tasks");
+    const string backend = (tasks ? "omp" : sched);
+    if (backend != Exec::name()) {
+        // only reached with more than one thread, so never with
+        // in-process domains, which share the backend
+        Exec::final();
+        Exec::select(backend);
+        Exec::init();
+        if (pinthreads) Affinity::pinThreads();
+        hydro->reserveScratch();
+    }
+    if (tasks != hydro->taskgraph) {
+        hydro->taskgraph = tasks;
+        hydro->resetChunks();
+    }
+
+    mesh->fusegeom = cfg.fusegeom;
+    hydro->fuseforce = cfg.fuseforce;
+    hydro->initForceArrays();
+    hydro->qcs->fused = cfg.fuseqcs;
+
+    // the old pages were placed for the old chunks; move them
+    // once the new chunks and backend are both in place
+    if (rechunk && mesh->firsttouch) {
+        mesh->redistribute();
+        hydro->redistribute();
+    }
+
+}
+
+
+double Autotune::timeConfig(const Config& cfg, const double dt) {
+
+    apply(cfg);
+    restoreState();
+
+    // one untimed cycle, to warm up caches and thread pools
+    hydro->doCycle(dt);
+    double tbegin = wallTime();
+    for (int i = 0; i < ncycles; ++i)
+        hydro->doCycle(dt);
+    double t = wallTime() - tbegin;
+
+    // the slowest PE sets the pace
+    Parallel::globalMax(t);
+    numtrials += 1;
+    return t;
+
+}
+
+
+void Autotune::tune(const double dt, Config& best) {
+
+    // chunk sizes past the caps give the same single chunk as
+    // the caps, so start from those
+    int Config::* kinds[] = {
+        &Config::schsize, &Config::pchsize, &Config::zchsize };
+    best = current();
+    for (int k = 0; k < 3; ++k)
+        best.*kinds[k] = min(best.*kinds[k], maxsizes[k]);
+    double tbest = timeConfig(best, dt);
+
+    // each stage starts from the best configuration so far,
+    // and changes one thing at a time
+    auto trial = [&](const Config& cfg) {
+        double t = timeConfig(cfg, dt);
+        if (t < tbest) {
+            tbest = t;
+            best = cfg;
+        }
+    };
+    Config cfg;
+
+    // 1. one size for all chunks (side chunks have the most
+    // candidates; the others are capped)
+    const Config cfg0 = best;
+    for (int i = 0; i < sizes[0].size(); ++i) {
+        cfg = best;
+        for (int k = 0; k < 3; ++k)
+            cfg.*kinds[k] = min(sizes[0][i], maxsizes[k]);
+        if (cfg.schsize == cfg0.schsize && cfg.pchsize == cfg0.pchsize &&
+                cfg.zchsize == cfg0.zchsize)
+            continue;
+        trial(cfg);
+    }
+
+    // 2. side, point and zone chunk sizes separately
+    for (int k = 0; k < 3; ++k) {
+        const int size0 = best.*kinds[k];
+        for (int i = 0; i < sizes[k].size(); ++i) {
+            if (sizes[k][i] == size0) continue;
+            cfg = best;
+            cfg.*kinds[k] = sizes[k][i];
+            trial(cfg);
+        }
+    }
+
+    // 3. thread schedule
+    const int sched0 = best.sched;
+    for (int i = 0; i < schedules.size(); ++i) {
+        if (i == sched0) continue;
+        cfg = best;
+        cfg.sched = i;
+        trial(cfg);
+    }
+
+    // 4. kernel variants (a structured mesh always uses the fused
+    // geometry kernel)
+    if (!mesh->structured) {
+        cfg = best;
+        cfg.fusegeom = !cfg.fusegeom;
+        trial(cfg);
+    }
+    cfg = best;
+    cfg.fuseforce = !cfg.fuseforce;
+    trial(cfg);
+    cfg = best;
+    cfg.fuseqcs = !cfg.fuseqcs;
+    trial(cfg);
+
+}
+
+
+void Autotune::saveState() {
+
+    const int nump = mesh->nump;
+    const int numz = mesh->numz;
+    const int nums = mesh->nums;
+
+    saveArray(spx, mesh->px, nump);
+    saveArray(spu, hydro->pu, nump);
+    saveArray(sex, mesh->ex, mesh->nume);
+    saveArray(szx, mesh->zx, numz);
+    saveArray(szr, hydro->zr, numz);
+    saveArray(sze, hydro->ze, numz);
+    saveArray(szetot, hydro->zetot, numz);
+    saveArray(szwrate, hydro->zwrate, numz);
+    saveArray(szp, hydro->zp, numz);
+    saveArray(szss, hydro->zss, numz);
+    saveArray(szvol, mesh->zvol, numz);
+    saveArray(szarea, mesh->zarea, numz);
+    saveArray(ssarea, mesh->sarea, nums);
+    saveArray(ssvol, mesh->svol, nums);
+
+}
+
+
+void Autotune::restoreState() {
+
+    restoreArray(spx, mesh->px);
+    restoreArray(spu, hydro->pu);
+    restoreArray(sex, mesh->ex);
+    restoreArray(szx, mesh->zx);
+    restoreArray(szr, hydro->zr);
+    restoreArray(sze, hydro->ze);
+    restoreArray(szetot, hydro->zetot);
+    restoreArray(szwrate, hydro->zwrate);
+    restoreArray(szp, hydro->zp);
+    restoreArray(szss, hydro->zss);
+    restoreArray(szvol, mesh->zvol);
+    restoreArray(szarea, mesh->zarea);
+    restoreArray(ssarea, mesh->sarea);
+    restoreArray(ssvol, mesh->svol);
+    hydro->resetDtHydro();
+
+}
+
+
+string Autotune::cacheKey() {
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host));
+    host[sizeof(host) - 1] = '\0';
+    int64_t gnumz = mesh->numz;
+    Parallel::globalSum(gnumz);
+
+    ostringstream oss;
+    oss << host << " " << Exec::numThreads() << " "
+        << Parallel::numpe << " " << gnumz;
+    return oss.str();
+
+}
+
+
+bool Autotune::readCache(Config& cfg) {
+
+    // PE 0 reads the file, and sends the result to the others:
+    // found flag, three chunk sizes, schedule, fusegeom, fuseforce,
+    // fuseqcs
+    int vals[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    if (Parallel::mype == 0) {
+        ifstream ifs(cachefile.c_str());
+        string line;
+        // the last entry for a key is the current one
+        while (getline(ifs, line)) {
+            istringstream iss(line);
+            string host, sched;
+            int nth, npe, s, p, z, fg, ff, fq;
+            int64_t nz;
+            if (!(iss >> host >> nth >> npe >> nz >> s >> p >> z
+                    >> sched >> fg >> ff >> fq))
+                continue;
+            ostringstream oss;
+            oss << host << " " << nth << " " << npe << " " << nz;
+            if (oss.str() != key) continue;
+            int i = find(schedules.begin(), schedules.end(), sched) -
+                    schedules.begin();
+            if (i == schedules.size() || s <= 0 || p <= 0 || z <= 0)
+                continue;
+            vals[0] = 1;
+            vals[1] = s;
+            vals[2] = p;
+            vals[3] = z;
+            vals[4] = i;
+            vals[5] = fg;
+            vals[6] = ff;
+            vals[7] = fq;
+        }
+    }
+    Parallel::broadcast(vals, 8);
+
+    cfg.schsize = vals[1];
+    cfg.pchsize = vals[2];
+    cfg.zchsize = vals[3];
+    cfg.sched = vals[4];
+    cfg.fusegeom = (vals[5] != 0);
+    cfg.fuseforce = (vals[6] != 0);
+    cfg.fuseqcs = (vals[7] != 0);
+    return vals[0] != 0;
+
+}
+
+
+void Autotune::writeCache(const Config& cfg) {
+
+    ofstream ofs(cachefile.c_str(), ios::app);
+    if (!ofs) {
+        cerr << "Warning: can't write autotune file " << cachefile
+             << endl;
+        return;
+    }
+    ofs << key << " " << cfg.schsize << " " << cfg.pchsize
+        << " " << cfg.zchsize << " " << schedules[cfg.sched]
+        << " " << (cfg.fusegeom ? 1 : 0)
+        << " " << (cfg.fuseforce ? 1 : 0)
+        << " " << (cfg.fuseqcs ? 1 : 0) << endl;
+
+}
+
+
+void Autotune::report(
+        const Config& cfg,
+        const bool cached,
+        const double tunetime) {
+
+    if (Parallel::mype > 0) return;
+
+    cout << "--- Autotune ---" << endl;
+    cout << "Chunk sizes:  " << cfg.schsize << " (sides), "
+         << cfg.pchsize << " (points), " << cfg.zchsize << " (zones)"
+         << endl;
+    cout << "Schedule:  " << schedules[cfg.sched] << endl;
+    cout << "Fused geometry:  " << (cfg.fusegeom ? "yes" : "no") << endl;
+    cout << "Fused force:  " << (cfg.fuseforce ? "yes" : "no") << endl;
+    cout << "One-pass QCS:  " << (cfg.fuseqcs ? "yes" : "no") << endl;
+    if (cached)
+        cout << "Read from " << cachefile << endl;
+    else
+        cout << "Tuned with " << numtrials << " trials in "
+             << fixed << setprecision(3) << tunetime << " s, saved to "
+             << cachefile << endl;
+    cout << "----------------" << endl;
+    cout.unsetf(ios::floatfield);
+
+}
+
@@ -0,0 +1,104 @@
+/*
+ * Autotune.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef AUTOTUNE_HH_
+#define AUTOTUNE_HH_
+
+#include <string>
+#include <vector>
+
+#include "Vec2.hh"
+
+// forward declarations
+class InputFile;
+class Mesh;
+class Hydro;
+
+
+// Class Autotune picks the chunk sizes, thread schedule and kernel
+// variant that give the fastest hydro cycle, by timing a few
+// cycles with each candidate before the run starts.  The mesh and
+// hydro state are saved first and restored afterwards, so the run
+// itself is unchanged except for its speed.  Results are cached in
+// a file, keyed by host, thread count, number of PEs and number of
+// zones, so that later runs of the same size start tuned.
+
+class Autotune {
+public:
+
+    // one point in the search space
+    struct Config {
+        int schsize;            // side chunk size
+        int pchsize;            // point chunk size
+        int zchsize;            // zone chunk size
+        int sched;              // index into schedules
+        bool fusegeom;          // use fused geometry kernel?
+        bool fuseforce;         // use fused force kernel?
+        bool fuseqcs;           // use one-pass QCS kernel?
+    };
+
+    // associated mesh and hydro objects
+    Mesh* mesh;
+    Hydro* hydro;
+
+    int mode;                   // 1:  use cached result if there
+                                // is one, 2:  always tune
+    int ncycles;                // number of timed cycles per trial
+    std::string cachefile;      // name of cache file
+    std::string key;            // key for this run in cache file
+    bool pinthreads;            // re-pin threads when the execution
+                                // backend is restarted?
+
+    std::vector<std::string> schedules;
+                                // candidate schedules:  execution
+                                // backends, plus "tasks" for the
+                                // task graph
+    std::vector<int> sizes[3];  // candidate chunk sizes for side,
+                                // point and zone chunks, each
+                                // capped at the number of sides,
+                                // points or zones
+    int maxsizes[3];            // those caps (largest over PEs)
+    int numtrials;              // number of configurations timed
+
+    Autotune(const InputFile* inp, Mesh* m, Hydro* h);
+    ~Autotune();
+
+    // choose a configuration, using the cache or by timing cycles
+    // with the given timestep, then apply it and report it
+    void run(const double dt);
+
+private:
+
+    // saved mesh and hydro state
+    std::vector<double2> spx, spu, sex, szx;
+    std::vector<double> szr, sze, szetot, szwrate, szp, szss;
+    std::vector<double> szvol, szarea, ssarea, ssvol;
+
+    Config current();
+    void apply(const Config& cfg);
+    double timeConfig(const Config& cfg, const double dt);
+    void tune(const double dt, Config& best);
+
+    void saveState();
+    void restoreState();
+
+    // find the key (must be called on all PEs)
+    std::string cacheKey();
+    bool readCache(Config& cfg);
+    void writeCache(const Config& cfg);
+
+    void report(const Config& cfg, const bool cached,
+            const double tunetime);
+
+}; // class Autotune
+
+
+#endif /* AUTOTUNE_HH_ */
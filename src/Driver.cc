@@ -13,20 +13,21 @@
 #include "Driver.hh"
 
 #include <cstdlib>
-#include <cstring>
 #include <sys/time.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
-#ifdef _OPENMP
-#include "omp.h"
-#endif
+#include <algorithm>
 
 #include "Parallel.hh"
+#include "Exec.hh"
+#include "Affinity.hh"
+#include "Autotune.hh"
 #include "InputFile.hh"
 #include "Mesh.hh"
 #include "Hydro.hh"
+#include "Simd.hh"
 
 using namespace std;
 
@@ -36,6 +37,24 @@ Driver::Driver(const InputFile* inp, const string& pname)
     using Parallel::numpe;
     using Parallel::mype;
 
+    // the task graph runs on OpenMP threads, so the loops around
+    // it, thread pinning, first touch and the scratch arenas must
+    // use them too
+#ifdef _OPENMP
+    if (inp->getInt("taskgraph", 0) &&
+            (Exec::backend == Exec::pool ||
+             Exec::backend == Exec::serial)) {
+        if (mype == 0)
+            cerr << "Error:  taskgraph requires an OpenMP exec backend"
+                 << endl;
+        exit(1);
+    }
+#endif
+
+    // start the threads first, so that the thread count is known;
+    // the backend was selected in main
+    Exec::init();
+
     if (mype == 0) {
         cout << "********************" << endl;
         cout << "Running PENNANT v0.9" << endl;
@@ -43,14 +62,23 @@ Driver::Driver(const InputFile* inp, const string& pname)
         cout << endl;
 
 #ifdef USE_MPI
-        cout << "Running on " << numpe << " MPI PE(s)" << endl;
+        if (Parallel::numdomains == 1)
+            cout << "Running on " << numpe << " MPI PE(s)" << endl;
 #endif
-#ifdef _OPENMP
-        cout << "Running on " << omp_get_max_threads() << " thread(s)"
+        if (Parallel::numdomains > 1)
+            cout << "Running on " << numpe << " in-process domain(s)"
+                 << endl;
+        cout << "Running on " << Exec::numThreads() << " thread(s)"
              << endl;
-#endif
+        cout << "Execution backend:  " << Exec::name() << endl;
+        cout << "SIMD instructions:  " << Simd::name << endl;
     }  // if mype == 0
 
+    // bind threads before any arrays are allocated, so that
+    // first-touch page placement stays valid
+    if (inp->getInt("pinthreads", 0)) Affinity::pinThreads();
+    if (inp->getInt("affinity", 0)) Affinity::report();
+
     cstop = inp->getInt("cstop", 999999);
     tstop = inp->getDouble("tstop", 1.e99);
     if (cstop == 999999 && tstop == 1.e99) {
@@ -62,25 +90,42 @@ Driver::Driver(const InputFile* inp, const string& pname)
     dtinit = inp->getDouble("dtinit", 1.e99);
     dtfac = inp->getDouble("dtfac", 1.2);
     dtreport = inp->getInt("dtreport", 10);
+    benchhalo = inp->getInt("benchhalo", 0);
+    dtspec = inp->getInt("dtspec", 0);
+    dtasync = dtspec || inp->getInt("dtasync", 0);
 
     // initialize mesh, hydro
     mesh = new Mesh(inp);
     hydro = new Hydro(inp, mesh);
 
+    // choose chunk sizes, schedule and kernels, timing trial
+    // cycles with the first cycle's timestep
+    if (inp->getInt("autotune", 0)) {
+        Autotune tuner(inp, mesh, hydro);
+        tuner.run(min(min(dtmax, dtinit), tstop));
+    }
+
 }
 
 Driver::~Driver() {
 
     delete hydro;
     delete mesh;
+    Exec::final();
 
 }
 
 void Driver::run() {
     using Parallel::mype;
 
+    if (benchhalo > 0) {
+        mesh->benchHalo(benchhalo);
+        return;
+    }
+
     time = 0.0;
     cycle = 0;
+    numspechit = numspecmiss = 0;
 
     // do energy check
     hydro->writeEnergyCheck();
@@ -99,14 +144,28 @@ void Driver::run() {
 
         cycle += 1;
 
-        // get timestep
-        calcGlobalDt();
+        // get timestep; with dtasync, its reduction over PEs was
+        // started at the end of the last cycle
+        if (!dtasync || cycle == 1) startGlobalDt(cycle);
+        else if (dtspec) hydro->speculate(dtlocal);
+        finishGlobalDt();
+        if (dtspec && cycle > 1) {
+            if (dt == dtlocal)
+                numspechit += 1;
+            else
+                numspecmiss += 1;
+        }
 
         // begin hydro cycle
         hydro->doCycle(dt);
 
         time += dt;
 
+        // start the next cycle's reduction, to run during the
+        // report below
+        if (dtasync && cycle < cstop && time < tstop)
+            startGlobalDt(cycle + 1);
+
         if (mype == 0 &&
                 (cycle == 1 || cycle % dtreport == 0)) {
             struct timeval scurr;
@@ -126,6 +185,19 @@ void Driver::run() {
 
     } // while cycle...
 
+    // the speculation pays off on a PE only when it has the global
+    // minimum timestep (or ties it)
+    int numspec = numspechit + numspecmiss;
+    int minhit = numspechit, maxhit = numspechit;
+    if (dtspec) {
+        Parallel::globalSum(numspechit);
+        Parallel::globalSum(numspecmiss);
+        minhit = -minhit;
+        Parallel::globalMax(minhit);
+        minhit = -minhit;
+        Parallel::globalMax(maxhit);
+    }
+
     if (mype == 0) {
 
         // get stopping timestamp
@@ -148,6 +220,17 @@ void Driver::run() {
         cout << "hydro cycle run time= " << setw(14) << runtime << endl;
         cout << "************************************" << endl;
 
+        if (dtspec && numspec > 0) {
+            cout << endl;
+            cout << fixed << setprecision(1);
+            cout << "Speculative predictor:  " << numspechit
+                 << " hits, " << numspecmiss << " misses ("
+                 << 100. * numspechit / (numspechit + numspecmiss)
+                 << "% hits over all PEs)" << endl;
+            cout << "Hits per PE:  min " << 100. * minhit / numspec
+                 << "%, max " << 100. * maxhit / numspec << "%" << endl;
+        }
+
     } // if mype
 
     // do energy check
@@ -160,73 +243,83 @@ void Driver::run() {
 }
 
 
-void Driver::calcGlobalDt() {
-
-    using Parallel::mype;
+void Driver::startGlobalDt(const int cyc) {
 
-    // Save timestep from last cycle
-    dtlast = dt;
-    msgdtlast = msgdt;
+    // The limits are found from the current timestep, and the new
+    // one only replaces it in finishGlobalDt, so that it can still
+    // be reported in between.
+    double dtnew = dtmax;
+    msgdtnew = "Global maximum (dtmax)";
 
-    // Compute timestep for this cycle
-    dt = dtmax;
-    msgdt = "Global maximum (dtmax)";
-
-    if (cycle == 1) {
+    if (cyc == 1) {
         // compare to initial timestep
-        if (dtinit < dt) {
-            dt = dtinit;
-            msgdt = "Initial timestep";
+        if (dtinit < dtnew) {
+            dtnew = dtinit;
+            msgdtnew = "Initial timestep";
         }
     } else {
         // compare to factor * previous timestep
-        double dtrecover = dtfac * dtlast;
-        if (dtrecover < dt) {
-            dt = dtrecover;
-            if (msgdtlast.substr(0, 8) == "Recovery")
-                msgdt = msgdtlast;
+        double dtrecover = dtfac * dt;
+        if (dtrecover < dtnew) {
+            dtnew = dtrecover;
+            if (msgdt.substr(0, 8) == "Recovery")
+                msgdtnew = msgdt;
             else
-                msgdt = "Recovery: " + msgdtlast;
+                msgdtnew = "Recovery: " + msgdt;
         }
     }
 
     // compare to time-to-end
-    if ((tstop - time) < dt) {
-        dt = tstop - time;
-        msgdt = "Global (tstop - time)";
+    if ((tstop - time) < dtnew) {
+        dtnew = tstop - time;
+        msgdtnew = "Global (tstop - time)";
     }
 
     // compare to hydro dt
-    hydro->getDtHydro(dt, msgdt);
+    Hydro::DtReason why;
+    bool byhydro = hydro->getDtHydro(dtnew, msgdtnew, why);
+
+    // the reduction carries the hydro reason, so that the PE with
+    // the minimum doesn't have to send its message separately
+    dtlocal = dtnew;
+    dtmin.x = dtnew;
+    dtmin.info[0] = (byhydro ? why.kind : -1);
+    dtmin.info[1] = (byhydro ? why.zone : -1);
+    if (dtasync)
+        Parallel::startGlobalMinLoc(dtmin);
+    else
+        Parallel::globalMinLoc(dtmin);
 
-#ifdef USE_MPI
-    int pedt;
-    Parallel::globalMinLoc(dt, pedt);
-
-    // if the global min isn't on this PE, get the right message
-    if (pedt > 0) {
-        const int tagmpi = 300;
-        if (mype == pedt) {
-            char cmsgdt[80];
-            strncpy(cmsgdt, msgdt.c_str(), 80);
-            MPI_Send(cmsgdt, 80, MPI_CHAR, 0, tagmpi,
-                    MPI_COMM_WORLD);
-        }
-        else if (mype == 0) {
-            char cmsgdt[80];
-            MPI_Status status;
-            MPI_Recv(cmsgdt, 80, MPI_CHAR, pedt, tagmpi,
-                    MPI_COMM_WORLD, &status);
-            cmsgdt[79] = '\0';
-            msgdt = string(cmsgdt);
-        }
-    }  // if pedt > 0
+}
 
+
+void Driver::finishGlobalDt() {
+
+    using Parallel::mype;
+
+    if (dtasync) Parallel::finishGlobalMinLoc();
+
+    // Save timestep from last cycle
+    dtlast = dt;
+    msgdtlast = msgdt;
+    dt = dtmin.x;
+    msgdt = msgdtnew;
+
+    // if the global min isn't on this PE, get the right message;
+    // other limits are the same on all PEs
+    if (dtmin.pe != mype && dtmin.info[0] >= 0) {
+        Hydro::DtReason why;
+        why.kind = dtmin.info[0];
+        why.zone = dtmin.info[1];
+        msgdt = Hydro::dtMessage(why);
+    }
+
+#ifdef USE_MPI
     // if timestep was determined by hydro, report which PE
     // caused it
     if (mype == 0 && msgdt.substr(0, 5) == "Hydro") {
         ostringstream oss;
-        oss << "PE " << pedt << ", " << msgdt;
+        oss << "PE " << dtmin.pe << ", " << msgdt;
         msgdt = oss.str();
     }
 #endif
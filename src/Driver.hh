@@ -15,6 +15,8 @@
 
 #include <string>
 
+#include "Parallel.hh"
+
 // forward declarations
 class InputFile;
 class Mesh;
@@ -37,16 +39,37 @@ public:
     double dtinit;                 // initial timestep size
     double dtfac;                  // factor limiting timestep growth
     int dtreport;                  // frequency for timestep reports
+    int benchhalo;                 // if > 0, just run this many sums
+                                   // in the halo exchange benchmark
+    bool dtasync;                  // start the global timestep
+                                   // reduction at the end of each
+                                   // cycle?
+    bool dtspec;                   // run the next predictor with this
+                                   // PE's timestep while the reduction
+                                   // is going on?  (implies dtasync)
+    int numspechit, numspecmiss;   // cycles where the speculative
+                                   // timestep was or wasn't right
     double dt;                     // current timestep
     double dtlast;                 // previous timestep
     std::string msgdt;             // dt limiter message
     std::string msgdtlast;         // previous dt limiter message
+    double dtlocal;                // timestep on this PE, for the
+                                   // timestep being found
+    std::string msgdtnew;          // dt limiter message on this PE,
+                                   // for the timestep being found
+    Parallel::MinLoc dtmin;        // timestep reduction over PEs:  dt,
+                                   // and reason from the hydro (kind
+                                   // and zone, or -1 if not hydro)
 
     Driver(const InputFile* inp, const std::string& pname);
     ~Driver();
 
     void run();
-    void calcGlobalDt();
+
+    // find the timestep for cycle cyc, in two steps, so that the
+    // reduction over PEs can overlap other work
+    void startGlobalDt(const int cyc);
+    void finishGlobalDt();
 
 };  // class Driver
 
@@ -0,0 +1,372 @@
+/*
+ * Exec.cc
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#include "Exec.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "Parallel.hh"
+
+using namespace std;
+
+
+namespace Exec {
+
+Backend backend = ompStatic;
+
+
+namespace {
+
+// Class ThreadPool runs loops on a fixed set of std::threads: the
+// calling thread plus numth - 1 workers, which wait between loops.
+// Each thread starts with the same contiguous block of indices
+// that an OpenMP static schedule would give it (so that first-touch
+// page placement matches), and takes indices from the front of its
+// block one at a time.  A thread that runs out steals the back
+// half of the remaining indices of another thread.
+
+class ThreadPool {
+public:
+
+    explicit ThreadPool(const int nth);
+    ~ThreadPool();
+
+    int numThreads() const { return numth; }
+
+    // run fn(ctx, i) for 0 <= i < n, returning when all are done
+    void run(const int n, LoopFn fn, const void* ctx);
+
+    // run fn(ctx, t) once on each thread t
+    void runOnEach(LoopFn fn, const void* ctx);
+
+private:
+
+    // remaining indices of one thread, [first, last); padded to a
+    // cache line so that threads don't share them
+    struct Range {
+        mutex lock;
+        int first;
+        int last;
+        char pad[64];
+    };
+
+    int numth;
+    vector<thread> workers;
+    vector<Range> ranges;
+
+    // the current job; gen is advanced to start one
+    mutex joblock;
+    condition_variable jobcond;
+    long gen;
+    bool stopping;
+    bool oneach;
+    LoopFn jobfn;
+    const void* jobctx;
+    atomic<int> nbusy;          // workers still in the current job
+
+    void workerMain(const int t);
+    void work(const int t);
+    bool pop(const int t, int& i);
+    bool steal(const int t);
+
+};  // class ThreadPool
+
+
+// the pool of the calling thread; each in-process domain (see
+// Parallel::runDomains) has its own
+thread_local ThreadPool* threadpool = NULL;
+
+// true on a thread while it is running a pool loop, so that
+// nested loops run serially instead of waiting on the pool
+thread_local bool inpool = false;
+
+
+ThreadPool::ThreadPool(const int nth)
+        : numth(nth), ranges(nth), gen(0), stopping(false),
+          oneach(false), jobfn(NULL), jobctx(NULL), nbusy(0) {
+
+    for (int t = 1; t < numth; ++t)
+        workers.push_back(thread(&ThreadPool::workerMain, this, t));
+
+}
+
+
+ThreadPool::~ThreadPool() {
+
+    {
+        lock_guard<mutex> lk(joblock);
+        stopping = true;
+    }
+    jobcond.notify_all();
+    for (int t = 0; t < workers.size(); ++t)
+        workers[t].join();
+
+}
+
+
+void ThreadPool::run(const int n, LoopFn fn, const void* ctx) {
+
+    // split the indices as an OpenMP static schedule would
+    const int q = n / numth;
+    const int r = n % numth;
+    int first = 0;
+    for (int t = 0; t < numth; ++t) {
+        int len = q + (t < r ? 1 : 0);
+        ranges[t].first = first;
+        ranges[t].last = first + len;
+        first += len;
+    }
+
+    {
+        lock_guard<mutex> lk(joblock);
+        jobfn = fn;
+        jobctx = ctx;
+        oneach = false;
+        nbusy = numth - 1;
+        gen += 1;
+    }
+    jobcond.notify_all();
+
+    inpool = true;
+    work(0);
+    inpool = false;
+
+    // a worker only leaves the job when there are no indices
+    // left anywhere and its own are done
+    while (nbusy.load() > 0)
+        this_thread::yield();
+
+}
+
+
+void ThreadPool::runOnEach(LoopFn fn, const void* ctx) {
+
+    {
+        lock_guard<mutex> lk(joblock);
+        jobfn = fn;
+        jobctx = ctx;
+        oneach = true;
+        nbusy = numth - 1;
+        gen += 1;
+    }
+    jobcond.notify_all();
+
+    fn(ctx, 0);
+    while (nbusy.load() > 0)
+        this_thread::yield();
+
+}
+
+
+void ThreadPool::workerMain(const int t) {
+
+    long mygen = 0;
+    for (;;) {
+        {
+            unique_lock<mutex> lk(joblock);
+            while (gen == mygen && !stopping)
+                jobcond.wait(lk);
+            if (stopping) return;
+            mygen = gen;
+        }
+        inpool = true;
+        if (oneach)
+            jobfn(jobctx, t);
+        else
+            work(t);
+        inpool = false;
+        nbusy -= 1;
+    }
+
+}
+
+
+void ThreadPool::work(const int t) {
+
+    int i;
+    do {
+        while (pop(t, i))
+            jobfn(jobctx, i);
+    } while (steal(t));
+
+}
+
+
+bool ThreadPool::pop(const int t, int& i) {
+
+    Range& rg = ranges[t];
+    lock_guard<mutex> lk(rg.lock);
+    if (rg.first >= rg.last) return false;
+    i = rg.first;
+    rg.first += 1;
+    return true;
+
+}
+
+
+bool ThreadPool::steal(const int t) {
+
+    for (int k = 1; k < numth; ++k) {
+        Range& victim = ranges[(t + k) % numth];
+        int first, last;
+        {
+            lock_guard<mutex> lk(victim.lock);
+            int len = victim.last - victim.first;
+            if (len <= 0) continue;
+            last = victim.last;
+            first = last - (len + 1) / 2;
+            victim.last = first;
+        }
+        // only this thread adds to its own range, and it's empty
+        Range& rg = ranges[t];
+        lock_guard<mutex> lk(rg.lock);
+        rg.first = first;
+        rg.last = last;
+        return true;
+    }
+    return false;
+
+}
+
+
+#ifndef _OPENMP
+int envThreads() {
+
+    const char* s = getenv("OMP_NUM_THREADS");
+    int n = (s != NULL ? atoi(s) : 0);
+    if (n <= 0) n = thread::hardware_concurrency();
+    return (n > 0 ? n : 1);
+
+}
+#endif
+
+}  // namespace
+
+
+void select(const string& name) {
+    using Parallel::mype;
+
+    if (name == "omp")
+        backend = ompStatic;
+    else if (name == "ompdynamic")
+        backend = ompDynamic;
+    else if (name == "ompguided")
+        backend = ompGuided;
+    else if (name == "pool")
+        backend = pool;
+    else if (name == "serial")
+        backend = serial;
+    else {
+        if (mype == 0)
+            cerr << "Error:  invalid exec " << name << endl;
+        exit(1);
+    }
+
+#ifndef _OPENMP
+    if (backend == ompStatic ||
+            backend == ompDynamic ||
+            backend == ompGuided) {
+        // no OpenMP in this build
+        backend = serial;
+    }
+#endif
+
+}
+
+
+void init() {
+
+#ifdef _OPENMP
+    // chunks are already large units of work, so the dynamic
+    // schedules hand them out one at a time; the schedule is
+    // per thread, so each domain sets its own
+    if (backend == ompDynamic) omp_set_schedule(omp_sched_dynamic, 1);
+    if (backend == ompGuided) omp_set_schedule(omp_sched_guided, 1);
+#endif
+
+    if (backend == pool) {
+#ifdef _OPENMP
+        int nth = omp_get_max_threads();
+#else
+        int nth = envThreads();
+#endif
+        // in-process domains each run on one thread
+        if (Parallel::numdomains > 1) nth = 1;
+        threadpool = new ThreadPool(nth);
+    }
+
+}
+
+
+void final() {
+
+    delete threadpool;
+    threadpool = NULL;
+
+}
+
+
+const char* name() {
+
+    switch (backend) {
+    case ompStatic:  return "omp";
+    case ompDynamic: return "ompdynamic";
+    case ompGuided:  return "ompguided";
+    case pool:       return "pool";
+    default:         return "serial";
+    }
+
+}
+
+
+int numThreads() {
+
+    switch (backend) {
+#ifdef _OPENMP
+    case ompStatic:
+    case ompDynamic:
+    case ompGuided:
+        return omp_get_max_threads();
+#endif
+    case pool:
+        return threadpool->numThreads();
+    default:
+        return 1;
+    }
+
+}
+
+
+void poolFor(const int n, LoopFn fn, const void* ctx) {
+
+    if (inpool || threadpool->numThreads() == 1) {
+        for (int i = 0; i < n; ++i) fn(ctx, i);
+        return;
+    }
+    threadpool->run(n, fn, ctx);
+
+}
+
+
+void poolOnEach(LoopFn fn, const void* ctx) {
+
+    threadpool->runOnEach(fn, ctx);
+
+}
+
+
+}  // namespace Exec
+
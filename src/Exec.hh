@@ -0,0 +1,217 @@
+/*
+ * Exec.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef EXEC_HH_
+#define EXEC_HH_
+
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// Namespace Exec runs loops over chunks in parallel, using one of
+// several execution backends selected at run time:
+//
+//   omp         OpenMP, static schedule (the default)
+//   ompdynamic  OpenMP, dynamic schedule
+//   ompguided   OpenMP, guided schedule
+//   pool        a pool of std::threads with work stealing
+//   serial      the calling thread only
+//
+// The OpenMP backends are only available when built with OpenMP.
+// All backends give the same results, since loop bodies only write
+// to their own chunk's data, and reductions are combined in index
+// order.
+
+namespace Exec {
+
+    enum Backend {
+        ompStatic,
+        ompDynamic,
+        ompGuided,
+        pool,
+        serial
+    };
+
+    extern Backend backend;     // backend in use
+
+    // select the backend by name.  The backend is shared by all
+    // in-process domains, so this is called once, before they
+    // start (or, by the autotuner, when there is only one).
+    void select(const std::string& name);
+
+    // start the backend's threads for the calling domain; the
+    // number of threads is taken from OMP_NUM_THREADS (or the
+    // OpenMP default) for all backends except serial, or is one
+    // with in-process domains
+    void init();
+    void final();               // stop the backend's threads
+
+    const char* name();         // name of the backend in use
+    int numThreads();           // number of threads it uses
+
+    // run body(i) for 0 <= i < n, in parallel.  With the OpenMP
+    // backends, if called from inside a team region, the loop is
+    // shared among the threads of the team; otherwise a new team
+    // is started.
+    template <typename F>
+    void parallelFor(const int n, const F& body);
+
+    // return the sum of init and body(i) for 0 <= i < n; the
+    // terms are evaluated in parallel but always added in index
+    // order, so the result is the same for every backend.  Inside
+    // a team region, all threads must call it, and all get the sum.
+    template <typename T, typename F>
+    T parallelReduce(const int n, const T& init, const F& body);
+
+    // run body(t) once on each thread t of the backend, e.g. to
+    // set up thread-local state
+    template <typename F>
+    void onEachThread(const F& body);
+
+    // run body() as a team region.  With the OpenMP backends, all
+    // threads run body(), and the loops started in it by
+    // parallelFor are worksharing loops, so the team only forks
+    // once; OpenMP constructs such as master and barrier may be
+    // used in body().  With the others, body() runs on the
+    // calling thread, and the loops in it are started as usual.
+    template <typename F>
+    void team(const F& body);
+
+    // implementation functions for the templates above
+    typedef void (*LoopFn)(const void* ctx, const int i);
+    void poolFor(const int n, LoopFn fn, const void* ctx);
+    void poolOnEach(LoopFn fn, const void* ctx);
+
+    template <typename F>
+    void callBody(const void* ctx, const int i) {
+        (*static_cast<const F*>(ctx))(i);
+    }
+
+}  // namespace Exec
+
+
+template <typename F>
+void Exec::parallelFor(const int n, const F& body) {
+
+    switch (backend) {
+#ifdef _OPENMP
+    case ompStatic:
+        if (omp_get_level() == 0) {
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < n; ++i) body(i);
+        }
+        else {
+            #pragma omp for schedule(static)
+            for (int i = 0; i < n; ++i) body(i);
+        }
+        break;
+    case ompDynamic:
+    case ompGuided:
+        // the schedule kind was set by init()
+        if (omp_get_level() == 0) {
+            #pragma omp parallel for schedule(runtime)
+            for (int i = 0; i < n; ++i) body(i);
+        }
+        else {
+            #pragma omp for schedule(runtime)
+            for (int i = 0; i < n; ++i) body(i);
+        }
+        break;
+#endif
+    case pool:
+        poolFor(n, &callBody<F>, &body);
+        break;
+    default:
+        for (int i = 0; i < n; ++i) body(i);
+        break;
+    }
+
+}
+
+
+template <typename T, typename F>
+T Exec::parallelReduce(const int n, const T& init, const F& body) {
+
+    std::vector<T> local;
+    std::vector<T>* terms = &local;
+#ifdef _OPENMP
+    // inside a team region, all threads must fill in the terms of
+    // one vector:  use the one allocated by the single thread
+    const bool inteam = (backend != pool && backend != serial &&
+            omp_get_level() > 0);
+    if (inteam) {
+        #pragma omp single copyprivate(terms)
+        {
+            local.resize(n);
+            terms = &local;
+        }
+    }
+    else
+#endif
+        local.resize(n);
+    parallelFor(n, [&](const int i) { (*terms)[i] = body(i); });
+    T sum = init;
+    for (int i = 0; i < n; ++i)
+        sum += (*terms)[i];
+#ifdef _OPENMP
+    // the vector must outlive every thread's sum
+    if (inteam) {
+        #pragma omp barrier
+    }
+#endif
+    return sum;
+
+}
+
+
+template <typename F>
+void Exec::onEachThread(const F& body) {
+
+    switch (backend) {
+#ifdef _OPENMP
+    case ompStatic:
+    case ompDynamic:
+    case ompGuided:
+        #pragma omp parallel
+        body(omp_get_thread_num());
+        break;
+#endif
+    case pool:
+        poolOnEach(&callBody<F>, &body);
+        break;
+    default:
+        body(0);
+        break;
+    }
+
+}
+
+
+template <typename F>
+void Exec::team(const F& body) {
+
+#ifdef _OPENMP
+    if (backend == ompStatic || backend == ompDynamic ||
+            backend == ompGuided) {
+        #pragma omp parallel
+        body();
+        return;
+    }
+#endif
+    body();
+
+}
+
+
+#endif /* EXEC_HH_ */
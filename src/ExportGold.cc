@@ -121,7 +121,9 @@ void ExportGold::writeGeoFile(
 
     // gather node info to PE 0
     const int nump = mesh->nump;
-    const double2* px = mesh->px;
+    vector<double2> px(nump);
+    for (int p = 0; p < nump; ++p)
+        px[p] = mesh->px[p];
 
     int gnump = nump;
     Parallel::globalSum(gnump);
@@ -149,7 +151,6 @@ void ExportGold::writeGeoFile(
     } // if mype
 
     const int* znump = mesh->znump;
-    const int* mapsp1 = mesh->mapsp1;
 
     const int ntris = tris.size();
     const int nquads = quads.size();
@@ -182,7 +183,7 @@ void ExportGold::writeGeoFile(
         int z = tris[t];
         int sbase = mapzs[z];
         for (int i = 0; i < 3; ++i) {
-            trip[t * 3 + i] = mapsp1[sbase + i] + offset;
+            trip[t * 3 + i] = mesh->sidePoint1Any(sbase + i) + offset;
         }
     }
     Parallel::gatherv(&trip[0], 3 * ntris, &gtrip[0], &pesizes[0]);
@@ -212,7 +213,7 @@ void ExportGold::writeGeoFile(
         int z = quads[q];
         int sbase = mapzs[z];
         for (int i = 0; i < 4; ++i) {
-            quadp[q * 4 + i] = mapsp1[sbase + i] + offset;
+            quadp[q * 4 + i] = mesh->sidePoint1Any(sbase + i) + offset;
         }
     }
     Parallel::gatherv(&quadp[0], 4 * nquads, &gquadp[0], &pesizes[0]);
@@ -239,7 +240,7 @@ void ExportGold::writeGeoFile(
         int sbase = mapzs[z];
         othernump[n] = znump[z];
         for (int i = 0; i < znump[z]; ++i) {
-            otherp.push_back(mapsp1[sbase + i] + offset);
+            otherp.push_back(mesh->sidePoint1Any(sbase + i) + offset);
         }
     }
     Parallel::gatherv(&othernump[0], nothers, &gothernump[0], &penothers[0]);
@@ -358,18 +359,23 @@ void ExportGold::sortZones() {
 
     mapzs.resize(numz);
 
-    // sort zones by size, create an inverse map
+    // sort zones by size, create an inverse map; ghost zones
+    // are written by the PEs that own them
     int scount = 0;
+    int r = 0;
     for (int z = 0; z < numz; ++z) {
         int zsize = znump[z];
+        mapzs[z] = scount;
+        scount += zsize;
+        while (r < mesh->ownzlast.size() && mesh->ownzlast[r] <= z) ++r;
+        if (r == mesh->ownzlast.size() || mesh->ownzfirst[r] > z)
+            continue;
         if (zsize == 3)
             tris.push_back(z);
         else if (zsize == 4)
             quads.push_back(z);
         else // zsize > 4
             others.push_back(z);
-        mapzs[z] = scount;
-        scount += zsize;
     } // for z
 
 }
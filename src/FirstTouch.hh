@@ -0,0 +1,144 @@
+/*
+ * FirstTouch.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef FIRSTTOUCH_HH_
+#define FIRSTTOUCH_HH_
+
+#include "Memory.hh"
+#include "Vec2Ptr.hh"
+#include "Exec.hh"
+
+
+// Functions touch, touch2 and distribute place the pages of an
+// array on NUMA systems, using the first-touch policy of the OS:
+// each chunk's range of the array is first written by the thread
+// that will process that chunk, so its pages are allocated on
+// that thread's memory node.  Chunks are assigned to threads by
+// the same execution backend as the chunk loops in the physics.
+
+namespace Memory {
+
+// zero each chunk's range of a newly allocated array
+template<typename T>
+inline void touch(
+        T* ptr,
+        const int* chfirst,
+        const int* chlast,
+        const int numch) {
+    Exec::parallelFor(numch, [&](const int ch) {
+        for (int i = chfirst[ch]; i < chlast[ch]; ++i)
+            ptr[i] = T();
+    });
+}
+
+// zero a newly allocated array that isn't divided into chunks,
+// splitting it evenly among threads
+template<typename T>
+inline void touch(T* ptr, const int count) {
+    const int nth = Exec::numThreads();
+    Exec::parallelFor(nth, [&](const int t) {
+        const int first = (long) count * t / nth;
+        const int last = (long) count * (t + 1) / nth;
+        for (int i = first; i < last; ++i)
+            ptr[i] = T();
+    });
+}
+
+// move an array that has already been filled (e.g. serially)
+// into newly allocated memory, copying each chunk's range from
+// the thread that owns it; entries past the last chunk are
+// copied by the calling thread.  Returns the new array; the old
+// one is freed.
+template<typename T>
+inline T* distribute(
+        T* ptr,
+        const int count,
+        const int* chfirst,
+        const int* chlast,
+        const int numch) {
+    T* newptr = alloc<T>(count);
+    Exec::parallelFor(numch, [&](const int ch) {
+        for (int i = chfirst[ch]; i < chlast[ch]; ++i)
+            newptr[i] = ptr[i];
+    });
+    for (int i = (numch > 0 ? chlast[numch - 1] : 0); i < count; ++i)
+        newptr[i] = ptr[i];
+    free(ptr);
+    return newptr;
+}
+
+// double2 versions of touch and distribute
+#ifdef USE_SOA
+
+inline void touch2(
+        double2ptr ptr,
+        const int* chfirst,
+        const int* chlast,
+        const int numch) {
+    touch(ptr.x, chfirst, chlast, numch);
+    touch(ptr.y, chfirst, chlast, numch);
+}
+
+inline void touch2(double2ptr ptr, const int count) {
+    touch(ptr.x, count);
+    touch(ptr.y, count);
+}
+
+inline double2ptr distribute2(
+        double2ptr ptr,
+        const int count,
+        const int* chfirst,
+        const int* chlast,
+        const int numch) {
+    // both components share one block, so copy them together
+    double2ptr newptr = alloc2(count);
+    Exec::parallelFor(numch, [&](const int ch) {
+        for (int i = chfirst[ch]; i < chlast[ch]; ++i) {
+            newptr.x[i] = ptr.x[i];
+            newptr.y[i] = ptr.y[i];
+        }
+    });
+    for (int i = (numch > 0 ? chlast[numch - 1] : 0); i < count; ++i) {
+        newptr.x[i] = ptr.x[i];
+        newptr.y[i] = ptr.y[i];
+    }
+    free2(ptr);
+    return newptr;
+}
+
+#else  // USE_SOA
+
+inline void touch2(
+        double2ptr ptr,
+        const int* chfirst,
+        const int* chlast,
+        const int numch) {
+    touch(ptr, chfirst, chlast, numch);
+}
+
+inline void touch2(double2ptr ptr, const int count) {
+    touch(ptr, count);
+}
+
+inline double2ptr distribute2(
+        double2ptr ptr,
+        const int count,
+        const int* chfirst,
+        const int* chlast,
+        const int numch) {
+    return distribute(ptr, count, chfirst, chlast, numch);
+}
+
+#endif  // USE_SOA
+
+};  // namespace Memory
+
+#endif /* FIRSTTOUCH_HH_ */
@@ -75,6 +75,20 @@ GenMesh::GenMesh(const InputFile* inp) {
         exit(1);
     }
 
+    // with one PE there are no ghosts, so the flag is ignored.
+    // The point at the origin of a pie mesh is shared by the
+    // zones of every PE in the first row, so it can't be
+    // finished from one layer of ghost zones.
+    ghostzones = inp->getInt("ghostzones", 0) && Parallel::numpe > 1;
+    if (ghostzones && meshtype == "pie") {
+        if (mype == 0)
+            cerr << "Error:  ghostzones requires meshtype rect or hex"
+                 << endl;
+        exit(1);
+    }
+
+    nodedecomp = inp->getInt("nodedecomp", 1);
+
 }
 
 
@@ -91,15 +105,26 @@ void GenMesh::generate(
         std::vector<int>& slavepoints,
         std::vector<int>& masterslvpes,
         std::vector<int>& masterslvcounts,
-        std::vector<int>& masterpoints){
+        std::vector<int>& masterpoints,
+        std::vector<int>& zonepes,
+        std::vector<int64_t>& zoneglobal){
 
     // do calculations common to all mesh types
     calcNumPE();
     zxoffset = mypex * gnzx / numpex;
-    const int zxstop = (mypex + 1) * gnzx / numpex;
-    nzx = zxstop - zxoffset;
+    int zxstop = (mypex + 1) * gnzx / numpex;
     zyoffset = mypey * gnzy / numpey;
-    const int zystop = (mypey + 1) * gnzy / numpey;
+    int zystop = (mypey + 1) * gnzy / numpey;
+    // with ghost zones, extend the local zones by one on each
+    // side with a neighboring PE; the mesh is generated the same
+    // way for the larger block
+    if (ghostzones) {
+        if (mypex != 0) zxoffset -= 1;
+        if (mypex != numpex - 1) zxstop += 1;
+        if (mypey != 0) zyoffset -= 1;
+        if (mypey != numpey - 1) zystop += 1;
+    }
+    nzx = zxstop - zxoffset;
     nzy = zystop - zyoffset;
 
     // mesh type-specific calculations
@@ -116,6 +141,21 @@ void GenMesh::generate(
                 slavemstrpes, slavemstrcounts, slavepoints,
                 masterslvpes, masterslvcounts, masterpoints);
 
+    if (!ghostzones) return;
+
+    // all mesh types number the zones by rows, so the global
+    // numbers increase along with the local ones
+    zonepes.reserve(nzx * nzy);
+    zoneglobal.reserve(nzx * nzy);
+    for (int j = 0; j < nzy; ++j) {
+        for (int i = 0; i < nzx; ++i) {
+            int gi = i + zxoffset;
+            int gj = j + zyoffset;
+            zonepes.push_back(zonePE(gi, gj));
+            zoneglobal.push_back((int64_t) gj * gnzx + gi);
+        }
+    }
+
 }
 
 
@@ -132,7 +172,6 @@ void GenMesh::generateRect(
         std::vector<int>& masterpoints) {
 
     using Parallel::numpe;
-    using Parallel::mype;
 
     const int nz = nzx * nzy;
     const int npx = nzx + 1;
@@ -167,7 +206,7 @@ void GenMesh::generateRect(
        }
     }
 
-    if (numpe == 1) return;
+    if (numpe == 1 || ghostzones) return;
 
     // estimate sizes of slave/master arrays
     slavepoints.reserve((mypey != 0) * npx + (mypex != 0) * npy);
@@ -177,14 +216,14 @@ void GenMesh::generateRect(
     // enumerate slave points
     // slave point with master at lower left
     if (mypex != 0 && mypey != 0) {
-        int mstrpe = mype - numpex - 1;
+        int mstrpe = blockPE(mypex - 1, mypey - 1);
         slavepoints.push_back(0);
         slavemstrpes.push_back(mstrpe);
         slavemstrcounts.push_back(1);
     }
     // slave points with master below
     if (mypey != 0) {
-        int mstrpe = mype - numpex;
+        int mstrpe = blockPE(mypex, mypey - 1);
         int oldsize = slavepoints.size();
         int p = 0;
         for (int i = 0; i < npx; ++i) {
@@ -197,7 +236,7 @@ void GenMesh::generateRect(
     }
     // slave points with master to left
     if (mypex != 0) {
-        int mstrpe = mype - 1;
+        int mstrpe = blockPE(mypex - 1, mypey);
         int oldsize = slavepoints.size();
         int p = 0;
         for (int j = 0; j < npy; ++j) {
@@ -212,7 +251,7 @@ void GenMesh::generateRect(
     // enumerate master points
     // master points with slave to right
     if (mypex != numpex - 1) {
-        int slvpe = mype + 1;
+        int slvpe = blockPE(mypex + 1, mypey);
         int oldsize = masterpoints.size();
         int p = npx - 1;
         for (int j = 0; j < npy; ++j) {
@@ -225,7 +264,7 @@ void GenMesh::generateRect(
     }
     // master points with slave above
     if (mypey != numpey - 1) {
-        int slvpe = mype + numpex;
+        int slvpe = blockPE(mypex, mypey + 1);
         int oldsize = masterpoints.size();
         int p = (npy - 1) * npx;
         for (int i = 0; i < npx; ++i) {
@@ -238,7 +277,7 @@ void GenMesh::generateRect(
     }
     // master point with slave at upper right
     if (mypex != numpex - 1 && mypey != numpey - 1) {
-        int slvpe = mype + numpex + 1;
+        int slvpe = blockPE(mypex + 1, mypey + 1);
         int p = npx * npy - 1;
         masterpoints.push_back(p);
         masterslvpes.push_back(slvpe);
@@ -261,7 +300,6 @@ void GenMesh::generatePie(
         std::vector<int>& masterpoints) {
 
     using Parallel::numpe;
-    using Parallel::mype;
 
     const int nz = nzx * nzy;
     const int npx = nzx + 1;
@@ -309,7 +347,7 @@ void GenMesh::generatePie(
         }
     }
 
-    if (numpe == 1) return;
+    if (numpe == 1 || ghostzones) return;
 
     // estimate sizes of slave/master arrays
     slavepoints.reserve((mypey != 0) * npx + (mypex != 0) * npy);
@@ -319,14 +357,14 @@ void GenMesh::generatePie(
     // enumerate slave points
     // slave point with master at lower left
     if (mypex != 0 && mypey != 0) {
-        int mstrpe = mype - numpex - 1;
+        int mstrpe = blockPE(mypex - 1, mypey - 1);
         slavepoints.push_back(0);
         slavemstrpes.push_back(mstrpe);
         slavemstrcounts.push_back(1);
     }
     // slave points with master below
     if (mypey != 0) {
-        int mstrpe = mype - numpex;
+        int mstrpe = blockPE(mypex, mypey - 1);
         int oldsize = slavepoints.size();
         int p = 0;
         for (int i = 0; i < npx; ++i) {
@@ -339,14 +377,14 @@ void GenMesh::generatePie(
     }
     // slave points with master to left
     if (mypex != 0) {
-        int mstrpe = mype - 1;
+        int mstrpe = blockPE(mypex - 1, mypey);
         int oldsize = slavepoints.size();
         if (mypey == 0) {
             slavepoints.push_back(0);
             // special case:
             // slave point at origin, master not to immediate left
             if (mypex > 1) {
-                slavemstrpes.push_back(0);
+                slavemstrpes.push_back(blockPE(0, 0));
                 slavemstrcounts.push_back(1);
                 oldsize += 1;
             }
@@ -363,9 +401,10 @@ void GenMesh::generatePie(
     // enumerate master points
     // master points with slave to right
     if (mypex != numpex - 1) {
-        int slvpe = mype + 1;
+        int slvpe = blockPE(mypex + 1, mypey);
         int oldsize = masterpoints.size();
-        // special case:  origin as master for slave on PE 1
+        // special case:  origin as master for slave on the
+        // next PE to the right
         if (mypex == 0 && mypey == 0) {
             masterpoints.push_back(0);
         }
@@ -376,18 +415,19 @@ void GenMesh::generatePie(
         }
         masterslvpes.push_back(slvpe);
         masterslvcounts.push_back(masterpoints.size() - oldsize);
-        // special case:  origin as master for slaves on PEs > 1
+        // special case:  origin as master for slaves on the
+        // other PEs in the first row
         if (mypex == 0 && mypey == 0) {
-            for (int slvpe = 2; slvpe < numpex; ++slvpe) {
+            for (int pex = 2; pex < numpex; ++pex) {
                 masterpoints.push_back(0);
-                masterslvpes.push_back(slvpe);
+                masterslvpes.push_back(blockPE(pex, 0));
                 masterslvcounts.push_back(1);
             }
         }
     }
     // master points with slave above
     if (mypey != numpey - 1) {
-        int slvpe = mype + numpex;
+        int slvpe = blockPE(mypex, mypey + 1);
         int oldsize = masterpoints.size();
         int p = (npy - 1) * npx;
         if (mypey == 0) p -= npx - 1;
@@ -401,7 +441,7 @@ void GenMesh::generatePie(
     }
     // master point with slave at upper right
     if (mypex != numpex - 1 && mypey != numpey - 1) {
-        int slvpe = mype + numpex + 1;
+        int slvpe = blockPE(mypex + 1, mypey + 1);
         int p = npx * npy - 1;
         if (mypey == 0) p -= npx - 1;
         masterpoints.push_back(p);
@@ -425,7 +465,6 @@ void GenMesh::generateHex(
         std::vector<int>& masterpoints) {
 
     using Parallel::numpe;
-    using Parallel::mype;
 
     const int nz = nzx * nzy;
     const int npx = nzx + 1;
@@ -472,7 +511,7 @@ void GenMesh::generateHex(
         int gj = j + zyoffset;
         int pbasel = pbase[j];
         int pbaseh = pbase[j+1];
-        if (mypex > 0) {
+        if (zxoffset > 0) {
             if (gj > 0) pbasel += 1;
             if (j < nzy - 1) pbaseh += 1;
         }
@@ -507,7 +546,7 @@ void GenMesh::generateHex(
         } // for i
     } // for j
 
-    if (numpe == 1) return;
+    if (numpe == 1 || ghostzones) return;
 
     // estimate upper bounds for sizes of slave/master arrays
     slavepoints.reserve((mypey != 0) * 2 * npx +
@@ -518,7 +557,7 @@ void GenMesh::generateHex(
     // enumerate slave points
     // slave points with master at lower left
     if (mypex != 0 && mypey != 0) {
-        int mstrpe = mype - numpex - 1;
+        int mstrpe = blockPE(mypex - 1, mypey - 1);
         slavepoints.push_back(0);
         slavepoints.push_back(1);
         slavemstrpes.push_back(mstrpe);
@@ -527,7 +566,7 @@ void GenMesh::generateHex(
     // slave points with master below
     if (mypey != 0) {
         int p = 0;
-        int mstrpe = mype - numpex;
+        int mstrpe = blockPE(mypex, mypey - 1);
         int oldsize = slavepoints.size();
         for (int i = 0; i < npx; ++i) {
             if (i == 0 && mypex != 0) {
@@ -546,7 +585,7 @@ void GenMesh::generateHex(
     }  // if mypey != 0
     // slave points with master to left
     if (mypex != 0) {
-        int mstrpe = mype - 1;
+        int mstrpe = blockPE(mypex - 1, mypey);
         int oldsize = slavepoints.size();
         for (int j = 0; j < npy; ++j) {
             if (j == 0 && mypey != 0) continue;
@@ -565,7 +604,7 @@ void GenMesh::generateHex(
     // enumerate master points
     // master points with slave to right
     if (mypex != numpex - 1) {
-        int slvpe = mype + 1;
+        int slvpe = blockPE(mypex + 1, mypey);
         int oldsize = masterpoints.size();
         for (int j = 0; j < npy; ++j) {
             if (j == 0 && mypey != 0) continue;
@@ -583,7 +622,7 @@ void GenMesh::generateHex(
     // master points with slave above
     if (mypey != numpey - 1) {
         int p = pbase[nzy];
-        int slvpe = mype + numpex;
+        int slvpe = blockPE(mypex, mypey + 1);
         int oldsize = masterpoints.size();
         for (int i = 0; i < npx; ++i) {
             if (i == 0 && mypex != 0) {
@@ -602,7 +641,7 @@ void GenMesh::generateHex(
     }  // if mypey != numpey - 1
     // master points with slave at upper right
     if (mypex != numpex - 1 && mypey != numpey - 1) {
-        int slvpe = mype + numpex + 1;
+        int slvpe = blockPE(mypex + 1, mypey + 1);
         masterpoints.push_back(np-2);
         masterpoints.push_back(np-1);
         masterslvpes.push_back(slvpe);
@@ -617,33 +656,97 @@ void GenMesh::calcNumPE() {
     using Parallel::numpe;
     using Parallel::mype;
 
-    // pick numpex, numpey such that PE blocks are as close to square
-    // as possible
-    // we would like:  gnzx / numpex == gnzy / numpey,
-    // where numpex * numpey = numpe (total number of PEs available)
-    // this solves to:  numpex = sqrt(numpe * gnzx / gnzy)
-    // we compute this, assuming gnzx <= gnzy (swap if necessary)
+    // the PEs on each node, in order
+    const int numnode = Parallel::numNodes();
+    vector<vector<int> > nodepes(numnode);
+    for (int pe = 0; pe < numpe; ++pe)
+        nodepes[Parallel::nodeOf(pe)].push_back(pe);
+    // two levels need the same number of PEs on every node
+    bool twolevel = (nodedecomp && numnode > 1);
+    for (int node = 0; node < numnode; ++node)
+        if (nodepes[node].size() != nodepes[0].size()) twolevel = false;
+
     double nx = static_cast<double>(gnzx);
     double ny = static_cast<double>(gnzy);
+    blockpes.resize(numpe);
+    if (twolevel) {
+        // split the mesh into a block per node, then split each
+        // node's block into a block per PE on the node, so that
+        // most PE boundaries are inside a node
+        const int pernode = nodepes[0].size();
+        int numpenx, numpeny;
+        calcBlocks(nx, ny, numnode, numnodex, numnodey);
+        calcBlocks(nx / numnodex, ny / numnodey, pernode,
+                numpenx, numpeny);
+        numpex = numnodex * numpenx;
+        numpey = numnodey * numpeny;
+        for (int pey = 0; pey < numpey; ++pey) {
+            for (int pex = 0; pex < numpex; ++pex) {
+                int node = (pey / numpeny) * numnodex + pex / numpenx;
+                int i = (pey % numpeny) * numpenx + pex % numpenx;
+                blockpes[pey * numpex + pex] = nodepes[node][i];
+            }
+        }
+    }
+    else {
+        numnodex = numnodey = 1;
+        calcBlocks(nx, ny, numpe, numpex, numpey);
+        for (int pe = 0; pe < numpe; ++pe)
+            blockpes[pe] = pe;
+    }
+
+    int myblock = find(blockpes.begin(), blockpes.end(), mype) -
+            blockpes.begin();
+    mypex = myblock % numpex;
+    mypey = myblock / numpex;
+
+}
+
+
+void GenMesh::calcBlocks(
+        double nx,
+        double ny,
+        const int n,
+        int& nbx,
+        int& nby) {
+
+    // pick nbx, nby such that blocks are as close to square
+    // as possible
+    // we would like:  nx / nbx == ny / nby,
+    // where nbx * nby = n (total number of blocks)
+    // this solves to:  nbx = sqrt(n * nx / ny)
+    // we compute this, assuming nx <= ny (swap if necessary)
     bool swapflag = (nx > ny);
     if (swapflag) swap(nx, ny);
-    double n = sqrt(numpe * nx / ny);
-    // need to constrain n to be an integer with numpe % n == 0
-    // try rounding n both up and down
-    int n1 = floor(n + 1.e-12);
-    n1 = max(n1, 1);
-    while (numpe % n1 != 0) --n1;
-    int n2 = ceil(n - 1.e-12);
-    while (numpe % n2 != 0) ++n2;
-    // pick whichever of n1 and n2 gives blocks closest to square,
+    double b = sqrt(n * nx / ny);
+    // need to constrain b to be an integer with n % b == 0
+    // try rounding b both up and down
+    int b1 = floor(b + 1.e-12);
+    b1 = max(b1, 1);
+    while (n % b1 != 0) --b1;
+    int b2 = ceil(b - 1.e-12);
+    while (n % b2 != 0) ++b2;
+    // pick whichever of b1 and b2 gives blocks closest to square,
     // i.e. gives the shortest long side
-    double longside1 = max(nx / n1, ny / (numpe/n1));
-    double longside2 = max(nx / n2, ny / (numpe/n2));
-    numpex = (longside1 <= longside2 ? n1 : n2);
-    numpey = numpe / numpex;
-    if (swapflag) swap(numpex, numpey);
-    mypex = mype % numpex;
-    mypey = mype / numpex;
+    double longside1 = max(nx / b1, ny / (n/b1));
+    double longside2 = max(nx / b2, ny / (n/b2));
+    nbx = (longside1 <= longside2 ? b1 : b2);
+    nby = n / nbx;
+    if (swapflag) swap(nbx, nby);
+
+}
+
+
+int GenMesh::zonePE(const int gzx, const int gzy) const {
+
+    // invert the block offsets computed in generate
+    int pex = (int64_t) gzx * numpex / gnzx;
+    while (pex > 0 && (int64_t) pex * gnzx / numpex > gzx) --pex;
+    while ((int64_t) (pex + 1) * gnzx / numpex <= gzx) ++pex;
+    int pey = (int64_t) gzy * numpey / gnzy;
+    while (pey > 0 && (int64_t) pey * gnzy / numpey > gzy) --pey;
+    while ((int64_t) (pey + 1) * gnzy / numpey <= gzy) ++pey;
+    return blockPE(pex, pey);
 
 }
 
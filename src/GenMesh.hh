@@ -15,6 +15,7 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
 #include "Vec2.hh"
 
 // forward declarations
@@ -32,10 +33,20 @@ public:
     int numpex, numpey;         // number of PEs to use, in x and y
                                 // directions
     int mypex, mypey;           // my PE index, in x and y directions
+    int numnodex, numnodey;     // number of node blocks, in x and y
+                                // directions (1 if not used)
+    std::vector<int> blockpes;  // PE of each block, in row-major
+                                // order
     int nzx, nzy;               // (local) number of zones, in x and y
                                 // directions
     int zxoffset, zyoffset;     // offsets of local zone array into
                                 // global, in x and y directions
+    bool ghostzones;            // flag:  add a layer of ghost zones
+                                // from neighboring PEs around the
+                                // local zones?
+    bool nodedecomp;            // flag:  split the mesh into a block
+                                // per node before splitting it into
+                                // a block per PE?
 
     GenMesh(const InputFile* inp);
     ~GenMesh();
@@ -50,7 +61,9 @@ public:
             std::vector<int>& slavepoints,
             std::vector<int>& masterslvpes,
             std::vector<int>& masterslvcounts,
-            std::vector<int>& masterpoints);
+            std::vector<int>& masterpoints,
+            std::vector<int>& zonepes,
+            std::vector<int64_t>& zoneglobal);
 
     void generateRect(
             std::vector<double2>& pointpos,
@@ -90,6 +103,23 @@ public:
 
     void calcNumPE();
 
+    // split an nx by ny mesh into nbx by nby blocks, with
+    // nbx * nby = n, as close to square as possible
+    static void calcBlocks(
+            double nx,
+            double ny,
+            const int n,
+            int& nbx,
+            int& nby);
+
+    // PE of block (pex, pey)
+    int blockPE(const int pex, const int pey) const {
+        return blockpes[pey * numpex + pex];
+    }
+
+    // find the PE owning global zone (gzx, gzy)
+    int zonePE(const int gzx, const int gzy) const;
+
 }; // class GenMesh
 
 
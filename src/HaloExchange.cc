@@ -0,0 +1,399 @@
+/*
+ * HaloExchange.cc
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#include "HaloExchange.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <new>
+
+using namespace std;
+
+
+#ifdef USE_MPI
+static void checkMPI(const int ierr, const char* name) {
+
+    if (ierr != MPI_SUCCESS) {
+        cerr << "Error: " << name << " MPI error " << ierr <<
+                " on PE " << Parallel::mype << endl;
+        cerr << "Exiting..." << endl;
+        exit(1);
+    }
+
+}
+#endif
+
+
+bool HaloExchange::findMethod(const string& name, Method& m) {
+
+    if (name == "p2p")
+        m = p2p;
+    else if (name == "persistent")
+        m = persistent;
+    else if (name == "neighbor")
+        m = neighbor;
+    else if (name == "rma")
+        m = rma;
+    else if (name == "shm")
+        m = shm;
+    else
+        return false;
+    return true;
+
+}
+
+
+const char* HaloExchange::methodName(const Method m) {
+
+    switch (m) {
+    case persistent: return "persistent";
+    case neighbor:   return "neighbor";
+    case rma:        return "rma";
+    case shm:        return "shm";
+    default:         return "p2p";
+    }
+
+}
+
+
+HaloExchange::HaloExchange(
+        const Method m,
+        const int numsend,
+        const int* sendpe,
+        const int* sendfirst,
+        const int* sendcount,
+        double* sendbuf,
+        const int numrecv,
+        const int* recvpe,
+        const int* recvfirst,
+        const int* recvcount,
+        double* recvbuf,
+        const int width,
+        const int tag_)
+        : method(m), tag(tag_), local(Parallel::numdomains > 1),
+          sbuf(sendbuf), rbuf(recvbuf), numstarted(0), numtaken(0) {
+
+    for (int i = 0; i < numsend; ++i) {
+        spe.push_back(sendpe[i]);
+        sdispl.push_back(sendfirst[i] * width);
+        scount.push_back(sendcount[i] * width);
+    }
+    int rsize = 0;
+    for (int i = 0; i < numrecv; ++i) {
+        rpe.push_back(recvpe[i]);
+        rdispl.push_back(recvfirst[i] * width);
+        rcount.push_back(recvcount[i] * width);
+        rsize = max(rsize, rdispl[i] + rcount[i]);
+    }
+
+    if (local) {
+        // find our block in the send buffer of each PE we
+        // receive from
+        vector<void*> peers(Parallel::numpe);
+        Parallel::shareAddress(this, &peers[0]);
+        for (int i = 0; i < numrecv; ++i) {
+            HaloExchange* peer = static_cast<HaloExchange*>(peers[rpe[i]]);
+            int j = find(peer->spe.begin(), peer->spe.end(),
+                    Parallel::mype) - peer->spe.begin();
+            if (j == peer->spe.size() || peer->scount[j] != rcount[i]) {
+                cerr << "Error:  PE " << rpe[i] << " doesn't send " <<
+                        rcount[i] << " doubles to PE " <<
+                        Parallel::mype << endl;
+                exit(1);
+            }
+            rpeer.push_back(peer);
+            rpeerdispl.push_back(peer->sdispl[j]);
+        }
+        return;
+    }
+
+#ifdef USE_MPI
+    graphcomm = MPI_COMM_NULL;
+    win = MPI_WIN_NULL;
+    shmwin = MPI_WIN_NULL;
+
+    switch (method) {
+    case persistent:
+        request.resize(numrecv + numsend);
+        for (int i = 0; i < numrecv; ++i)
+            MPI_Recv_init(&rbuf[rdispl[i]], rcount[i], MPI_DOUBLE,
+                    rpe[i], tag, MPI_COMM_WORLD, &request[i]);
+        for (int i = 0; i < numsend; ++i)
+            MPI_Send_init(&sbuf[sdispl[i]], scount[i], MPI_DOUBLE,
+                    spe[i], tag, MPI_COMM_WORLD, &request[numrecv + i]);
+        break;
+    case neighbor:
+        // messages come from the PEs we receive from, and go to
+        // the PEs we send to
+        request.resize(1);
+        checkMPI(MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+                numrecv, rpe.data(), MPI_UNWEIGHTED,
+                numsend, spe.data(), MPI_UNWEIGHTED,
+                MPI_INFO_NULL, 0, &graphcomm),
+                "HaloExchange");
+        break;
+    case rma: {
+        // each PE tells the PEs it receives from where their
+        // blocks go in its window
+        vector<int> tdisplint(numsend);
+        vector<MPI_Request> setup(numsend + numrecv);
+        for (int i = 0; i < numsend; ++i)
+            MPI_Irecv(&tdisplint[i], 1, MPI_INT, spe[i], tag,
+                    MPI_COMM_WORLD, &setup[i]);
+        for (int i = 0; i < numrecv; ++i)
+            MPI_Isend(&rdispl[i], 1, MPI_INT, rpe[i], tag,
+                    MPI_COMM_WORLD, &setup[numsend + i]);
+        checkMPI(MPI_Waitall(setup.size(), setup.data(),
+                MPI_STATUSES_IGNORE), "HaloExchange");
+        tdispl.assign(tdisplint.begin(), tdisplint.end());
+        checkMPI(MPI_Win_create(rbuf, rsize * sizeof(double),
+                sizeof(double), MPI_INFO_NULL, MPI_COMM_WORLD, &win),
+                "HaloExchange");
+        break;
+    }
+    case shm:
+        initShm();
+        break;
+    default:
+        request.resize(numrecv + numsend);
+        break;
+    }
+#endif
+
+}
+
+
+#ifdef USE_MPI
+void HaloExchange::initShm() {
+
+    const int numsend = spe.size();
+    const int numrecv = rpe.size();
+
+    // find which neighbors are on this node, by their ranks in the
+    // node communicator
+    MPI_Comm nodecomm = Parallel::nodeComm();
+    MPI_Group worldgroup, nodegroup;
+    MPI_Comm_group(MPI_COMM_WORLD, &worldgroup);
+    MPI_Comm_group(nodecomm, &nodegroup);
+    vector<int> snode(numsend), rnode(numrecv);
+    MPI_Group_translate_ranks(worldgroup, numsend, spe.data(),
+            nodegroup, snode.data());
+    MPI_Group_translate_ranks(worldgroup, numrecv, rpe.data(),
+            nodegroup, rnode.data());
+    MPI_Group_free(&worldgroup);
+    MPI_Group_free(&nodegroup);
+
+    int shmsize = 0;
+    for (int i = 0; i < numsend; ++i) {
+        if (snode[i] == MPI_UNDEFINED) {
+            msgsend.push_back(i);
+            continue;
+        }
+        shmsend.push_back(i);
+        shmsdispl.push_back(shmsize);
+        shmsize += scount[i];
+    }
+    for (int i = 0; i < numrecv; ++i) {
+        if (rnode[i] == MPI_UNDEFINED)
+            msgrecv.push_back(i);
+        else
+            shmrecv.push_back(i);
+    }
+    request.resize(msgrecv.size() + msgsend.size());
+
+    // each PE's segment holds its flags, then the blocks it sends
+    // on the node; noncontiguous segments each start on a page,
+    // so they don't share cache lines
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    char* base;
+    checkMPI(MPI_Win_allocate_shared(
+            sizeof(ShmFlags) + shmsize * sizeof(double), 1, info,
+            nodecomm, &base, &shmwin), "HaloExchange");
+    MPI_Info_free(&info);
+    shmflags = new (base) ShmFlags;
+    shmflags->started = 0;
+    shmflags->taken = 0;
+    shmsbuf = reinterpret_cast<double*>(base + sizeof(ShmFlags));
+
+    // each PE tells the PEs it sends to on the node where their
+    // blocks are in its segment
+    vector<int> rdisplshm(shmrecv.size());
+    vector<MPI_Request> setup(shmrecv.size() + shmsend.size());
+    for (int k = 0; k < shmrecv.size(); ++k)
+        MPI_Irecv(&rdisplshm[k], 1, MPI_INT, rpe[shmrecv[k]], tag,
+                MPI_COMM_WORLD, &setup[k]);
+    for (int k = 0; k < shmsend.size(); ++k)
+        MPI_Isend(&shmsdispl[k], 1, MPI_INT, spe[shmsend[k]], tag,
+                MPI_COMM_WORLD, &setup[shmrecv.size() + k]);
+    checkMPI(MPI_Waitall(setup.size(), setup.data(),
+            MPI_STATUSES_IGNORE), "HaloExchange");
+
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, shmwin);
+    for (int k = 0; k < shmrecv.size(); ++k) {
+        MPI_Aint size;
+        int dispunit;
+        char* peerbase;
+        MPI_Win_shared_query(shmwin, rnode[shmrecv[k]], &size,
+                &dispunit, &peerbase);
+        shmrflags.push_back(reinterpret_cast<ShmFlags*>(peerbase));
+        shmrsrc.push_back(reinterpret_cast<double*>(
+                peerbase + sizeof(ShmFlags)) + rdisplshm[k]);
+    }
+
+    // all flags on the node are set before any are read
+    MPI_Barrier(nodecomm);
+
+}
+#endif
+
+
+HaloExchange::~HaloExchange() {
+    if (local) return;
+#ifdef USE_MPI
+    // the driver may outlive MPI, in which case everything has
+    // been freed already
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (finalized) return;
+
+    if (method == persistent) {
+        for (int i = 0; i < request.size(); ++i)
+            MPI_Request_free(&request[i]);
+    }
+    if (graphcomm != MPI_COMM_NULL) MPI_Comm_free(&graphcomm);
+    if (win != MPI_WIN_NULL) MPI_Win_free(&win);
+    if (shmwin != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(shmwin);
+        MPI_Win_free(&shmwin);
+    }
+#endif
+}
+
+
+void HaloExchange::start() {
+    if (local) {
+        // our send blocks are ready to be copied
+        numstarted += 1;
+        return;
+    }
+#ifdef USE_MPI
+    const int numsend = spe.size();
+    const int numrecv = rpe.size();
+
+    switch (method) {
+    case persistent:
+        if (!request.empty())
+            MPI_Startall(request.size(), request.data());
+        break;
+    case neighbor:
+        MPI_Ineighbor_alltoallv(sbuf, scount.data(), sdispl.data(),
+                MPI_DOUBLE, rbuf, rcount.data(), rdispl.data(),
+                MPI_DOUBLE, graphcomm, &request[0]);
+        break;
+    case rma:
+        // the previous exchange was completed by its closing fence
+        MPI_Win_fence(MPI_MODE_NOPRECEDE, win);
+        for (int i = 0; i < numsend; ++i)
+            MPI_Put(&sbuf[sdispl[i]], scount[i], MPI_DOUBLE, spe[i],
+                    tdispl[i], scount[i], MPI_DOUBLE, win);
+        break;
+    case shm: {
+        const int nr = msgrecv.size();
+        for (int k = 0; k < nr; ++k) {
+            const int i = msgrecv[k];
+            MPI_Irecv(&rbuf[rdispl[i]], rcount[i], MPI_DOUBLE,
+                    rpe[i], tag, MPI_COMM_WORLD, &request[k]);
+        }
+        for (int k = 0; k < msgsend.size(); ++k) {
+            const int i = msgsend[k];
+            MPI_Isend(&sbuf[sdispl[i]], scount[i], MPI_DOUBLE,
+                    spe[i], tag, MPI_COMM_WORLD, &request[nr + k]);
+        }
+        // the segment's previous blocks were all taken before the
+        // previous finish() returned
+        for (int k = 0; k < shmsend.size(); ++k) {
+            const int i = shmsend[k];
+            copy(&sbuf[sdispl[i]], &sbuf[sdispl[i]] + scount[i],
+                    &shmsbuf[shmsdispl[k]]);
+        }
+        shmflags->started.store(shmflags->started.load() + 1,
+                memory_order_release);
+        break;
+    }
+    default:
+        for (int i = 0; i < numrecv; ++i)
+            MPI_Irecv(&rbuf[rdispl[i]], rcount[i], MPI_DOUBLE,
+                    rpe[i], tag, MPI_COMM_WORLD, &request[i]);
+        for (int i = 0; i < numsend; ++i)
+            MPI_Isend(&sbuf[sdispl[i]], scount[i], MPI_DOUBLE,
+                    spe[i], tag, MPI_COMM_WORLD, &request[numrecv + i]);
+        break;
+    }
+#endif
+}
+
+
+void HaloExchange::finish() {
+    if (local) {
+        const int n = numstarted.load();
+        for (int i = 0; i < rpeer.size(); ++i) {
+            HaloExchange* peer = rpeer[i];
+            while (peer->numstarted.load() < n)
+                this_thread::yield();
+            const double* src = peer->sbuf + rpeerdispl[i];
+            copy(src, src + rcount[i], rbuf + rdispl[i]);
+            peer->numtaken += 1;
+        }
+        // our send buffer may be reused once all of our blocks
+        // have been copied out
+        while (numtaken.load() < n * (int) spe.size())
+            this_thread::yield();
+        return;
+    }
+#ifdef USE_MPI
+    if (method == rma) {
+        MPI_Win_fence(MPI_MODE_NOSUCCEED, win);
+        return;
+    }
+    if (method == shm) {
+        // copy the blocks from the node as they become ready,
+        // keeping the messages moving while waiting
+        const int n = shmflags->started.load();
+        int done = 0;
+        for (int k = 0; k < shmrecv.size(); ++k) {
+            ShmFlags* f = shmrflags[k];
+            while (f->started.load(memory_order_acquire) < n) {
+                if (!done)
+                    MPI_Testall(request.size(), request.data(), &done,
+                            MPI_STATUSES_IGNORE);
+                this_thread::yield();
+            }
+            const int i = shmrecv[k];
+            copy(shmrsrc[k], shmrsrc[k] + rcount[i], &rbuf[rdispl[i]]);
+            f->taken.fetch_add(1, memory_order_release);
+        }
+        checkMPI(MPI_Waitall(request.size(), request.data(),
+                MPI_STATUSES_IGNORE), "HaloExchange");
+        // the segment may be reused once all of its blocks have
+        // been taken
+        while (shmflags->taken.load(memory_order_acquire) <
+                n * (int) shmsend.size())
+            this_thread::yield();
+        return;
+    }
+    checkMPI(MPI_Waitall(request.size(), request.data(),
+            MPI_STATUSES_IGNORE), "HaloExchange");
+#endif
+}
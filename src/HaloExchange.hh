@@ -0,0 +1,148 @@
+/*
+ * HaloExchange.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef HALOEXCHANGE_HH_
+#define HALOEXCHANGE_HH_
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "Parallel.hh"
+
+
+// Class HaloExchange sends blocks of doubles from one buffer to a
+// fixed set of neighboring PEs, and receives blocks from another
+// set into a second buffer.  The buffers, neighbors and block sizes
+// are fixed when it is created, so that the messages can be set up
+// once and reused.  The messages are sent by one of several
+// methods, selected at run time:
+//
+//   p2p         MPI_Isend and MPI_Irecv for each neighbor (the
+//               default)
+//   persistent  persistent requests (MPI_Send_init, MPI_Recv_init),
+//               restarted for each exchange
+//   neighbor    MPI_Ineighbor_alltoallv on a distributed graph
+//               communicator of the neighbors
+//   rma         MPI_Put into windows on the receive buffers,
+//               synchronized by fences
+//   shm         for neighbors on the same node, copies through an
+//               MPI-3 shared memory window, with flags in the window
+//               to say when blocks are ready and when they have been
+//               taken; p2p messages for the other neighbors
+//
+// All methods give the same results.  Between in-process domains
+// (see Parallel::runDomains), each receiver copies its blocks
+// straight from the senders' buffers instead, whatever the method.
+// Without MPI or domains, an exchange does nothing.
+
+class HaloExchange {
+public:
+
+    enum Method {
+        p2p,
+        persistent,
+        neighbor,
+        rma,
+        shm
+    };
+
+    // find the method with the given name; returns false if none
+    static bool findMethod(const std::string& name, Method& m);
+    static const char* methodName(const Method m);
+
+    // set up an exchange of width doubles per item.  For
+    // 0 <= i < numsend, items sendfirst[i] to sendfirst[i] +
+    // sendcount[i] - 1 of sendbuf go to PE sendpe[i]; the received
+    // items are stored in recvbuf in the same way.  Must be called
+    // on all PEs at once, since some methods create communicators
+    // or windows.
+    HaloExchange(
+            const Method m,
+            const int numsend,
+            const int* sendpe,
+            const int* sendfirst,
+            const int* sendcount,
+            double* sendbuf,
+            const int numrecv,
+            const int* recvpe,
+            const int* recvfirst,
+            const int* recvcount,
+            double* recvbuf,
+            const int width,
+            const int tag);
+    ~HaloExchange();
+
+    // start sending and receiving; sendbuf must not be changed
+    // until finish() returns
+    void start();
+    // wait until all messages have been received
+    void finish();
+
+    int numMessages() const { return spe.size(); }
+
+private:
+
+    Method method;
+    int tag;                    // tag for p2p and persistent messages
+    bool local;                 // between in-process domains?
+
+    // neighbors, and offsets and sizes of their blocks, in doubles
+    std::vector<int> spe, sdispl, scount;
+    std::vector<int> rpe, rdispl, rcount;
+    double* sbuf;
+    double* rbuf;
+
+    // for local:  the exchange on each PE we receive from, and the
+    // offset of our block in its send buffer; and counts of the
+    // exchanges started, and of our send blocks copied out, so far
+    std::vector<HaloExchange*> rpeer;
+    std::vector<int> rpeerdispl;
+    std::atomic<int> numstarted;
+    std::atomic<int> numtaken;
+
+    // flags at the start of each PE's segment of the shm window,
+    // on separate cache lines since they have different writers
+    struct ShmFlags {
+        std::atomic<int> started;   // exchanges started by the owner
+        char pad1[60];
+        std::atomic<int> taken;     // owner's blocks copied out by
+                                    // its receivers
+        char pad2[60];
+    };
+
+#ifdef USE_MPI
+    std::vector<MPI_Request> request;
+    MPI_Comm graphcomm;         // for neighbor
+    MPI_Win win;                // for rma
+    std::vector<MPI_Aint> tdispl;
+                                // for rma:  displacement of each
+                                // send block in its target's window
+
+    // for shm:  indices of the neighbors on this node, and of the
+    // others; my segment's flags and blocks, and the offset of
+    // each of my blocks in it; the flags of each PE on this node
+    // that we receive from, and our block in its segment
+    std::vector<int> shmsend, shmrecv, msgsend, msgrecv;
+    MPI_Win shmwin;
+    ShmFlags* shmflags;
+    double* shmsbuf;
+    std::vector<int> shmsdispl;
+    std::vector<ShmFlags*> shmrflags;
+    std::vector<const double*> shmrsrc;
+
+    void initShm();             // set up the shm window
+#endif
+
+}; // class HaloExchange
+
+
+#endif /* HALOEXCHANGE_HH_ */
@@ -22,6 +22,8 @@
 #include <iomanip>
 
 #include "Parallel.hh"
+#include "Exec.hh"
+#include "FirstTouch.hh"
 #include "Memory.hh"
 #include "InputFile.hh"
 #include "Mesh.hh"
@@ -29,11 +31,14 @@
 #include "TTS.hh"
 #include "QCS.hh"
 #include "HydroBC.hh"
+#include "TaskGraph.hh"
+#include "Simd.hh"
 
 using namespace std;
 
 
-Hydro::Hydro(const InputFile* inp, Mesh* m) : mesh(m) {
+Hydro::Hydro(const InputFile* inp, Mesh* m)
+        : mesh(m), forcearrays(-1), graph(NULL), dtpred(0.) {
     cfl = inp->getDouble("cfl", 0.6);
     cflv = inp->getDouble("cflv", 0.1);
     rinit = inp->getDouble("rinit", 1.);
@@ -43,6 +48,9 @@ Hydro::Hydro(const InputFile* inp, Mesh* m) : mesh(m) {
     uinitradial = inp->getDouble("uinitradial", 0.);
     bcx = inp->getDoubleList("bcx", vector<double>());
     bcy = inp->getDoubleList("bcy", vector<double>());
+    hugepages = inp->getInt("hugepages", 0);
+    taskgraph = inp->getInt("taskgraph", 0);
+    fuseforce = inp->getInt("fuseforce", 1);
 
     pgas = new PolyGas(inp, this);
     tts = new TTS(inp, this);
@@ -63,6 +71,7 @@ Hydro::~Hydro() {
 
     delete tts;
     delete qcs;
+    delete graph;
     for (int i = 0; i < bcs.size(); ++i) {
         delete bcs[i];
     }
@@ -77,14 +86,14 @@ void Hydro::init() {
     const int numz = mesh->numz;
     const int nums = mesh->nums;
 
-    const double2* zx = mesh->zx;
+    double2cptr zx = mesh->zx;
     const double* zvol = mesh->zvol;
 
     // allocate arrays
-    pu = Memory::alloc<double2>(nump);
-    pu0 = Memory::alloc<double2>(nump);
-    pap = Memory::alloc<double2>(nump);
-    pf = Memory::alloc<double2>(nump);
+    pu = Memory::alloc2(nump);
+    pu0 = Memory::alloc2(nump);
+    pap = Memory::alloc2(nump);
+    pf = Memory::alloc2(nump);
     pmaswt = Memory::alloc<double>(nump);
     cmaswt = Memory::alloc<double>(nums);
     zm = Memory::alloc<double>(numz);
@@ -97,14 +106,35 @@ void Hydro::init() {
     zp = Memory::alloc<double>(numz);
     zss = Memory::alloc<double>(numz);
     zdu = Memory::alloc<double>(numz);
-    sfp = Memory::alloc<double2>(nums);
-    sfq = Memory::alloc<double2>(nums);
-    sft = Memory::alloc<double2>(nums);
-    cftot = Memory::alloc<double2>(nums);
+    cftot = Memory::alloc2(nums);
+
+    // distribute pages across memory nodes
+    if (mesh->firsttouch) {
+        const int* sfirst = &mesh->schsfirst[0];
+        const int* slast = &mesh->schslast[0];
+        const int* zfirst = &mesh->schzfirst[0];
+        const int* zlast = &mesh->schzlast[0];
+        const int* pfirst = &mesh->pchpfirst[0];
+        const int* plast = &mesh->pchplast[0];
+        const int numsch = mesh->numsch;
+        Memory::touch2(pu, pfirst, plast, numpch);
+        Memory::touch2(pu0, pfirst, plast, numpch);
+        Memory::touch2(pap, pfirst, plast, numpch);
+        Memory::touch2(pf, pfirst, plast, numpch);
+        Memory::touch(pmaswt, pfirst, plast, numpch);
+        Memory::touch(cmaswt, sfirst, slast, numsch);
+        Memory::touch2(cftot, sfirst, slast, numsch);
+        double* zarr[] = { zm, zr, zrp, ze, zetot, zw, zwrate,
+                zp, zss, zdu };
+        for (int i = 0; i < sizeof(zarr) / sizeof(zarr[0]); ++i)
+            Memory::touch(zarr[i], zfirst, zlast, numsch);
+    }
+
+    initForceArrays();
+    reserveScratch();
 
     // initialize hydro vars
-    #pragma omp parallel for schedule(static)
-    for (int zch = 0; zch < numzch; ++zch) {
+    Exec::parallelFor(numzch, [&](const int zch) {
         int zfirst = mesh->zchzfirst[zch];
         int zlast = mesh->zchzlast[zch];
 
@@ -132,20 +162,218 @@ void Hydro::init() {
             zm[z] = zr[z] * zvol[z];
             zetot[z] = ze[z] * zm[z];
         }
-    }  // for sch
+    });  // for zch
 
-    #pragma omp parallel for schedule(static)
-    for (int pch = 0; pch < numpch; ++pch) {
+    Exec::parallelFor(numpch, [&](const int pch) {
         int pfirst = mesh->pchpfirst[pch];
         int plast = mesh->pchplast[pch];
         if (uinitradial != 0.)
             initRadialVel(uinitradial, pfirst, plast);
         else
-            fill(&pu[pfirst], &pu[plast], double2(0., 0.));
-    }  // for pch
+            for (int p = pfirst; p < plast; ++p)
+                pu[p] = double2(0., 0.);
+    });  // for pch
 
+    dtzch.resize(numzch);
+    whydtzch.resize(numzch);
     resetDtHydro();
 
+    if (taskgraph) {
+        initTaskGraph();
+        if (Parallel::mype == 0)
+            cout << "Task graph:  " << graph->numTasks() << " tasks, "
+                 << graph->numDeps() << " dependencies" << endl;
+    }
+
+}
+
+
+void Hydro::reserveScratch() {
+
+    // reserve each thread's scratch arena, big enough for the
+    // temporaries of the largest chunk:  QCS uses 10 doubles per
+    // side, the fused force kernel 2 more, and PolyGas 1 per zone
+    int maxschsize = 0;
+    int maxzchsize = 0;
+    for (int sch = 0; sch < mesh->numsch; ++sch) {
+        maxschsize = max(maxschsize,
+                mesh->schslast[sch] - mesh->schsfirst[sch]);
+        maxzchsize = max(maxzchsize,
+                mesh->schzlast[sch] - mesh->schzfirst[sch]);
+    }
+    for (int zch = 0; zch < mesh->numzch; ++zch)
+        maxzchsize = max(maxzchsize,
+                mesh->zchzlast[zch] - mesh->zchzfirst[zch]);
+    const size_t scratchsize = (12 * maxschsize + maxzchsize) *
+            sizeof(double) + 8 * Memory::Arena::align;
+    Exec::onEachThread([&](const int) {
+        Memory::Arena::local().reserve(scratchsize, hugepages != 0);
+    });
+
+}
+
+
+void Hydro::initForceArrays() {
+
+    if (forcearrays == (int) fuseforce) return;
+
+    if (forcearrays == 0) {
+        Memory::free2(sfp);
+        Memory::free2(sfq);
+        Memory::free2(sft);
+    }
+    else if (forcearrays == 1)
+        Memory::free2(sfpq);
+
+    const int nums = mesh->nums;
+    const int* sfirst = &mesh->schsfirst[0];
+    const int* slast = &mesh->schslast[0];
+    const int numsch = mesh->numsch;
+    if (fuseforce) {
+        sfpq = Memory::alloc2(nums);
+        if (mesh->firsttouch)
+            Memory::touch2(sfpq, sfirst, slast, numsch);
+    }
+    else {
+        sfp = Memory::alloc2(nums);
+        sfq = Memory::alloc2(nums);
+        sft = Memory::alloc2(nums);
+        if (mesh->firsttouch) {
+            Memory::touch2(sfp, sfirst, slast, numsch);
+            Memory::touch2(sfq, sfirst, slast, numsch);
+            Memory::touch2(sft, sfirst, slast, numsch);
+        }
+    }
+    forcearrays = fuseforce;
+
+}
+
+
+void Hydro::redistribute() {
+
+    const int nump = mesh->nump;
+    const int numz = mesh->numz;
+    const int nums = mesh->nums;
+    const int* sfirst = &mesh->schsfirst[0];
+    const int* slast = &mesh->schslast[0];
+    const int* zfirst = &mesh->schzfirst[0];
+    const int* zlast = &mesh->schzlast[0];
+    const int* pfirst = &mesh->pchpfirst[0];
+    const int* plast = &mesh->pchplast[0];
+    const int numsch = mesh->numsch;
+    const int numpch = mesh->numpch;
+    pu     = Memory::distribute2(pu,    nump, pfirst, plast, numpch);
+    pu0    = Memory::distribute2(pu0,   nump, pfirst, plast, numpch);
+    pap    = Memory::distribute2(pap,   nump, pfirst, plast, numpch);
+    pf     = Memory::distribute2(pf,    nump, pfirst, plast, numpch);
+    pmaswt = Memory::distribute(pmaswt, nump, pfirst, plast, numpch);
+    cmaswt = Memory::distribute(cmaswt, nums, sfirst, slast, numsch);
+    cftot  = Memory::distribute2(cftot, nums, sfirst, slast, numsch);
+    if (forcearrays == 1)
+        sfpq = Memory::distribute2(sfpq, nums, sfirst, slast, numsch);
+    else if (forcearrays == 0) {
+        sfp = Memory::distribute2(sfp, nums, sfirst, slast, numsch);
+        sfq = Memory::distribute2(sfq, nums, sfirst, slast, numsch);
+        sft = Memory::distribute2(sft, nums, sfirst, slast, numsch);
+    }
+    double** zarr[] = { &zm, &zr, &zrp, &ze, &zetot, &zw, &zwrate,
+            &zp, &zss, &zdu };
+    for (int i = 0; i < sizeof(zarr) / sizeof(zarr[0]); ++i)
+        *zarr[i] = Memory::distribute(*zarr[i], numz,
+                zfirst, zlast, numsch);
+
+}
+
+
+void Hydro::resetChunks() {
+
+    for (int i = 0; i < bcs.size(); ++i)
+        bcs[i]->initChunks();
+    dtzch.resize(mesh->numzch);
+    whydtzch.resize(mesh->numzch);
+    reserveScratch();
+    delete graph;
+    graph = NULL;
+    if (taskgraph) initTaskGraph();
+
+}
+
+
+void Hydro::initTaskGraph() {
+
+    const int numpch = mesh->numpch;
+    const int numsch = mesh->numsch;
+    const int numzch = mesh->numzch;
+
+    // point chunk of each point, side chunk of each zone
+    vector<int> mappch(mesh->nump), mapzsch(mesh->numz);
+    for (int pch = 0; pch < numpch; ++pch)
+        for (int p = mesh->pchpfirst[pch]; p < mesh->pchplast[pch]; ++p)
+            mappch[p] = pch;
+    for (int sch = 0; sch < numsch; ++sch)
+        for (int z = mesh->schzfirst[sch]; z < mesh->schzlast[sch]; ++z)
+            mapzsch[z] = sch;
+
+    graph = new TaskGraph();
+    vector<int> tpredp(numpch), tsump(numpch), tcorrp(numpch);
+    vector<int> tpreds(numsch), tcorrs(numsch);
+    vector<int> tzones(numzch);
+    for (int pch = 0; pch < numpch; ++pch) {
+        tpredp[pch] = graph->addTask(taskPredPoints, pch);
+        tsump[pch] = graph->addTask(taskSumPoints, pch);
+        tcorrp[pch] = graph->addTask(taskCorrPoints, pch);
+    }
+    for (int sch = 0; sch < numsch; ++sch) {
+        tpreds[sch] = graph->addTask(taskPredSides, sch);
+        tcorrs[sch] = graph->addTask(taskCorrSides, sch);
+    }
+    for (int zch = 0; zch < numzch; ++zch)
+        tzones[zch] = graph->addTask(taskZones, zch);
+
+    // a side chunk depends on the point chunks holding its points,
+    // in both the predictor and corrector; the point sums depend
+    // on all side chunks with corners at their points.  (Each
+    // point of a zone is the first point of one of its sides, so
+    // sidePoint1Any finds them all.)
+    for (int sch = 0; sch < numsch; ++sch) {
+        int pchlast = -1;
+        for (int s = mesh->schsfirst[sch]; s < mesh->schslast[sch]; ++s) {
+            int pch = mappch[mesh->sidePoint1Any(s)];
+            if (pch == pchlast) continue;
+            pchlast = pch;
+            graph->addDep(tpredp[pch], tpreds[sch]);
+            graph->addDep(tpreds[sch], tsump[pch]);
+            graph->addDep(tcorrp[pch], tcorrs[sch]);
+        }
+    }
+
+    // with MPI, shared points need the local sums of all chunks
+    // with shared points to be done; the interior chunks can go
+    // on while they are exchanged
+    for (int pch = 0; pch < numpch; ++pch)
+        graph->addDep(tsump[pch], tcorrp[pch]);
+    if (!mesh->pchshared.empty()) {
+        int tshared = graph->addTask(taskSumShared, 0);
+        for (int i = 0; i < mesh->pchshared.size(); ++i) {
+            int pch = mesh->pchshared[i];
+            graph->addDep(tsump[pch], tshared);
+            graph->addDep(tshared, tcorrp[pch]);
+        }
+    }
+
+    // zone chunks depend on the side chunks holding their zones
+    for (int zch = 0; zch < numzch; ++zch) {
+        int schlast = -1;
+        for (int z = mesh->zchzfirst[zch]; z < mesh->zchzlast[zch]; ++z) {
+            int sch = mapzsch[z];
+            if (sch == schlast) continue;
+            schlast = sch;
+            graph->addDep(tcorrs[sch], tzones[zch]);
+        }
+    }
+
+    graph->finalize();
+
 }
 
 
@@ -153,7 +381,7 @@ void Hydro::initRadialVel(
         const double vel,
         const int pfirst,
         const int plast) {
-    const double2* px = mesh->px;
+    double2cptr px = mesh->px;
     const double eps = 1.e-12;
 
     #pragma ivdep
@@ -170,148 +398,363 @@ void Hydro::initRadialVel(
 void Hydro::doCycle(
             const double dt) {
 
+    if (taskgraph) {
+        doCycleTasks(dt);
+        return;
+    }
+
     const int numpch = mesh->numpch;
     const int numsch = mesh->numsch;
-    double2* px = mesh->px;
-    double2* ex = mesh->ex;
-    double2* zx = mesh->zx;
-    double* sarea = mesh->sarea;
-    double* svol = mesh->svol;
-    double* zarea = mesh->zarea;
-    double* zvol = mesh->zvol;
+    const int numzch = mesh->numzch;
+
+    fill(dtzch.begin(), dtzch.end(), 1.e99);
+
+    const vector<int>& pchshared = mesh->pchshared;
+    const vector<int>& pchinterior = mesh->pchinterior;
+
+    // The whole cycle runs in one team region.  Each chunk loop
+    // below ends with the barrier that's needed before the next
+    // loop reads what it wrote; there are no other barriers,
+    // except around the MPI exchange of shared point sums.
+    Exec::team([&]() {
+
+    // Begin hydro cycle
+    Exec::parallelFor(numpch, [&](const int pch) {
+        predictPoints(pch, dt);
+    });
+
+    Exec::parallelFor(numsch, [&](const int sch) {
+        predictSides(sch, dt);
+    });
+    #pragma omp master
+    mesh->checkBadSides();
+
+    // sum corner masses, forces to points, both in one pass over
+    // the corners and one exchange.  Point chunks with points
+    // shared with other PEs are summed first, so that the
+    // exchange of shared point sums can go on while the interior
+    // chunks are summed and advanced.  (MPI calls are made by the
+    // master thread only.)
+    Exec::parallelFor(pchshared.size(), [&](const int i) {
+        mesh->sumToPointsChunk(cmaswt, cftot, pmaswt, pf, pchshared[i]);
+    });
+    mesh->startSharedSum(pmaswt, pf);
+
+    Exec::parallelFor(pchinterior.size(), [&](const int i) {
+        mesh->sumToPointsChunk(cmaswt, cftot, pmaswt, pf,
+                pchinterior[i]);
+        correctPoints(pchinterior[i], dt);
+    });
+
+    mesh->finishSharedSums();
+    Exec::parallelFor(pchshared.size(), [&](const int i) {
+        correctPoints(pchshared[i], dt);
+    });
+
+    Exec::parallelFor(numsch, [&](const int sch) {
+        correctSides(sch, dt);
+    });
+    #pragma omp master
+    mesh->checkBadSides();
+
+    // each zone chunk keeps its own timestep limit, so the result
+    // doesn't depend on which thread ran it
+    Exec::parallelFor(numzch, [&](const int zch) {
+        updateZones(zch, dt, dtzch[zch], whydtzch[zch]);
+    });
+
+    });  // team
+
+    exchangeGhosts();
+    dtpred = 0.;
+    combineDtChunks();
+
+}
+
+
+void Hydro::speculate(
+            const double dtguess) {
+
+    Exec::parallelFor(mesh->numpch, [&](const int pch) {
+        predictPoints(pch, dtguess);
+    });
+    dtpred = dtguess;
+
+}
+
+
+void Hydro::doCycleTasks(
+            const double dt) {
+
+    dtcycle = dt;
+    fill(dtzch.begin(), dtzch.end(), 1.e99);
+    graph->run(this);
+    mesh->checkBadSides();
+    exchangeGhosts();
+    dtpred = 0.;
+
+    combineDtChunks();
+
+}
+
+
+void Hydro::exchangeGhosts() {
+
+    if (!mesh->ghostzones) return;
+
+    // the state carried over to the next cycle:  the zone
+    // volume becomes zvol0, and the rest of the zone geometry is
+    // recomputed from the points
+    double* zvars[] = { zr, ze, zetot, zwrate, mesh->zvol };
+    const double2ptr pvars[] = { mesh->px, pu };
+    mesh->exchangeGhosts(5, zvars, 2, pvars);
+
+}
+
+
+void Hydro::combineDtChunks() {
+
+    // take the chunks in order, as a serial run would
+    resetDtHydro();
+    for (int zch = 0; zch < mesh->numzch; ++zch) {
+        if (dtzch[zch] < dtrec) {
+            dtrec = dtzch[zch];
+            whydtrec = whydtzch[zch];
+        }
+    }
+
+}
+
+
+void Hydro::runTask(
+            const int kind,
+            const int index) {
+
+    switch (kind) {
+    case taskPredPoints:
+        predictPoints(index, dtcycle);
+        break;
+    case taskPredSides:
+        predictSides(index, dtcycle);
+        break;
+    case taskSumPoints:
+        mesh->sumToPointsChunk(cmaswt, cftot, pmaswt, pf, index);
+        break;
+    case taskSumShared:
+        mesh->sumSharedPoints(pmaswt, pf);
+        break;
+    case taskCorrPoints:
+        correctPoints(index, dtcycle);
+        break;
+    case taskCorrSides:
+        correctSides(index, dtcycle);
+        break;
+    case taskZones:
+        updateZones(index, dtcycle, dtzch[index], whydtzch[index]);
+        break;
+    }
+
+}
+
+
+void Hydro::predictPoints(
+            const int pch,
+            const double dt) {
+
+    const int pfirst = mesh->pchpfirst[pch];
+    const int plast = mesh->pchplast[pch];
+    double2cptr px = mesh->px;
+    double2ptr px0 = mesh->px0;
+    double2ptr pxp = mesh->pxp;
+
+    // if speculate already ran the predictor, only the half-step
+    // position depends on dt, and only if the guess was wrong
+    if (dtpred == dt) return;
+
+    // save off point variable values from previous cycle
+    if (dtpred == 0.) {
+        for (int p = pfirst; p < plast; ++p) {
+            px0[p] = px[p];
+            pu0[p] = pu[p];
+        }
+    }
+
+    // ===== Predictor step =====
+    // 1. advance mesh to center of time step
+    advPosHalf(px0, pu0, dt, pxp, pfirst, plast);
+
+}
+
+
+void Hydro::predictSides(
+            const int sch,
+            const double dt) {
+
+    const int sfirst = mesh->schsfirst[sch];
+    const int slast = mesh->schslast[sch];
+    const int zfirst = mesh->schzfirst[sch];
+    const int zlast = mesh->schzlast[sch];
+    const double* zvol = mesh->zvol;
     double* sareap = mesh->sareap;
     double* svolp = mesh->svolp;
     double* zareap = mesh->zareap;
     double* zvolp = mesh->zvolp;
     double* zvol0 = mesh->zvol0;
-    double2* ssurfp = mesh->ssurfp;
+    double2ptr ssurfp = mesh->ssurfp;
     double* elen = mesh->elen;
-    double2* px0 = mesh->px0;
-    double2* pxp = mesh->pxp;
-    double2* exp = mesh->exp;
-    double2* zxp = mesh->zxp;
+    double2ptr pxp = mesh->pxp;
+    double2ptr exp = mesh->exp;
+    double2ptr zxp = mesh->zxp;
     double* smf = mesh->smf;
     double* zdl = mesh->zdl;
 
-    // Begin hydro cycle
-    #pragma omp parallel for schedule(static)
-    for (int pch = 0; pch < numpch; ++pch) {
-        int pfirst = mesh->pchpfirst[pch];
-        int plast = mesh->pchplast[pch];
-
-        // save off point variable values from previous cycle
-        copy(&px[pfirst], &px[plast], &px0[pfirst]);
-        copy(&pu[pfirst], &pu[plast], &pu0[pfirst]);
-
-        // ===== Predictor step =====
-        // 1. advance mesh to center of time step
-        advPosHalf(px0, pu0, dt, pxp, pfirst, plast);
-    } // for pch
-
-    #pragma omp parallel for schedule(static)
-    for (int sch = 0; sch < numsch; ++sch) {
-        int sfirst = mesh->schsfirst[sch];
-        int slast = mesh->schslast[sch];
-        int zfirst = mesh->schzfirst[sch];
-        int zlast = mesh->schzlast[sch];
-
-        // save off zone variable values from previous cycle
-        copy(&zvol[zfirst], &zvol[zlast], &zvol0[zfirst]);
+    // save off zone variable values from previous cycle
+    copy(&zvol[zfirst], &zvol[zlast], &zvol0[zfirst]);
 
-        // 1a. compute new mesh geometry
+    // 1a. compute new mesh geometry
+    // (a structured mesh always uses the fused kernel)
+    if (mesh->fusegeom || mesh->structured)
+        mesh->calcGeometry(pxp, exp, zxp, sareap, svolp, zareap, zvolp,
+                ssurfp, elen, zdl, sfirst, slast);
+    else {
         mesh->calcCtrs(pxp, exp, zxp, sfirst, slast);
         mesh->calcVols(pxp, zxp, sareap, svolp, zareap, zvolp,
                 sfirst, slast);
         mesh->calcSurfVecs(zxp, exp, ssurfp, sfirst, slast);
         mesh->calcEdgeLen(pxp, elen, sfirst, slast);
         mesh->calcCharLen(sareap, zdl, sfirst, slast);
+    }
 
-        // 2. compute point masses
-        calcRho(zm, zvolp, zrp, zfirst, zlast);
-        calcCrnrMass(zrp, zareap, smf, cmaswt, sfirst, slast);
+    // 2. compute point masses
+    calcRho(zm, zvolp, zrp, zfirst, zlast);
+    calcCrnrMass(zrp, zareap, smf, cmaswt, sfirst, slast);
+
+    // 3. compute material state (half-advanced)
+    pgas->calcStateAtHalf(zr, zvolp, zvol0, ze, zwrate, zm, dt,
+            zp, zss, zfirst, zlast);
+
+    // 4. compute forces, one sub-chunk at a time so that the
+    // intermediate results stay in cache between steps
+    for (int sub = mesh->schsubfirst[sch];
+            sub < mesh->schsubfirst[sch + 1]; ++sub) {
+        int subfirst = mesh->subsfirst[sub];
+        int sublast = mesh->subslast[sub];
+        if (fuseforce) {
+            // the Q force is only needed by the fused kernel, so
+            // it goes to a scratch array instead of sfq
+            Memory::ArenaScope scratch;
+            double2ptr sfqsub = Memory::scratch2(scratch,
+                    subfirst, sublast);
+            qcs->calcForce(sfqsub, subfirst, sublast);
+            calcForceFused(zp, zareap, zrp, zss, sareap, smf, ssurfp,
+                    sfqsub, sfpq, cftot, subfirst, sublast);
+            continue;
+        }
+        pgas->calcForce(zp, ssurfp, sfp, subfirst, sublast);
+        tts->calcForce(zareap, zrp, zss, sareap, smf, ssurfp, sft,
+                subfirst, sublast);
+        qcs->calcForce(sfq, subfirst, sublast);
+        sumCrnrForce(sfp, sfq, sft, cftot, subfirst, sublast);
+    }
 
-        // 3. compute material state (half-advanced)
-        pgas->calcStateAtHalf(zr, zvolp, zvol0, ze, zwrate, zm, dt,
-                zp, zss, zfirst, zlast);
+}
 
-        // 4. compute forces
-        pgas->calcForce(zp, ssurfp, sfp, sfirst, slast);
-        tts->calcForce(zareap, zrp, zss, sareap, smf, ssurfp, sft,
-                sfirst, slast);
-        qcs->calcForce(sfq, sfirst, slast);
-        sumCrnrForce(sfp, sfq, sft, cftot, sfirst, slast);
-    }  // for sch
-    mesh->checkBadSides();
 
-    // sum corner masses, forces to points
-    mesh->sumToPoints(cmaswt, pmaswt);
-    mesh->sumToPoints(cftot, pf);
+void Hydro::correctPoints(
+            const int pch,
+            const double dt) {
 
-    #pragma omp parallel for schedule(static)
-    for (int pch = 0; pch < numpch; ++pch) {
-        int pfirst = mesh->pchpfirst[pch];
-        int plast = mesh->pchplast[pch];
+    const int pfirst = mesh->pchpfirst[pch];
+    const int plast = mesh->pchplast[pch];
+    double2ptr px = mesh->px;
+    double2cptr px0 = mesh->px0;
 
-        // 4a. apply boundary conditions
-        for (int i = 0; i < bcs.size(); ++i) {
-            int bfirst = bcs[i]->pchbfirst[pch];
-            int blast = bcs[i]->pchblast[pch];
-            bcs[i]->applyFixedBC(pu0, pf, bfirst, blast);
-        }
+    // 4a. apply boundary conditions
+    for (int i = 0; i < bcs.size(); ++i) {
+        int bfirst = bcs[i]->pchbfirst[pch];
+        int blast = bcs[i]->pchblast[pch];
+        bcs[i]->applyFixedBC(pu0, pf, bfirst, blast);
+    }
 
-        // 5. compute accelerations
-        calcAccel(pf, pmaswt, pap, pfirst, plast);
+    // 5. compute accelerations
+    calcAccel(pf, pmaswt, pap, pfirst, plast);
 
-        // ===== Corrector step =====
-        // 6. advance mesh to end of time step
-        advPosFull(px0, pu0, pap, dt, px, pu, pfirst, plast);
-    }  // for pch
+    // ===== Corrector step =====
+    // 6. advance mesh to end of time step
+    advPosFull(px0, pu0, pap, dt, px, pu, pfirst, plast);
 
-    resetDtHydro();
+}
 
-    #pragma omp parallel for schedule(static)
-    for (int sch = 0; sch < numsch; ++sch) {
-        int sfirst = mesh->schsfirst[sch];
-        int slast = mesh->schslast[sch];
-        int zfirst = mesh->schzfirst[sch];
-        int zlast = mesh->schzlast[sch];
 
-        // 6a. compute new mesh geometry
-        mesh->calcCtrs(px, ex, zx, sfirst, slast);
-        mesh->calcVols(px, zx, sarea, svol, zarea, zvol,
-                sfirst, slast);
+void Hydro::correctSides(
+            const int sch,
+            const double dt) {
 
-        // 7. compute work
-        fill(&zw[zfirst], &zw[zlast], 0.);
+    const int sfirst = mesh->schsfirst[sch];
+    const int slast = mesh->schslast[sch];
+    const int zfirst = mesh->schzfirst[sch];
+    const int zlast = mesh->schzlast[sch];
+    double2ptr px = mesh->px;
+    double2ptr ex = mesh->ex;
+    double2ptr zx = mesh->zx;
+    double* sarea = mesh->sarea;
+    double* svol = mesh->svol;
+    double* zarea = mesh->zarea;
+    double* zvol = mesh->zvol;
+    double2cptr pxp = mesh->pxp;
+
+    // 6a. compute new mesh geometry
+    mesh->calcCtrs(px, ex, zx, sfirst, slast);
+    mesh->calcVols(px, zx, sarea, svol, zarea, zvol,
+            sfirst, slast);
+
+    // 7. compute work
+    fill(&zw[zfirst], &zw[zlast], 0.);
+    if (fuseforce)
+        calcWork(sfpq, pu0, pu, pxp, dt, zw, zetot, sfirst, slast);
+    else
         calcWork(sfp, sfq, pu0, pu, pxp, dt, zw, zetot,
                 sfirst, slast);
-    }  // for sch
-    mesh->checkBadSides();
 
-    #pragma omp parallel for schedule(static)
-    for (int zch = 0; zch < mesh->numzch; ++zch) {
-        int zfirst = mesh->zchzfirst[zch];
-        int zlast = mesh->zchzlast[zch];
+}
+
 
-        // 7a. compute work rate
-        calcWorkRate(zvol0, zvol, zw, zp, dt, zwrate, zfirst, zlast);
+void Hydro::updateZones(
+            const int zch,
+            const double dt,
+            double& dtrec,
+            DtReason& whydtrec) {
 
-        // 8. update state variables
-        calcEnergy(zetot, zm, ze, zfirst, zlast);
-        calcRho(zm, zvol, zr, zfirst, zlast);
+    const int zfirst = mesh->zchzfirst[zch];
+    const int zlast = mesh->zchzlast[zch];
+    const double* zvol = mesh->zvol;
+    const double* zvol0 = mesh->zvol0;
+    const double* zdl = mesh->zdl;
 
-        // 9.  compute timestep for next cycle
-        calcDtHydro(zdl, zvol, zvol0, dt, zfirst, zlast);
-    }  // for zch
+    // 7a. compute work rate
+    calcWorkRate(zvol0, zvol, zw, zp, dt, zwrate, zfirst, zlast);
+
+    // 8. update state variables
+    calcEnergy(zetot, zm, ze, zfirst, zlast);
+    calcRho(zm, zvol, zr, zfirst, zlast);
+
+    // 9.  compute timestep for next cycle, from the zones owned
+    // by this PE (ghost zones aren't right until exchanged)
+    int rfirst, rlast;
+    mesh->getOwnedRuns(zfirst, zlast, rfirst, rlast);
+    for (int r = rfirst; r < rlast; ++r)
+        calcDtHydro(zdl, zvol, zvol0, dt, dtrec, whydtrec,
+                max(zfirst, mesh->ownzfirst[r]),
+                min(zlast, mesh->ownzlast[r]));
 
 }
 
 
 void Hydro::advPosHalf(
-        const double2* px0,
-        const double2* pu0,
+        double2cptr px0,
+        double2cptr pu0,
         const double dt,
-        double2* pxp,
+        double2ptr pxp,
         const int pfirst,
         const int plast) {
 
@@ -325,12 +768,12 @@ void Hydro::advPosHalf(
 
 
 void Hydro::advPosFull(
-        const double2* px0,
-        const double2* pu0,
-        const double2* pa,
+        double2cptr px0,
+        double2cptr pu0,
+        double2cptr pa,
         const double dt,
-        double2* px,
-        double2* pu,
+        double2ptr px,
+        double2ptr pu,
         const int pfirst,
         const int plast) {
 
@@ -343,6 +786,31 @@ void Hydro::advPosFull(
 }
 
 
+template <int N>
+void Hydro::calcCrnrMassBatch(
+        const double* zr,
+        const double* zarea,
+        const double* smf,
+        double* cmaswt,
+        const int sfirst,
+        const int slast) {
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+        const double zra = zr[z] * zarea[z];
+
+        for (int i = 0; i < n; ++i) {
+            int s3 = s1 + (i == 0 ? n - 1 : i - 1);
+            double m = zra * 0.5 * (smf[s1 + i] + smf[s3]);
+            cmaswt[s1 + i] = m;
+        }
+        s1 += n;
+    }
+}
+
+
 void Hydro::calcCrnrMass(
         const double* zr,
         const double* zarea,
@@ -351,6 +819,34 @@ void Hydro::calcCrnrMass(
         const int sfirst,
         const int slast) {
 
+    if (mesh->structured) {
+        calcCrnrMassBatch<Mesh::rect>(zr, zarea, smf, cmaswt, sfirst, slast);
+        return;
+    }
+
+    if (mesh->numbat > 0) {
+        for (int b = 0; b < mesh->numbat; ++b) {
+            int sf = max(sfirst, mesh->batsfirst[b]);
+            int sl = min(slast, mesh->batslast[b]);
+            if (sf >= sl) continue;
+            switch (mesh->batnump[b]) {
+            case 3:
+                calcCrnrMassBatch<3>(zr, zarea, smf, cmaswt, sf, sl);
+                break;
+            case 4:
+                calcCrnrMassBatch<4>(zr, zarea, smf, cmaswt, sf, sl);
+                break;
+            case 6:
+                calcCrnrMassBatch<6>(zr, zarea, smf, cmaswt, sf, sl);
+                break;
+            default:
+                calcCrnrMassBatch<0>(zr, zarea, smf, cmaswt, sf, sl);
+                break;
+            }
+        }
+        return;
+    }
+
     #pragma ivdep
     for (int s = sfirst; s < slast; ++s) {
         int s3 = mesh->mapss3[s];
@@ -362,14 +858,59 @@ void Hydro::calcCrnrMass(
 }
 
 
+template <int N>
+void Hydro::sumCrnrForceBatch(
+        double2cptr sf,
+        double2cptr sf2,
+        double2cptr sf3,
+        double2ptr cftot,
+        const int sfirst,
+        const int slast) {
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int n = mesh->zoneSides<N>(mesh->sideZone<N>(s1));
+
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            int s3 = s1 + (i == 0 ? n - 1 : i - 1);
+            double2 f = (sf[s] + sf2[s] + sf3[s]) -
+                        (sf[s3] + sf2[s3] + sf3[s3]);
+            cftot[s] = f;
+        }
+        s1 += n;
+    }
+}
+
+
 void Hydro::sumCrnrForce(
-        const double2* sf,
-        const double2* sf2,
-        const double2* sf3,
-        double2* cftot,
+        double2cptr sf,
+        double2cptr sf2,
+        double2cptr sf3,
+        double2ptr cftot,
         const int sfirst,
         const int slast) {
 
+    if (mesh->structured) {
+        sumCrnrForceBatch<Mesh::rect>(sf, sf2, sf3, cftot, sfirst, slast);
+        return;
+    }
+
+    if (mesh->numbat > 0) {
+        for (int b = 0; b < mesh->numbat; ++b) {
+            int bf = max(sfirst, mesh->batsfirst[b]);
+            int bl = min(slast, mesh->batslast[b]);
+            if (bf >= bl) continue;
+            switch (mesh->batnump[b]) {
+            case 3:  sumCrnrForceBatch<3>(sf, sf2, sf3, cftot, bf, bl); break;
+            case 4:  sumCrnrForceBatch<4>(sf, sf2, sf3, cftot, bf, bl); break;
+            case 6:  sumCrnrForceBatch<6>(sf, sf2, sf3, cftot, bf, bl); break;
+            default: sumCrnrForceBatch<0>(sf, sf2, sf3, cftot, bf, bl); break;
+            }
+        }
+        return;
+    }
+
     #pragma ivdep
     for (int s = sfirst; s < slast; ++s) {
         int s3 = mesh->mapss3[s];
@@ -381,17 +922,193 @@ void Hydro::sumCrnrForce(
 }
 
 
+template <int N>
+void Hydro::diffCrnrForceBatch(
+        double2ptr cftot,
+        const int sfirst,
+        const int slast) {
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int n = mesh->zoneSides<N>(mesh->sideZone<N>(s1));
+
+        // work backwards, so that each side's total is still there
+        // when the next corner needs it
+        const double2 flast = cftot[s1 + n - 1];
+        for (int i = n - 1; i > 0; --i) {
+            int s = s1 + i;
+            cftot[s] = cftot[s] - cftot[s - 1];
+        }
+        cftot[s1] = cftot[s1] - flast;
+        s1 += n;
+    }
+}
+
+
+void Hydro::calcForceFused(
+        const double* zp,
+        const double* zarea,
+        const double* zr,
+        const double* zss,
+        const double* sarea,
+        const double* smf,
+        double2cptr ssurf,
+        double2cptr sfq,
+        double2ptr sfpq,
+        double2ptr cftot,
+        const int sfirst,
+        const int slast) {
+
+    // same arithmetic as PolyGas::calcForce, TTS::calcForce and
+    // sumCrnrForce, so the results are identical.  The total side
+    // force goes to cftot first, and is then turned into corner
+    // forces in place.
+    if (mesh->structured) {
+        calcForceFusedBatch<Mesh::rect>(zp, zarea, zr, zss, sarea, smf,
+                ssurf, sfq, sfpq, cftot, sfirst, slast);
+        return;
+    }
+    if (mesh->numbat > 0) {
+        for (int b = 0; b < mesh->numbat; ++b) {
+            int bf = max(sfirst, mesh->batsfirst[b]);
+            int bl = min(slast, mesh->batslast[b]);
+            if (bf >= bl) continue;
+            switch (mesh->batnump[b]) {
+            case 3:
+                calcForceFusedBatch<3>(zp, zarea, zr, zss, sarea, smf,
+                        ssurf, sfq, sfpq, cftot, bf, bl);
+                break;
+            case 4:
+                calcForceFusedBatch<4>(zp, zarea, zr, zss, sarea, smf,
+                        ssurf, sfq, sfpq, cftot, bf, bl);
+                break;
+            case 6:
+                calcForceFusedBatch<6>(zp, zarea, zr, zss, sarea, smf,
+                        ssurf, sfq, sfpq, cftot, bf, bl);
+                break;
+            default:
+                calcForceFusedBatch<0>(zp, zarea, zr, zss, sarea, smf,
+                        ssurf, sfq, sfpq, cftot, bf, bl);
+                break;
+            }
+        }
+        return;
+    }
+
+    const double alfa = tts->alfa;
+    const double ssmin = tts->ssmin;
+
+    using namespace Simd;
+    const int svlast = slast - (slast - sfirst) % width;
+    const vdouble valfa = set1(alfa), vssmin = set1(ssmin);
+    for (int s = sfirst; s < svlast; s += width) {
+        const int* z = &mesh->mapsz[s];
+        vdouble vzr = gather(zr, z);
+        vdouble sx, sy;
+        load2(ssurf, s, sx, sy);
+
+        vdouble r = -gather(zp, z);
+        vdouble svfacinv = gather(zarea, z) / load(&sarea[s]);
+        vdouble srho = vzr * load(&smf[s]) * svfacinv;
+        vdouble sstmp = max(gather(zss, z), vssmin);
+        sstmp = valfa * sstmp * sstmp;
+        vdouble nsdp = -(sstmp * (srho - vzr));
+
+        vdouble qx, qy;
+        load2(sfq, s, qx, qy);
+        vdouble fpqx = sx * r + qx;
+        vdouble fpqy = sy * r + qy;
+        store2(sfpq, s, fpqx, fpqy);
+        store2(cftot, s, fpqx + sx * nsdp, fpqy + sy * nsdp);
+    }
+
+    #pragma ivdep
+    for (int s = svlast; s < slast; ++s) {
+        int z = mesh->mapsz[s];
+
+        double2 sfp = -zp[z] * ssurf[s];
+        double svfacinv = zarea[z] / sarea[s];
+        double srho = zr[z] * smf[s] * svfacinv;
+        double sstmp = max(zss[z], ssmin);
+        sstmp = alfa * sstmp * sstmp;
+        double sdp = sstmp * (srho - zr[z]);
+        double2 sft = -sdp * ssurf[s];
+
+        double2 fpq = sfp + sfq[s];
+        sfpq[s] = fpq;
+        cftot[s] = fpq + sft;
+    }
+
+    diffCrnrForceBatch<0>(cftot, sfirst, slast);
+}
+
+
+template <int N>
+void Hydro::calcForceFusedBatch(
+        const double* zp,
+        const double* zarea,
+        const double* zr,
+        const double* zss,
+        const double* sarea,
+        const double* smf,
+        double2cptr ssurf,
+        double2cptr sfq,
+        double2ptr sfpq,
+        double2ptr cftot,
+        const int sfirst,
+        const int slast) {
+
+    const double alfa = tts->alfa;
+    const double ssmin = tts->ssmin;
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+        const double r = -zp[z];
+        double sstmp = max(zss[z], ssmin);
+        sstmp = alfa * sstmp * sstmp;
+
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            double2 sfp = r * ssurf[s];
+            double svfacinv = zarea[z] / sarea[s];
+            double srho = zr[z] * smf[s] * svfacinv;
+            double sdp = sstmp * (srho - zr[z]);
+            double2 sft = -sdp * ssurf[s];
+
+            double2 fpq = sfp + sfq[s];
+            sfpq[s] = fpq;
+            cftot[s] = fpq + sft;
+        }
+        s1 += n;
+    }
+
+    diffCrnrForceBatch<N>(cftot, sfirst, slast);
+}
+
+
 void Hydro::calcAccel(
-        const double2* pf,
+        double2cptr pf,
         const double* pmass,
-        double2* pa,
+        double2ptr pa,
         const int pfirst,
         const int plast) {
 
     const double fuzz = 1.e-99;
 
+    using namespace Simd;
+    const int pvlast = plast - (plast - pfirst) % width;
+    const vdouble vone = set1(1.), vfuzz = set1(fuzz);
+    for (int p = pfirst; p < pvlast; p += width) {
+        vdouble rinv = vone / max(load(&pmass[p]), vfuzz);
+        vdouble fx, fy;
+        load2(pf, p, fx, fy);
+        store2(pa, p, fx * rinv, fy * rinv);
+    }
+
     #pragma ivdep
-    for (int p = pfirst; p < plast; ++p) {
+    for (int p = pvlast; p < plast; ++p) {
         pa[p] = pf[p] / max(pmass[p], fuzz);
     }
 
@@ -405,20 +1122,65 @@ void Hydro::calcRho(
         const int zfirst,
         const int zlast) {
 
+    using namespace Simd;
+    const int zvlast = zlast - (zlast - zfirst) % width;
+    for (int z = zfirst; z < zvlast; z += width) {
+        store(&zr[z], load(&zm[z]) / load(&zvol[z]));
+    }
+
     #pragma ivdep
-    for (int z = zfirst; z < zlast; ++z) {
+    for (int z = zvlast; z < zlast; ++z) {
         zr[z] = zm[z] / zvol[z];
     }
 
 }
 
 
+template <int N, bool Sum2>
+void Hydro::calcWorkBatch(
+        double2cptr sf,
+        double2cptr sf2,
+        double2cptr pu0,
+        double2cptr pu,
+        double2cptr px,
+        const double dt,
+        double* zw,
+        double* zetot,
+        const int sfirst,
+        const int slast) {
+
+    const double dth = 0.5 * dt;
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            int p1 = mesh->sidePoint1<N>(s1, z, i);
+            int p2 = mesh->sidePoint2<N>(s1, z, i);
+
+            double2 sftot = (Sum2 ? sf[s] + sf2[s] : sf[s]);
+            double sd1 = dot( sftot, (pu0[p1] + pu[p1]));
+            double sd2 = dot(-sftot, (pu0[p2] + pu[p2]));
+            double dwork = -dth * (sd1 * px[p1].x + sd2 * px[p2].x);
+
+            zetot[z] += dwork;
+            zw[z] += dwork;
+        }
+        s1 += n;
+    }
+
+}
+
+
 void Hydro::calcWork(
-        const double2* sf,
-        const double2* sf2,
-        const double2* pu0,
-        const double2* pu,
-        const double2* px,
+        double2cptr sf,
+        double2cptr sf2,
+        double2cptr pu0,
+        double2cptr pu,
+        double2cptr px,
         const double dt,
         double* zw,
         double* zetot,
@@ -430,22 +1192,33 @@ void Hydro::calcWork(
     // where force is the force of the element on the node
     // and vavg is the average velocity of the node over the time period
 
-    const double dth = 0.5 * dt;
+    if (mesh->structured)
+        calcWorkBatch<Mesh::rect, true>(sf, sf2, pu0, pu, px, dt,
+                zw, zetot, sfirst, slast);
+    else
+        calcWorkBatch<0, true>(sf, sf2, pu0, pu, px, dt,
+                zw, zetot, sfirst, slast);
 
-    for (int s = sfirst; s < slast; ++s) {
-        int p1 = mesh->mapsp1[s];
-        int p2 = mesh->mapsp2[s];
-        int z = mesh->mapsz[s];
+}
 
-        double2 sftot = sf[s] + sf2[s];
-        double sd1 = dot( sftot, (pu0[p1] + pu[p1]));
-        double sd2 = dot(-sftot, (pu0[p2] + pu[p2]));
-        double dwork = -dth * (sd1 * px[p1].x + sd2 * px[p2].x);
 
-        zetot[z] += dwork;
-        zw[z] += dwork;
+void Hydro::calcWork(
+        double2cptr sf,
+        double2cptr pu0,
+        double2cptr pu,
+        double2cptr px,
+        const double dt,
+        double* zw,
+        double* zetot,
+        const int sfirst,
+        const int slast) {
 
-    }
+    if (mesh->structured)
+        calcWorkBatch<Mesh::rect, false>(sf, sf, pu0, pu, px, dt,
+                zw, zetot, sfirst, slast);
+    else
+        calcWorkBatch<0, false>(sf, sf, pu0, pu, px, dt,
+                zw, zetot, sfirst, slast);
 
 }
 
@@ -460,8 +1233,17 @@ void Hydro::calcWorkRate(
         const int zfirst,
         const int zlast) {
     double dtinv = 1. / dt;
+
+    using namespace Simd;
+    const int zvlast = zlast - (zlast - zfirst) % width;
+    const vdouble vdtinv = set1(dtinv);
+    for (int z = zfirst; z < zvlast; z += width) {
+        vdouble dvol = load(&zvol[z]) - load(&zvol0[z]);
+        store(&zwrate[z], (load(&zw[z]) + load(&zp[z]) * dvol) * vdtinv);
+    }
+
     #pragma ivdep
-    for (int z = zfirst; z < zlast; ++z) {
+    for (int z = zvlast; z < zlast; ++z) {
         double dvol = zvol[z] - zvol0[z];
         zwrate[z] = (zw[z] + zp[z] * dvol) * dtinv;
     }
@@ -477,8 +1259,16 @@ void Hydro::calcEnergy(
         const int zlast) {
 
     const double fuzz = 1.e-99;
+
+    using namespace Simd;
+    const int zvlast = zlast - (zlast - zfirst) % width;
+    const vdouble vfuzz = set1(fuzz);
+    for (int z = zfirst; z < zvlast; z += width) {
+        store(&ze[z], load(&zetot[z]) / (load(&zm[z]) + vfuzz));
+    }
+
     #pragma ivdep
-    for (int z = zfirst; z < zlast; ++z) {
+    for (int z = zvlast; z < zlast; ++z) {
         ze[z] = zetot[z] / (zm[z] + fuzz);
     }
 
@@ -491,8 +1281,8 @@ void Hydro::sumEnergy(
         const double* zvol,
         const double* zm,
         const double* smf,
-        const double2* px,
-        const double2* pu,
+        double2cptr px,
+        double2cptr pu,
         double& ei,
         double& ek,
         const int zfirst,
@@ -514,14 +1304,44 @@ void Hydro::sumEnergy(
     //         = zm sum(c in z) [cvol / zvol * .5 * u ^ 2]
     //         = sum(c in z) [zm * cvol / zvol * .5 * u ^ 2]
     double sumk = 0.; 
-    for (int s = sfirst; s < slast; ++s) {
-        int s3 = mesh->mapss3[s];
-        int p1 = mesh->mapsp1[s];
-        int z = mesh->mapsz[s];
-
-        double cvol = zarea[z] * px[p1].x * 0.5 * (smf[s] + smf[s3]);
-        double cke = zm[z] * cvol / zvol[z] * 0.5 * length2(pu[p1]);
-        sumk += cke;
+    if (mesh->structured)
+        sumKinEnergyBatch<Mesh::rect>(zarea, zvol, zm, smf, px, pu, sumk,
+                sfirst, slast);
+    else if (mesh->numbat > 0) {
+        for (int b = 0; b < mesh->numbat; ++b) {
+            int bf = max(sfirst, mesh->batsfirst[b]);
+            int bl = min(slast, mesh->batslast[b]);
+            if (bf >= bl) continue;
+            switch (mesh->batnump[b]) {
+            case 3:
+                sumKinEnergyBatch<3>(zarea, zvol, zm, smf, px, pu, sumk,
+                        bf, bl);
+                break;
+            case 4:
+                sumKinEnergyBatch<4>(zarea, zvol, zm, smf, px, pu, sumk,
+                        bf, bl);
+                break;
+            case 6:
+                sumKinEnergyBatch<6>(zarea, zvol, zm, smf, px, pu, sumk,
+                        bf, bl);
+                break;
+            default:
+                sumKinEnergyBatch<0>(zarea, zvol, zm, smf, px, pu, sumk,
+                        bf, bl);
+                break;
+            }
+        }
+    }
+    else {
+        for (int s = sfirst; s < slast; ++s) {
+            int s3 = mesh->mapss3[s];
+            int p1 = mesh->mapsp1[s];
+            int z = mesh->mapsz[s];
+
+            double cvol = zarea[z] * px[p1].x * 0.5 * (smf[s] + smf[s3]);
+            double cke = zm[z] * cvol / zvol[z] * 0.5 * length2(pu[p1]);
+            sumk += cke;
+        }
     }
     // multiply by 2\pi for cylindrical geometry
     ek += sumk * 2 * M_PI;
@@ -529,17 +1349,65 @@ void Hydro::sumEnergy(
 }
 
 
+template <int N>
+void Hydro::sumKinEnergyBatch(
+        const double* zarea,
+        const double* zvol,
+        const double* zm,
+        const double* smf,
+        double2cptr px,
+        double2cptr pu,
+        double& sumk,
+        const int sfirst,
+        const int slast) {
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            int s3 = s1 + (i == 0 ? n - 1 : i - 1);
+            int p1 = mesh->sidePoint1<N>(s1, z, i);
+
+            double cvol = zarea[z] * px[p1].x * 0.5 * (smf[s] + smf[s3]);
+            double cke = zm[z] * cvol / zvol[z] * 0.5 * length2(pu[p1]);
+            sumk += cke;
+        }
+        s1 += n;
+    }
+
+}
+
+
 void Hydro::calcDtCourant(
         const double* zdl,
         double& dtrec,
-        char* msgdtrec,
+        DtReason& whydtrec,
         const int zfirst,
         const int zlast) {
 
     const double fuzz = 1.e-99;
     double dtnew = 1.e99;
     int zmin = -1;
-    for (int z = zfirst; z < zlast; ++z) {
+
+    // vector search keeps a running minimum and its zone index
+    // in each lane, then combines the lanes
+    using namespace Simd;
+    const int zvlast = zlast - (zlast - zfirst) % width;
+    const vdouble vfuzz = set1(fuzz), vcfl = set1(cfl);
+    vdouble vdtnew = set1(dtnew), vzmin = set1(zmin);
+    for (int z = zfirst; z < zvlast; z += width) {
+        vdouble cdu = max(load(&zdu[z]), max(load(&zss[z]), vfuzz));
+        vdouble zdthyd = load(&zdl[z]) * vcfl / cdu;
+        vmask lt = (zdthyd < vdtnew);
+        vzmin = select(lt, iota(z), vzmin);
+        vdtnew = select(lt, zdthyd, vdtnew);
+    }
+    reduceMinLoc(vdtnew, vzmin, dtnew, zmin);
+
+    for (int z = zvlast; z < zlast; ++z) {
         double cdu = max(zdu[z], max(zss[z], fuzz));
         double zdthyd = zdl[z] * cfl / cdu;
         zmin = (zdthyd < dtnew ? z : zmin);
@@ -548,7 +1416,8 @@ void Hydro::calcDtCourant(
 
     if (dtnew < dtrec) {
         dtrec = dtnew;
-        snprintf(msgdtrec, 80, "Hydro Courant limit for z = %d", zmin);
+        whydtrec.kind = dtCourant;
+        whydtrec.zone = zmin;
     }
 
 }
@@ -559,13 +1428,26 @@ void Hydro::calcDtVolume(
         const double* zvol0,
         const double dtlast,
         double& dtrec,
-        char* msgdtrec,
+        DtReason& whydtrec,
         const int zfirst,
         const int zlast) {
 
     double dvovmax = 1.e-99;
     int zmax = -1;
-    for (int z = zfirst; z < zlast; ++z) {
+
+    using namespace Simd;
+    const int zvlast = zlast - (zlast - zfirst) % width;
+    vdouble vdvovmax = set1(dvovmax), vzmax = set1(zmax);
+    for (int z = zfirst; z < zvlast; z += width) {
+        vdouble vzvol0 = load(&zvol0[z]);
+        vdouble zdvov = Simd::abs((load(&zvol[z]) - vzvol0) / vzvol0);
+        vmask gt = (zdvov > vdvovmax);
+        vzmax = select(gt, iota(z), vzmax);
+        vdvovmax = select(gt, zdvov, vdvovmax);
+    }
+    reduceMaxLoc(vdvovmax, vzmax, dvovmax, zmax);
+
+    for (int z = zvlast; z < zlast; ++z) {
         double zdvov = abs((zvol[z] - zvol0[z]) / zvol0[z]);
         zmax = (zdvov > dvovmax ? z : zmax);
         dvovmax = (zdvov > dvovmax ? zdvov : dvovmax);
@@ -573,7 +1455,8 @@ void Hydro::calcDtVolume(
     double dtnew = dtlast * cflv / dvovmax;
     if (dtnew < dtrec) {
         dtrec = dtnew;
-        snprintf(msgdtrec, 80, "Hydro dV/V limit for z = %d", zmax);
+        whydtrec.kind = dtVolume;
+        whydtrec.zone = zmax;
     }
 
 }
@@ -584,37 +1467,49 @@ void Hydro::calcDtHydro(
         const double* zvol,
         const double* zvol0,
         const double dtlast,
+        double& dtrec,
+        DtReason& whydtrec,
         const int zfirst,
         const int zlast) {
 
-    double dtchunk = 1.e99;
-    char msgdtchunk[80];
-
-    calcDtCourant(zdl, dtchunk, msgdtchunk, zfirst, zlast);
-    calcDtVolume(zvol, zvol0, dtlast, dtchunk, msgdtchunk,
+    calcDtCourant(zdl, dtrec, whydtrec, zfirst, zlast);
+    calcDtVolume(zvol, zvol0, dtlast, dtrec, whydtrec,
             zfirst, zlast);
-    if (dtchunk < dtrec) {
-        #pragma omp critical
-        {
-            // redundant test needed to avoid race condition
-            if (dtchunk < dtrec) {
-                dtrec = dtchunk;
-                strncpy(msgdtrec, msgdtchunk, 80);
-            }
-        }
-    }
 
 }
 
 
-void Hydro::getDtHydro(
+bool Hydro::getDtHydro(
         double& dtnew,
-        string& msgdtnew) {
+        string& msgdtnew,
+        DtReason& whydtnew) {
 
     if (dtrec < dtnew) {
         dtnew = dtrec;
-        msgdtnew = string(msgdtrec);
+        msgdtnew = dtMessage(whydtrec);
+        whydtnew = whydtrec;
+        return true;
     }
+    return false;
+
+}
+
+
+string Hydro::dtMessage(const DtReason& why) {
+
+    char msg[80];
+    switch (why.kind) {
+    case dtCourant:
+        snprintf(msg, 80, "Hydro Courant limit for z = %d", why.zone);
+        break;
+    case dtVolume:
+        snprintf(msg, 80, "Hydro dV/V limit for z = %d", why.zone);
+        break;
+    default:
+        strcpy(msg, "Hydro default");
+        break;
+    }
+    return string(msg);
 
 }
 
@@ -622,7 +1517,8 @@ void Hydro::getDtHydro(
 void Hydro::resetDtHydro() {
 
     dtrec = 1.e99;
-    strcpy(msgdtrec, "Hydro default");
+    whydtrec.kind = dtDefault;
+    whydtrec.zone = -1;
 
 }
 
@@ -630,11 +1526,10 @@ void Hydro::resetDtHydro() {
 void Hydro::writeEnergyCheck() {
 
     using Parallel::mype;
-    
-    double ei = 0.;
-    double ek = 0.;
-    #pragma omp parallel for schedule(static)
-    for (int sch = 0; sch < mesh->numsch; ++sch) {
+
+    // sum internal (x) and kinetic (y) energy over chunks
+    double2 e = Exec::parallelReduce(mesh->numsch, double2(0., 0.),
+            [&](const int sch) {
         int sfirst = mesh->schsfirst[sch];
         int slast = mesh->schslast[sch];
         int zfirst = mesh->schzfirst[sch];
@@ -642,15 +1537,20 @@ void Hydro::writeEnergyCheck() {
 
         double eichunk = 0.;
         double ekchunk = 0.;
-        sumEnergy(zetot, mesh->zarea, mesh->zvol, zm, mesh->smf,
-                mesh->px, pu, eichunk, ekchunk,
-                zfirst, zlast, sfirst, slast);
-        #pragma omp critical
-        {
-            ei += eichunk;
-            ek += ekchunk;
-        }
-    }
+        // count only the zones owned by this PE
+        int rfirst, rlast;
+        mesh->getOwnedRuns(zfirst, zlast, rfirst, rlast);
+        for (int r = rfirst; r < rlast; ++r)
+            sumEnergy(zetot, mesh->zarea, mesh->zvol, zm, mesh->smf,
+                    mesh->px, pu, eichunk, ekchunk,
+                    max(zfirst, mesh->ownzfirst[r]),
+                    min(zlast, mesh->ownzlast[r]),
+                    max(sfirst, mesh->ownsfirst[r]),
+                    min(slast, mesh->ownslast[r]));
+        return double2(eichunk, ekchunk);
+    });
+    double ei = e.x;
+    double ek = e.y;
 
     Parallel::globalSum(ei);
     Parallel::globalSum(ek);
@@ -16,7 +16,7 @@
 #include <string>
 #include <vector>
 
-#include "Vec2.hh"
+#include "Vec2Ptr.hh"
 
 // forward declarations
 class InputFile;
@@ -25,6 +25,7 @@ class PolyGas;
 class TTS;
 class QCS;
 class HydroBC;
+class TaskGraph;
 
 
 class Hydro {
@@ -48,14 +49,32 @@ public:
     double uinitradial;         // initial velocity in radial direction
     std::vector<double> bcx;    // x values of x-plane fixed boundaries
     std::vector<double> bcy;    // y values of y-plane fixed boundaries
+    int hugepages;              // use huge pages for scratch arenas?
+    bool taskgraph;             // flag:  run cycle as a graph of
+                                // per-chunk tasks?
+    bool fuseforce;             // flag:  use fused side force kernel?
+
+    // kinds of limit on the hydro timestep
+    enum DtKind {
+        dtDefault,              // none found
+        dtCourant,              // Courant condition
+        dtVolume                // volume change
+    };
+
+    // reason for a hydro timestep limit:  its kind, and the zone
+    // that set it.  The message is only made from it when needed.
+    struct DtReason {
+        int kind;
+        int zone;
+    };
 
     double dtrec;               // maximum timestep for hydro
-    char msgdtrec[80];          // message:  reason for dtrec
+    DtReason whydtrec;          // reason for dtrec
 
-    double2* pu;       // point velocity
-    double2* pu0;      // point velocity, start of cycle
-    double2* pap;      // point acceleration
-    double2* pf;       // point force
+    double2ptr pu;     // point velocity
+    double2ptr pu0;    // point velocity, start of cycle
+    double2ptr pap;    // point acceleration
+    double2ptr pf;     // point force
     double* pmaswt;    // point mass, weighted by 1/r
     double* cmaswt;    // corner contribution to pmaswt
 
@@ -71,16 +90,58 @@ public:
     double* zss;       // zone sound speed
     double* zdu;       // zone velocity difference
 
-    double2* sfp;      // side force from pressure
-    double2* sfq;      // side force from artificial visc.
-    double2* sft;      // side force from tts
-    double2* cftot;    // corner force, total from all sources
+    double2ptr sfp;    // side force from pressure
+    double2ptr sfq;    // side force from artificial visc.
+    double2ptr sft;    // side force from tts
+                       // (these three for the unfused force
+                       // kernel only)
+    double2ptr cftot;  // corner force, total from all sources
+    double2ptr sfpq;   // side force from pressure and artificial
+                       // visc., summed (fused force kernel only)
+    int forcearrays;   // fuseforce setting the side force arrays
+                       // above are allocated for (-1 if none)
+
+    // kinds of tasks in the cycle task graph
+    enum TaskKind {
+        taskPredPoints,         // predictor, one point chunk
+        taskPredSides,          // predictor, one side chunk
+        taskSumPoints,          // corner-to-point sums, one point chunk
+        taskSumShared,          // sums at points shared across PEs
+        taskCorrPoints,         // corrector, one point chunk
+        taskCorrSides,          // corrector, one side chunk
+        taskZones               // state update and dt, one zone chunk
+    };
+
+    TaskGraph* graph;                // task graph, if taskgraph is set
+    double dtcycle;                  // timestep for current cycle,
+                                     // used by tasks
+    double dtpred;                   // timestep the predictor was run
+                                     // with ahead of the cycle, or 0
+    std::vector<double> dtzch;       // dt limit for each zone chunk,
+    std::vector<DtReason> whydtzch;  // and its reason
 
     Hydro(const InputFile* inp, Mesh* m);
     ~Hydro();
 
     void init();
 
+    // reserve each thread's scratch arena for the current chunks
+    void reserveScratch();
+
+    // allocate the side force arrays needed by the current
+    // fuseforce setting, freeing those of the other setting
+    void initForceArrays();
+
+    // update chunk-dependent data after the mesh chunks change
+    void resetChunks();
+
+    // after the mesh chunks change, move the pages of the hydro
+    // arrays to the threads that now own them
+    void redistribute();
+
+    // build the dependency graph for running the cycle as tasks
+    void initTaskGraph();
+
     void initRadialVel(
             const double vel,
             const int pfirst,
@@ -88,21 +149,49 @@ public:
 
     void doCycle(const double dt);
 
+    // run the point predictor for the next cycle with a guess at
+    // its timestep, before the cycle's global timestep is known.
+    // If doCycle gets a different timestep, it redoes only the
+    // parts that depend on it.
+    void speculate(const double dtguess);
+
+    // alternate version of doCycle, running the task graph
+    void doCycleTasks(const double dt);
+    void runTask(const int kind, const int index);
+
+    // with ghost zones, copy the state of the ghost zones and
+    // points from their owners, after each cycle
+    void exchangeGhosts();
+
+    // set the timestep limit from the limits of the zone chunks
+    void combineDtChunks();
+
+    // the phases of the cycle, for one chunk each
+    void predictPoints(const int pch, const double dt);
+    void predictSides(const int sch, const double dt);
+    void correctPoints(const int pch, const double dt);
+    void correctSides(const int sch, const double dt);
+    void updateZones(
+            const int zch,
+            const double dt,
+            double& dtrec,
+            DtReason& whydtrec);
+
     void advPosHalf(
-            const double2* px0,
-            const double2* pu0,
+            double2cptr px0,
+            double2cptr pu0,
             const double dt,
-            double2* pxp,
+            double2ptr pxp,
             const int pfirst,
             const int plast);
 
     void advPosFull(
-            const double2* px0,
-            const double2* pu0,
-            const double2* pa,
+            double2cptr px0,
+            double2cptr pu0,
+            double2cptr pa,
             const double dt,
-            double2* px,
-            double2* pu,
+            double2ptr px,
+            double2ptr pu,
             const int pfirst,
             const int plast);
 
@@ -115,17 +204,94 @@ public:
             const int slast);
 
     void sumCrnrForce(
-            const double2* sf,
-            const double2* sf2,
-            const double2* sf3,
-            double2* cftot,
+            double2cptr sf,
+            double2cptr sf2,
+            double2cptr sf3,
+            double2ptr cftot,
+            const int sfirst,
+            const int slast);
+
+    // fused version of the force calculation:  computes the
+    // pressure and TTS forces for each side, adds the Q force,
+    // and stores only the corner force and the sum of pressure
+    // and Q forces, which calcWork needs later
+    void calcForceFused(
+            const double* zp,
+            const double* zarea,
+            const double* zr,
+            const double* zss,
+            const double* sarea,
+            const double* smf,
+            double2cptr ssurf,
+            double2cptr sfq,
+            double2ptr sfpq,
+            double2ptr cftot,
+            const int sfirst,
+            const int slast);
+
+    // versions of calcCrnrMass, sumCrnrForce, calcForceFused and
+    // calcWork for a range of sides within one zone batch (see
+    // Mesh::initBatches), or on a structured mesh (N = Mesh::rect)
+    template <int N>
+    void calcCrnrMassBatch(
+            const double* zr,
+            const double* zarea,
+            const double* smf,
+            double* cmaswt,
+            const int sfirst,
+            const int slast);
+
+    template <int N>
+    void sumCrnrForceBatch(
+            double2cptr sf,
+            double2cptr sf2,
+            double2cptr sf3,
+            double2ptr cftot,
+            const int sfirst,
+            const int slast);
+
+    template <int N>
+    void calcForceFusedBatch(
+            const double* zp,
+            const double* zarea,
+            const double* zr,
+            const double* zss,
+            const double* sarea,
+            const double* smf,
+            double2cptr ssurf,
+            double2cptr sfq,
+            double2ptr sfpq,
+            double2ptr cftot,
+            const int sfirst,
+            const int slast);
+
+    // last step of calcForceFused:  turn the total side forces
+    // in cftot into corner forces, in place
+    template <int N>
+    void diffCrnrForceBatch(
+            double2ptr cftot,
+            const int sfirst,
+            const int slast);
+
+    // (if Sum2 is false, sf2 is not used, and sf is the total
+    // force)
+    template <int N, bool Sum2>
+    void calcWorkBatch(
+            double2cptr sf,
+            double2cptr sf2,
+            double2cptr pu0,
+            double2cptr pu,
+            double2cptr px,
+            const double dt,
+            double* zw,
+            double* zetot,
             const int sfirst,
             const int slast);
 
     void calcAccel(
-            const double2* pf,
+            double2cptr pf,
             const double* pmass,
-            double2* pa,
+            double2ptr pa,
             const int pfirst,
             const int plast);
 
@@ -137,11 +303,23 @@ public:
             const int zlast);
 
     void calcWork(
-            const double2* sf,
-            const double2* sf2,
-            const double2* pu0,
-            const double2* pu,
-            const double2* px0,
+            double2cptr sf,
+            double2cptr sf2,
+            double2cptr pu0,
+            double2cptr pu,
+            double2cptr px0,
+            const double dt,
+            double* zw,
+            double* zetot,
+            const int sfirst,
+            const int slast);
+
+    // version of calcWork for a force already summed into one array
+    void calcWork(
+            double2cptr sf,
+            double2cptr pu0,
+            double2cptr pu,
+            double2cptr px0,
             const double dt,
             double* zw,
             double* zetot,
@@ -171,8 +349,8 @@ public:
             const double* zvol,
             const double* zm,
             const double* smf,
-            const double2* px,
-            const double2* pu,
+            double2cptr px,
+            double2cptr pu,
             double& ei,
             double& ek,
             const int zfirst,
@@ -180,10 +358,25 @@ public:
             const int sfirst,
             const int slast);
 
+    // kinetic energy part of sumEnergy, for a range of sides
+    // within one zone batch, or on a structured mesh (N =
+    // Mesh::rect); adds to sumk, one side at a time
+    template <int N>
+    void sumKinEnergyBatch(
+            const double* zarea,
+            const double* zvol,
+            const double* zm,
+            const double* smf,
+            double2cptr px,
+            double2cptr pu,
+            double& sumk,
+            const int sfirst,
+            const int slast);
+
     void calcDtCourant(
             const double* zdl,
             double& dtrec,
-            char* msgdtrec,
+            DtReason& whydtrec,
             const int zfirst,
             const int zlast);
 
@@ -192,7 +385,7 @@ public:
             const double* zvol0,
             const double dtlast,
             double& dtrec,
-            char* msgdtrec,
+            DtReason& whydtrec,
             const int zfirst,
             const int zlast);
 
@@ -201,12 +394,21 @@ public:
             const double* zvol,
             const double* zvol0,
             const double dtlast,
+            double& dtrec,
+            DtReason& whydtrec,
             const int zfirst,
             const int zlast);
 
-    void getDtHydro(
+    // lower dtnew to the hydro limit, if that is smaller, and
+    // set msgdtnew and whydtnew to its reason; returns true if it
+    // was lowered
+    bool getDtHydro(
             double& dtnew,
-            std::string& msgdtnew);
+            std::string& msgdtnew,
+            DtReason& whydtnew);
+
+    // message for a hydro timestep limit
+    static std::string dtMessage(const DtReason& why);
 
     void resetDtHydro();
 
@@ -27,7 +27,7 @@ HydroBC::HydroBC(
     mapbp = Memory::alloc<int>(numb);
     copy(mbp.begin(), mbp.end(), mapbp);
 
-    mesh->getPlaneChunks(numb, mapbp, pchbfirst, pchblast);
+    initChunks();
 
 }
 
@@ -35,9 +35,16 @@ HydroBC::HydroBC(
 HydroBC::~HydroBC() {}
 
 
+void HydroBC::initChunks() {
+
+    mesh->getPlaneChunks(numb, mapbp, pchbfirst, pchblast);
+
+}
+
+
 void HydroBC::applyFixedBC(
-        double2* pu,
-        double2* pf,
+        double2ptr pu,
+        double2ptr pf,
         const int bfirst,
         const int blast) {
 
@@ -15,7 +15,7 @@
 
 #include <vector>
 
-#include "Vec2.hh"
+#include "Vec2Ptr.hh"
 
 // forward declarations
 class Mesh;
@@ -40,9 +40,12 @@ public:
 
     ~HydroBC();
 
+    // find the boundary points in each point chunk
+    void initChunks();
+
     void applyFixedBC(
-            double2* pu,
-            double2* pf,
+            double2ptr pu,
+            double2ptr pf,
             const int bfirst,
             const int blast);
 
@@ -14,6 +14,11 @@
 #define MEMORY_HH_
 
 #include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -22,7 +27,8 @@
 // Namespace Memory provides functions to allocate and free memory.
 // Currently these are just wrappers around std::malloc and free,
 // but they are abstracted here to make it easier to replace them
-// if needed.
+// if needed.  It also provides per-thread scratch arenas for
+// temporaries; see class Arena below.
 
 namespace Memory {
 
@@ -44,6 +50,116 @@ inline void free(T* ptr) {
 #endif
 }
 
+
+// Class Arena is a per-thread scratch allocator for short-lived
+// temporaries, such as the work arrays used within one chunk.
+// Each thread's arena is a single block, reserved once (normally
+// from the size of the largest chunk); allocating from it just
+// advances an offset, so no locks or system calls are needed in
+// the chunk loops.  Allocations are made through an ArenaScope,
+// which gives everything back when it goes out of scope.  If a
+// request doesn't fit in the block, it falls back to the heap.
+
+class Arena {
+public:
+    // alignment of all arena allocations (one cache line)
+    static const size_t align = 64;
+    // alignment of huge-page-backed blocks
+    static const size_t hugealign = 2 << 20;
+
+    Arena() : base(0), size(0), top(0) {}
+    ~Arena() {
+        std::free(base);
+        releaseOverflow(0);
+    }
+
+    // arena of the calling thread
+    static Arena& local() {
+        static thread_local Arena arena;
+        return arena;
+    }
+
+    // make sure the block holds at least the given number of
+    // bytes; this must be called while nothing is allocated.
+    // The block is touched here, so its pages are placed near
+    // the calling thread.
+    void reserve(const size_t bytes, const bool huge) {
+        if (bytes <= size) return;
+        std::free(base);
+        size_t balign = (huge ? hugealign : align);
+        size = (bytes + balign - 1) / balign * balign;
+        void* p;
+        if (posix_memalign(&p, balign, size) != 0) {
+            base = 0;
+            size = 0;
+            return;
+        }
+        base = (char*) p;
+#ifdef MADV_HUGEPAGE
+        if (huge) madvise(base, size, MADV_HUGEPAGE);
+#endif
+        std::memset(base, 0, size);
+    }
+
+private:
+    char* base;                   // start of block
+    size_t size;                  // size of block, in bytes
+    size_t top;                   // offset of first free byte
+    std::vector<void*> overflow;  // heap blocks used when full
+
+    void* alloc(const size_t bytes) {
+        size_t nbytes = (bytes + align - 1) / align * align;
+        if (top + nbytes <= size) {
+            void* p = base + top;
+            top += nbytes;
+            return p;
+        }
+        void* p;
+        if (posix_memalign(&p, align, nbytes) != 0) return 0;
+        overflow.push_back(p);
+        return p;
+    }
+
+    void releaseOverflow(const size_t nover) {
+        for (size_t i = nover; i < overflow.size(); ++i)
+            std::free(overflow[i]);
+        overflow.resize(nover);
+    }
+
+    friend class ArenaScope;
+
+};  // class Arena
+
+
+// Class ArenaScope allocates from the calling thread's arena;
+// all its allocations are freed when it is destroyed.  Scopes may
+// be nested, as long as they are destroyed in reverse order.
+
+class ArenaScope {
+public:
+    ArenaScope() : arena(Arena::local()), top(arena.top),
+            nover(arena.overflow.size()) {}
+    ~ArenaScope() {
+        arena.top = top;
+        arena.releaseOverflow(nover);
+    }
+
+    template<typename T>
+    T* alloc(const int count) {
+        return (T*) arena.alloc(count * sizeof(T));
+    }
+
+private:
+    Arena& arena;
+    size_t top;                   // arena offset at creation
+    size_t nover;                 // number of overflow blocks
+
+    // not copyable
+    ArenaScope(const ArenaScope&);
+    ArenaScope& operator=(const ArenaScope&);
+
+};  // class ArenaScope
+
 };  // namespace Memory
 
 #endif /* MEMORY_HH_ */
@@ -13,23 +13,141 @@
 #include "Mesh.hh"
 
 #include <stdint.h>
+#include <sys/time.h>
+#include <cstdlib>
 #include <cmath>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <algorithm>
+#include <type_traits>
 
 #include "Vec2.hh"
 #include "Memory.hh"
 #include "Parallel.hh"
+#include "Exec.hh"
+#include "FirstTouch.hh"
 #include "InputFile.hh"
 #include "GenMesh.hh"
 #include "WriteXY.hh"
 #include "ExportGold.hh"
+#include "Reorder.hh"
 
 using namespace std;
 
+// approximate bytes touched per side by the force calculation
+// (side and corner arrays, QCS temporaries, and a share of the
+// zone and point data), used to size sub-chunks
+const int subchbytes = 200;
+
+// L1 data cache size to assume if it can't be found
+const int defaultl1size = 32 * 1024;
+
+// SELL-C-sigma parameters for the inverse map:
+// number of points per slice, and size of the window within
+// which points are sorted by valence
+const int sellc = 8;
+const int sellsigma = 128;
+
+
+// A sum at shared points in progress:  startSharedSum sends the
+// values at slave points to the masters, and finishSharedSums sums
+// them there and sends the results back.  The values of all its
+// variables at a point are packed together, so each neighboring PE
+// gets one message for all of them.
+struct Mesh::SharedSum {
+    int numvars;                // number of point variables
+    double* pvar[3];            // point variables
+    int pwidth[3];              // number of doubles per point in each
+    int width;                  // total number of doubles per point
+    vector<double> slvbuf;      // values at slave points
+    vector<double> prxbuf;      // values at proxies
+    HaloExchange* gather;       // sends slave values to proxies
+    HaloExchange* scatter;      // sends sums back to slaves
+
+    SharedSum() : width(0), gather(NULL), scatter(NULL) {}
+    ~SharedSum() {
+        delete gather;
+        delete scatter;
+    }
+};
+
+
+// number of slaves plus proxies above which the loops that pack
+// and unpack the buffers of shared sums are threaded; below it,
+// they don't pay for the barriers.  Threaded loops are split into
+// blocks of packblock slaves or masters.
+const int packthreshold = 16384;
+const int packblock = 2048;
+
+
+static double wallTime() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1.e-6;
+}
+
+
+namespace {
+
+// A double and a double2 summed together, and views of a pair of
+// corner or point variables which index them as a single variable,
+// so that the sumOnProc routines can sum both in one pass over the
+// corners.  Each component is summed in the same order as when the
+// variables are summed separately.
+struct DoublePair {
+    double a;
+    double2 b;
+
+    DoublePair() : a(0.) {}
+    DoublePair(const double a_, const double2& b_) : a(a_), b(b_) {}
+
+    DoublePair& operator+=(const DoublePair& v) {
+        a += v.a;
+        b += v.b;
+        return *this;
+    }
+};
+
+struct DoublePairCPtr {
+    const double* a;
+    double2cptr b;
+
+    DoublePair operator[](const int i) const {
+        return DoublePair(a[i], b[i]);
+    }
+};
+
+struct DoublePairPtr {
+    double* a;
+    double2ptr b;
+
+    struct Ref {
+        const DoublePairPtr& ptr;
+        int i;
+
+        Ref& operator=(const DoublePair& v) {
+            ptr.a[i] = v.a;
+            ptr.b[i] = v.b;
+            return *this;
+        }
+    };
+
+    Ref operator[](const int i) const {
+        Ref r = { *this, i };
+        return r;
+    }
+};
+
+}  // namespace
+
 
 Mesh::Mesh(const InputFile* inp) :
-    gmesh(NULL), egold(NULL), wxy(NULL) {
+    gmesh(NULL), egold(NULL), wxy(NULL),
+    mappcfirst(NULL), mapccnext(NULL), numsl(0), mapslcc(NULL),
+    numghostz(0), numghostp(0), numghostpe(0), mapzorig(NULL),
+    numbat(0), numsharedsums(0), ghostexch(NULL) {
 
     using Parallel::mype;
 
@@ -47,6 +165,43 @@ Mesh::Mesh(const InputFile* inp) :
         exit(1);
     }
 
+    reorder = inp->getString("reorder", "none");
+    if (reorder != "none" &&
+            reorder != "hilbert" &&
+            reorder != "morton" &&
+            reorder != "rcm") {
+        if (mype == 0)
+            cerr << "Error:  invalid reorder " << reorder << endl;
+        exit(1);
+    }
+
+    invmap = inp->getString("invmap", "csr");
+    if (invmap != "list" &&
+            invmap != "csr" &&
+            invmap != "sell") {
+        if (mype == 0)
+            cerr << "Error:  invalid invmap " << invmap << endl;
+        exit(1);
+    }
+
+    const string halo = inp->getString("haloexchange", "p2p");
+    if (!HaloExchange::findMethod(halo, halomethod)) {
+        if (mype == 0)
+            cerr << "Error:  invalid haloexchange " << halo << endl;
+        exit(1);
+    }
+
+    subchsize = inp->getInt("subchunksize", 0);
+    if (subchsize < 0) {
+        if (mype == 0)
+            cerr << "Error: bad subchunksize " << subchsize << endl;
+        exit(1);
+    }
+    fusegeom = inp->getInt("fusegeom", 0);
+    zonebatch = inp->getInt("zonebatch", 0);
+    structured = inp->getInt("structured", 0);
+    firsttouch = inp->getInt("firsttouch", 1);
+
     writexy = inp->getInt("writexy", 0);
     writegold = inp->getInt("writegold", 0);
 
@@ -62,6 +217,9 @@ Mesh::~Mesh() {
     delete gmesh;
     delete wxy;
     delete egold;
+    for (int i = 0; i < sharedsums.size(); ++i)
+        delete sharedsums[i];
+    delete ghostexch;
 }
 
 
@@ -72,9 +230,42 @@ void Mesh::init() {
     vector<int> cellstart, cellsize, cellnodes;
     vector<int> slavemstrpes, slavemstrcounts, slavepoints;
     vector<int> masterslvpes, masterslvcounts, masterpoints;
+    vector<int> zonepes;
+    vector<int64_t> zoneglobal;
     gmesh->generate(nodepos, cellstart, cellsize, cellnodes,
             slavemstrpes, slavemstrcounts, slavepoints,
-            masterslvpes, masterslvcounts, masterpoints);
+            masterslvpes, masterslvcounts, masterpoints,
+            zonepes, zoneglobal);
+
+    // ghost zones are found by their positions in the generated
+    // numbering
+    ghostzones = gmesh->ghostzones;
+    if (ghostzones && (reorder != "none" || zonebatch)) {
+        if (Parallel::mype == 0)
+            cerr << "Error:  ghostzones requires no reorder or zonebatch"
+                 << endl;
+        exit(1);
+    }
+
+    // structured connectivity relies on the point and zone
+    // numbering of a generated rect mesh
+    if (structured) {
+        if (gmesh->meshtype != "rect" || reorder != "none" || zonebatch) {
+            if (Parallel::mype == 0)
+                cerr << "Error:  structured requires meshtype rect, "
+                     << "with no reorder or zonebatch" << endl;
+            exit(1);
+        }
+        snzx = gmesh->nzx;
+        snzy = gmesh->nzy;
+    }
+
+    // renumber points and zones, if requested
+    Reorder::calcLocality(cellstart, cellsize, cellnodes, pbw0, pdist0);
+    if (reorder != "none" || zonebatch)
+        reorderMesh(nodepos, cellstart, cellsize, cellnodes,
+                slavepoints, masterpoints);
+    Reorder::calcLocality(cellstart, cellsize, cellnodes, pbw, pdist);
 
     nump = nodepos.size();
     numz = cellstart.size();
@@ -88,6 +279,10 @@ void Mesh::init() {
     // populate maps:
     // use the cell* arrays to populate the side maps
     initSides(cellstart, cellsize, cellnodes);
+    // find owned and ghost zones and points
+    initGhosts(cellstart, cellsize, cellnodes, zonepes, zoneglobal);
+    zonepes.resize(0);
+    zoneglobal.resize(0);
     // release memory from cell* arrays
     cellstart.resize(0);
     cellsize.resize(0);
@@ -95,15 +290,19 @@ void Mesh::init() {
     // now populate edge maps using side maps
     initEdges();
 
+    // find batches of zones with equal numbers of sides
+    if (zonebatch) initBatches();
+
+    // calculate parallel data structures
+    initParallel(slavemstrpes, slavemstrcounts, slavepoints,
+            masterslvpes, masterslvcounts, masterpoints);
+
     // populate chunk information
     initChunks();
 
     // create inverse map for corner-to-point gathers
     initInvMap();
 
-    // calculate parallel data structures
-    initParallel(slavemstrpes, slavemstrcounts, slavepoints,
-            masterslvpes, masterslvcounts, masterpoints);
     // release memory from parallel-related arrays
     slavemstrpes.resize(0);
     slavemstrcounts.resize(0);
@@ -116,13 +315,13 @@ void Mesh::init() {
     writeStats();
 
     // allocate remaining arrays
-    px = Memory::alloc<double2>(nump);
-    ex = Memory::alloc<double2>(nume);
-    zx = Memory::alloc<double2>(numz);
-    px0 = Memory::alloc<double2>(nump);
-    pxp = Memory::alloc<double2>(nump);
-    exp = Memory::alloc<double2>(nume);
-    zxp = Memory::alloc<double2>(numz);
+    px = Memory::alloc2(nump);
+    ex = Memory::alloc2(nume);
+    zx = Memory::alloc2(numz);
+    px0 = Memory::alloc2(nump);
+    pxp = Memory::alloc2(nump);
+    exp = Memory::alloc2(nume);
+    zxp = Memory::alloc2(numz);
     sarea = Memory::alloc<double>(nums);
     svol = Memory::alloc<double>(nums);
     zarea = Memory::alloc<double>(numz);
@@ -132,41 +331,110 @@ void Mesh::init() {
     zareap = Memory::alloc<double>(numz);
     zvolp = Memory::alloc<double>(numz);
     zvol0 = Memory::alloc<double>(numz);
-    ssurfp = Memory::alloc<double2>(nums);
+    ssurfp = Memory::alloc2(nums);
     elen = Memory::alloc<double>(nume);
     zdl = Memory::alloc<double>(numz);
     smf = Memory::alloc<double>(nums);
 
+    // distribute pages across memory nodes
+    if (firsttouch) initFirstTouch();
+
     // do a few initial calculations
-    #pragma omp parallel for schedule(static)
-    for (int pch = 0; pch < numpch; ++pch) {
+    Exec::parallelFor(numpch, [&](const int pch) {
         int pfirst = pchpfirst[pch];
         int plast = pchplast[pch];
         // copy nodepos into px, distributed across threads
         for (int p = pfirst; p < plast; ++p)
             px[p] = nodepos[p];
 
-    }
+    });
 
     numsbad = 0;
-    #pragma omp parallel for schedule(static)
-    for (int sch = 0; sch < numsch; ++sch) {
+    Exec::parallelFor(numsch, [&](const int sch) {
         int sfirst = schsfirst[sch];
         int slast = schslast[sch];
         calcCtrs(px, ex, zx, sfirst, slast);
         calcVols(px, zx, sarea, svol, zarea, zvol, sfirst, slast);
         calcSideFracs(sarea, zarea, smf, sfirst, slast);
-    }
+    });
     checkBadSides();
 
 }
 
 
+void Mesh::reorderMesh(
+        vector<double2>& nodepos,
+        vector<int>& cellstart,
+        vector<int>& cellsize,
+        vector<int>& cellnodes,
+        vector<int>& slavepoints,
+        vector<int>& masterpoints) {
+
+    const int numpgen = nodepos.size();
+    const int numzgen = cellstart.size();
+
+    // compute new orders:  for a space-filling curve, order the
+    // zones and then number points as the zones first use them;
+    // for RCM, order the points and then sort zones to follow
+    vector<int> zoneorder, pointorder;
+    if (reorder == "rcm") {
+        Reorder::calcPointOrderRCM(numpgen, cellstart, cellsize,
+                cellnodes, pointorder);
+        Reorder::calcZoneOrderFromPoints(pointorder, cellstart, cellsize,
+                cellnodes, zoneorder);
+    }
+    else if (reorder != "none")
+        Reorder::calcZoneOrderSFC(nodepos, cellstart, cellsize,
+                cellnodes, (reorder == "hilbert"), zoneorder);
+    else {
+        zoneorder.resize(numzgen);
+        for (int z = 0; z < numzgen; ++z)
+            zoneorder[z] = z;
+    }
+
+    // group zones with equal numbers of sides into contiguous
+    // batches, keeping the order above within each batch
+    if (zonebatch)
+        Reorder::sortZonesBySize(cellsize, zoneorder);
+
+    if (reorder == "none") {
+        pointorder.resize(numpgen);
+        for (int p = 0; p < numpgen; ++p)
+            pointorder[p] = p;
+    }
+    else if (reorder != "rcm")
+        Reorder::calcPointOrderFromZones(numpgen, zoneorder, cellstart,
+                cellsize, cellnodes, pointorder);
+
+    vector<int> mappnew;
+    Reorder::apply(zoneorder, pointorder, nodepos, cellstart, cellsize,
+            cellnodes, mappnew);
+
+    // slave and master lists keep their order (so messages still
+    // match up across PEs), but refer to the new point numbers
+    for (int i = 0; i < slavepoints.size(); ++i)
+        slavepoints[i] = mappnew[slavepoints[i]];
+    for (int i = 0; i < masterpoints.size(); ++i)
+        masterpoints[i] = mappnew[masterpoints[i]];
+
+    // save original zone numbers, for output
+    mapzorig = Memory::alloc<int>(numzgen);
+    copy(zoneorder.begin(), zoneorder.end(), mapzorig);
+
+}
+
+
 void Mesh::initSides(
         const vector<int>& cellstart,
         const vector<int>& cellsize,
         const vector<int>& cellnodes) {
 
+    // a structured mesh computes its connectivity from indices
+    if (structured) {
+        mapsp1 = mapsp2 = mapsz = mapss3 = mapss4 = NULL;
+        return;
+    }
+
     mapsp1 = Memory::alloc<int>(nums);
     mapsp2 = Memory::alloc<int>(nums);
     mapsz  = Memory::alloc<int>(nums);
@@ -193,10 +461,17 @@ void Mesh::initSides(
 
 void Mesh::initEdges() {
 
-    vector<vector<int> > edgepp(nump), edgepe(nump);
+    // on a structured mesh, edges are numbered by sideEdge<rect>
+    if (structured) {
+        mapse = NULL;
+        nume = (snzy + 1) * snzx + snzy * (snzx + 1);
+        return;
+    }
 
     mapse = Memory::alloc<int>(nums);
 
+    vector<vector<int> > edgepp(nump), edgepe(nump);
+
     int e = 0;
     for (int s = 0; s < nums; ++s) {
         int p1 = min(mapsp1[s], mapsp2[s]);
@@ -219,32 +494,136 @@ void Mesh::initEdges() {
 }
 
 
+void Mesh::initBatches() {
+
+    // a batch is a maximal run of zones with the same number of
+    // sides; zones have been sorted so there are only a few
+    int s = 0;
+    while (s < nums) {
+        int z = mapsz[s];
+        int n = znump[z];
+        batsfirst.push_back(s);
+        while (s < nums && znump[mapsz[s]] == n)
+            s += znump[mapsz[s]];
+        batslast.push_back(s);
+        batnump.push_back(n);
+    }
+    numbat = batsfirst.size();
+
+}
+
+
+// size in bytes of the CPU's data cache at the given level,
+// or 0 if unknown
+static int cacheSize(const int level) {
+    int size = 0;
+#ifdef __linux__
+    for (int i = 0; i < 10; ++i) {
+        ostringstream dir;
+        dir << "/sys/devices/system/cpu/cpu0/cache/index" << i << "/";
+        ifstream flevel((dir.str() + "level").c_str());
+        ifstream ftype((dir.str() + "type").c_str());
+        ifstream fsize((dir.str() + "size").c_str());
+        int lev;
+        string type, ssize;
+        if (!(flevel >> lev && ftype >> type && fsize >> ssize)) break;
+        if (lev != level || type == "Instruction") continue;
+        // size is given as e.g. 48K or 32M
+        size = atoi(ssize.c_str());
+        char unit = ssize[ssize.size() - 1];
+        if (unit == 'K') size *= 1024;
+        if (unit == 'M') size *= 1024 * 1024;
+        break;
+    }
+#endif
+    return size;
+}
+
+
 void Mesh::initChunks() {
 
     if (chunksize == 0) chunksize = max(nump, nums);
+    schsize = pchsize = zchsize = chunksize;
+
+    // size sub-chunks so that the force calculation for one
+    // sub-chunk fits in the L1 cache
+    if (subchsize == 0) {
+        int l1size = cacheSize(1);
+        if (l1size == 0) l1size = defaultl1size;
+        subchsize = max(l1size / subchbytes, 32);
+    }
+
+    setChunkSizes(schsize, pchsize, zchsize);
+
+}
+
+
+void Mesh::setChunkSizes(
+        const int ssize,
+        const int psize,
+        const int zsize) {
+
+    schsize = ssize;
+    pchsize = psize;
+    zchsize = zsize;
+    schsfirst.resize(0);
+    schslast.resize(0);
+    schzfirst.resize(0);
+    schzlast.resize(0);
+    pchpfirst.resize(0);
+    pchplast.resize(0);
+    zchzfirst.resize(0);
+    zchzlast.resize(0);
 
     // compute side chunks
-    // use 'chunksize' for maximum chunksize; decrease as needed
+    // use 'schsize' for maximum chunksize; decrease as needed
     // to ensure that no zone has its sides split across chunk
     // boundaries
     int s1, s2 = 0;
     while (s2 < nums) {
         s1 = s2;
-        s2 = min(s2 + chunksize, nums);
-        while (s2 < nums && mapsz[s2] == mapsz[s2-1])
+        s2 = min(s2 + schsize, nums);
+        while (s2 < nums && sideZoneAny(s2) == sideZoneAny(s2-1))
             --s2;
         schsfirst.push_back(s1);
         schslast.push_back(s2);
-        schzfirst.push_back(mapsz[s1]);
-        schzlast.push_back(mapsz[s2-1] + 1);
+        schzfirst.push_back(sideZoneAny(s1));
+        schzlast.push_back(sideZoneAny(s2-1) + 1);
     }
     numsch = schsfirst.size();
 
+    // divide side chunks into sub-chunks, again without
+    // splitting zones
+    schsubfirst.resize(0);
+    subsfirst.resize(0);
+    subslast.resize(0);
+    for (int sch = 0; sch < numsch; ++sch) {
+        schsubfirst.push_back(subsfirst.size());
+        int s1, s2 = schsfirst[sch];
+        while (s2 < schslast[sch]) {
+            s1 = s2;
+            s2 = min(s2 + subchsize, schslast[sch]);
+            while (s2 < schslast[sch] &&
+                    sideZoneAny(s2) == sideZoneAny(s2-1))
+                --s2;
+            // a zone bigger than a sub-chunk gets one to itself
+            if (s2 == s1) {
+                s2 = s1 + 1;
+                while (s2 < schslast[sch] &&
+                        sideZoneAny(s2) == sideZoneAny(s2-1))
+                    ++s2;
+            }
+            subsfirst.push_back(s1);
+            subslast.push_back(s2);
+        }
+    }
+    schsubfirst.push_back(subsfirst.size());
+
     // compute point chunks
     int p1, p2 = 0;
     while (p2 < nump) {
         p1 = p2;
-        p2 = min(p2 + chunksize, nump);
+        p2 = min(p2 + pchsize, nump);
         pchpfirst.push_back(p1);
         pchplast.push_back(p2);
     }
@@ -254,35 +633,296 @@ void Mesh::initChunks() {
     int z1, z2 = 0;
     while (z2 < numz) {
         z1 = z2;
-        z2 = min(z2 + chunksize, numz);
+        z2 = min(z2 + zchsize, numz);
         zchzfirst.push_back(z1);
         zchzlast.push_back(z2);
     }
     numzch = zchzfirst.size();
 
+    // sell slices follow the point chunks, so rebuild them if
+    // the chunks are being changed
+    if (mapslcc != NULL) {
+        Memory::free(mapslrp);
+        Memory::free(slcfirst);
+        Memory::free(slwidth);
+        Memory::free(mapslcc);
+        pchslfirst.resize(0);
+        pchsllast.resize(0);
+        initSellMap();
+    }
+
+    initSharedChunks();
+
+}
+
+
+void Mesh::initSharedChunks() {
+
+    pchshared.resize(0);
+    pchinterior.resize(0);
+
+    // mark points that are slaves or masters
+    vector<char> pshared(nump, 0);
+    if (Parallel::numpe > 1) {
+        for (int slv = 0; slv < numslv; ++slv)
+            pshared[mapslvp[slv]] = 1;
+        for (int prx = 0; prx < numprx; ++prx)
+            pshared[mapprxp[prx]] = 1;
+    }
+
+    for (int pch = 0; pch < numpch; ++pch) {
+        const char* pfirst = &pshared[0] + pchpfirst[pch];
+        const char* plast = &pshared[0] + pchplast[pch];
+        if (find(pfirst, plast, 1) != plast)
+            pchshared.push_back(pch);
+        else
+            pchinterior.push_back(pch);
+    }
+
 }
 
 
 void Mesh::initInvMap() {
-    mappcfirst = Memory::alloc<int>(nump);
-    mapccnext = Memory::alloc<int>(nums);
+    // a structured mesh sums corners to points without one
+    if (structured) {
+        mappcoff = mappc = NULL;
+        return;
+    }
 
-    vector<pair<int, int> > pcpair(nums);
+    mappcoff = Memory::alloc<int>(nump + 1);
+    mappc = Memory::alloc<int>(numc);
+
+    // count corners at each point, then scan to get offsets
+    fill(&mappcoff[0], &mappcoff[nump + 1], 0);
     for (int c = 0; c < numc; ++c)
-        pcpair[c] = make_pair(mapsp1[c], c);
-    sort(pcpair.begin(), pcpair.end());
-    for (int i = 0; i < numc; ++i) {
-        int p = pcpair[i].first;
-        int pp = pcpair[i+1].first;
-        int pm = pcpair[i-1].first;
-        int c = pcpair[i].second;
-        int cp = pcpair[i+1].second;
-
-        if (i == 0 || p != pm)  mappcfirst[p] = c;
-        if (i+1 == numc || p != pp)
-            mapccnext[c] = -1;
-        else
-            mapccnext[c] = cp;
+        mappcoff[mapsp1[c] + 1] += 1;
+    for (int p = 0; p < nump; ++p)
+        mappcoff[p + 1] += mappcoff[p];
+
+    // fill in corners; visiting them in order keeps each
+    // point's list sorted
+    vector<int> pcount(&mappcoff[0], &mappcoff[nump]);
+    for (int c = 0; c < numc; ++c) {
+        int p = mapsp1[c];
+        mappc[pcount[p]] = c;
+        pcount[p] += 1;
+    }
+
+    if (invmap == "list") {
+        mappcfirst = Memory::alloc<int>(nump);
+        mapccnext = Memory::alloc<int>(numc);
+        for (int p = 0; p < nump; ++p) {
+            int i1 = mappcoff[p];
+            int i2 = mappcoff[p + 1];
+            mappcfirst[p] = (i1 < i2 ? mappc[i1] : -1);
+            for (int i = i1; i < i2; ++i)
+                mapccnext[mappc[i]] = (i + 1 < i2 ? mappc[i + 1] : -1);
+        }
+    }
+    else if (invmap == "sell")
+        initSellMap();
+
+}
+
+
+void Mesh::initSellMap() {
+
+    vector<int> vslrp, vslcfirst, vslwidth, vslcc;
+
+    // slices never cross point chunk boundaries, so each chunk
+    // can still be summed independently
+    for (int pch = 0; pch < numpch; ++pch) {
+        int pfirst = pchpfirst[pch];
+        int plast = pchplast[pch];
+        pchslfirst.push_back(vslwidth.size());
+
+        for (int w1 = pfirst; w1 < plast; w1 += sellsigma) {
+            int w2 = min(w1 + sellsigma, plast);
+
+            // sort points in window by decreasing valence, so that
+            // points in a slice have similar numbers of corners
+            vector<pair<int, int> > vp;
+            for (int p = w1; p < w2; ++p)
+                vp.push_back(make_pair(mappcoff[p] - mappcoff[p + 1], p));
+            sort(vp.begin(), vp.end());
+
+            for (int i1 = 0; i1 < vp.size(); i1 += sellc) {
+                int width = -vp[i1].first;
+                vslcfirst.push_back(vslcc.size());
+                vslwidth.push_back(width);
+                for (int i = 0; i < sellc; ++i) {
+                    int p = (i1 + i < vp.size() ? vp[i1 + i].second : -1);
+                    vslrp.push_back(p);
+                }
+                for (int j = 0; j < width; ++j) {
+                    for (int i = 0; i < sellc; ++i) {
+                        int c = -1;
+                        if (i1 + i < vp.size()) {
+                            int p = vp[i1 + i].second;
+                            if (mappcoff[p] + j < mappcoff[p + 1])
+                                c = mappc[mappcoff[p] + j];
+                        }
+                        vslcc.push_back(c);
+                    }
+                }
+            }  // for i1
+        }  // for w1
+
+        pchsllast.push_back(vslwidth.size());
+    }  // for pch
+
+    numsl = vslwidth.size();
+    mapslrp = Memory::alloc<int>(numsl * sellc);
+    copy(vslrp.begin(), vslrp.end(), mapslrp);
+    slcfirst = Memory::alloc<int>(numsl);
+    copy(vslcfirst.begin(), vslcfirst.end(), slcfirst);
+    slwidth = Memory::alloc<int>(numsl);
+    copy(vslwidth.begin(), vslwidth.end(), slwidth);
+    mapslcc = Memory::alloc<int>(vslcc.size());
+    copy(vslcc.begin(), vslcc.end(), mapslcc);
+
+}
+
+
+void Mesh::initFirstTouch() {
+
+    const int* sfirst = &schsfirst[0];
+    const int* slast = &schslast[0];
+    const int* zfirst = &schzfirst[0];
+    const int* zlast = &schzlast[0];
+    const int* pfirst = &pchpfirst[0];
+    const int* plast = &pchplast[0];
+
+    // the geometry arrays are new, so just touch them
+    Memory::touch2(px0, pfirst, plast, numpch);
+    Memory::touch2(pxp, pfirst, plast, numpch);
+    Memory::touch2(zx, zfirst, zlast, numsch);
+    Memory::touch2(zxp, zfirst, zlast, numsch);
+    Memory::touch(zarea, zfirst, zlast, numsch);
+    Memory::touch(zvol, zfirst, zlast, numsch);
+    Memory::touch(zareap, zfirst, zlast, numsch);
+    Memory::touch(zvolp, zfirst, zlast, numsch);
+    Memory::touch(zvol0, zfirst, zlast, numsch);
+    Memory::touch(zdl, zfirst, zlast, numsch);
+    Memory::touch2(ssurfp, sfirst, slast, numsch);
+    Memory::touch(sarea, sfirst, slast, numsch);
+    Memory::touch(svol, sfirst, slast, numsch);
+    Memory::touch(sareap, sfirst, slast, numsch);
+    Memory::touch(svolp, sfirst, slast, numsch);
+    Memory::touch(smf, sfirst, slast, numsch);
+    // edges aren't chunked; they're numbered roughly in side
+    // order, so an even split comes close
+    Memory::touch2(ex, nume);
+    Memory::touch2(exp, nume);
+    Memory::touch(elen, nume);
+
+    // the maps were filled serially, so move them into pages
+    // touched by the owning threads
+    distributeMaps();
+
+}
+
+
+void Mesh::redistribute() {
+
+    const int* sfirst = &schsfirst[0];
+    const int* slast = &schslast[0];
+    const int* zfirst = &schzfirst[0];
+    const int* zlast = &schzlast[0];
+    const int* pfirst = &pchpfirst[0];
+    const int* plast = &pchplast[0];
+
+    // the geometry arrays hold the current state, so copy them;
+    // edge arrays don't depend on the chunks
+    px     = Memory::distribute2(px,     nump, pfirst, plast, numpch);
+    px0    = Memory::distribute2(px0,    nump, pfirst, plast, numpch);
+    pxp    = Memory::distribute2(pxp,    nump, pfirst, plast, numpch);
+    zx     = Memory::distribute2(zx,     numz, zfirst, zlast, numsch);
+    zxp    = Memory::distribute2(zxp,    numz, zfirst, zlast, numsch);
+    zarea  = Memory::distribute(zarea,   numz, zfirst, zlast, numsch);
+    zvol   = Memory::distribute(zvol,    numz, zfirst, zlast, numsch);
+    zareap = Memory::distribute(zareap,  numz, zfirst, zlast, numsch);
+    zvolp  = Memory::distribute(zvolp,   numz, zfirst, zlast, numsch);
+    zvol0  = Memory::distribute(zvol0,   numz, zfirst, zlast, numsch);
+    zdl    = Memory::distribute(zdl,     numz, zfirst, zlast, numsch);
+    ssurfp = Memory::distribute2(ssurfp, nums, sfirst, slast, numsch);
+    sarea  = Memory::distribute(sarea,   nums, sfirst, slast, numsch);
+    svol   = Memory::distribute(svol,    nums, sfirst, slast, numsch);
+    sareap = Memory::distribute(sareap,  nums, sfirst, slast, numsch);
+    svolp  = Memory::distribute(svolp,   nums, sfirst, slast, numsch);
+    smf    = Memory::distribute(smf,     nums, sfirst, slast, numsch);
+
+    distributeMaps();
+
+}
+
+
+void Mesh::distributeMaps() {
+
+    const int* sfirst = &schsfirst[0];
+    const int* slast = &schslast[0];
+    const int* zfirst = &schzfirst[0];
+    const int* zlast = &schzlast[0];
+    const int* pfirst = &pchpfirst[0];
+    const int* plast = &pchplast[0];
+
+    znump  = Memory::distribute(znump,  numz, zfirst, zlast, numsch);
+
+    // a structured mesh has no side or inverse maps
+    if (structured) return;
+
+    mapsp1 = Memory::distribute(mapsp1, nums, sfirst, slast, numsch);
+    mapsp2 = Memory::distribute(mapsp2, nums, sfirst, slast, numsch);
+    mapsz  = Memory::distribute(mapsz,  nums, sfirst, slast, numsch);
+    mapss3 = Memory::distribute(mapss3, nums, sfirst, slast, numsch);
+    mapss4 = Memory::distribute(mapss4, nums, sfirst, slast, numsch);
+    mapse  = Memory::distribute(mapse,  nums, sfirst, slast, numsch);
+
+    // the inverse map is used in point chunks; the corner lists
+    // of a point chunk are contiguous
+    vector<int> icfirst(numpch), iclast(numpch);
+    for (int pch = 0; pch < numpch; ++pch) {
+        icfirst[pch] = mappcoff[pchpfirst[pch]];
+        iclast[pch] = mappcoff[pchplast[pch]];
+    }
+    mappcoff = Memory::distribute(mappcoff, nump + 1, pfirst, plast, numpch);
+    mappc = Memory::distribute(mappc, numc, &icfirst[0], &iclast[0],
+            numpch);
+    if (invmap == "list") {
+        mappcfirst = Memory::distribute(mappcfirst, nump,
+                pfirst, plast, numpch);
+        mapccnext = Memory::distribute(mapccnext, numc,
+                sfirst, slast, numsch);
+    }
+    else if (invmap == "sell") {
+        // slices of a point chunk are contiguous, as are their
+        // entries in mapslcc
+        vector<int> slfirst(numpch), sllast(numpch);
+        vector<int> ccfirst(numpch), cclast(numpch);
+        for (int pch = 0; pch < numpch; ++pch) {
+            int sl1 = pchslfirst[pch];
+            int sl2 = pchsllast[pch];
+            slfirst[pch] = sl1;
+            sllast[pch] = sl2;
+            ccfirst[pch] = (sl1 < numsl ? slcfirst[sl1] : 0);
+            cclast[pch] = (sl2 > sl1 ?
+                    slcfirst[sl2 - 1] + slwidth[sl2 - 1] * sellc :
+                    ccfirst[pch]);
+        }
+        int numslcc = (numsl > 0 ?
+                slcfirst[numsl - 1] + slwidth[numsl - 1] * sellc : 0);
+        mapslcc = Memory::distribute(mapslcc, numslcc,
+                &ccfirst[0], &cclast[0], numpch);
+        slcfirst = Memory::distribute(slcfirst, numsl,
+                &slfirst[0], &sllast[0], numpch);
+        slwidth = Memory::distribute(slwidth, numsl,
+                &slfirst[0], &sllast[0], numpch);
+        for (int pch = 0; pch < numpch; ++pch) {
+            slfirst[pch] *= sellc;
+            sllast[pch] *= sellc;
+        }
+        mapslrp = Memory::distribute(mapslrp, numsl * sellc,
+                &slfirst[0], &sllast[0], numpch);
     }
 
 }
@@ -327,6 +967,230 @@ void Mesh::initParallel(
     mapprxp = Memory::alloc<int>(numprx);
     copy(masterpoints.begin(), masterpoints.end(), mapprxp);
 
+    // group the proxies by master point, so that the sums at
+    // different masters can be done in parallel, each in proxy
+    // order
+    vector<pair<int, int> > pprx(numprx);
+    for (int prx = 0; prx < numprx; ++prx)
+        pprx[prx] = make_pair(mapprxp[prx], prx);
+    sort(pprx.begin(), pprx.end());
+    mapmstrp = Memory::alloc<int>(numprx);
+    mstrprx1 = Memory::alloc<int>(numprx + 1);
+    mapmstrprx = Memory::alloc<int>(numprx);
+    nummstr = 0;
+    for (int i = 0; i < numprx; ++i) {
+        if (i == 0 || pprx[i].first != pprx[i - 1].first) {
+            mapmstrp[nummstr] = pprx[i].first;
+            mstrprx1[nummstr] = i;
+            nummstr += 1;
+        }
+        mapmstrprx[i] = pprx[i].second;
+    }
+    mstrprx1[nummstr] = numprx;
+
+}
+
+
+void Mesh::initGhosts(
+        const vector<int>& cellstart,
+        const vector<int>& cellsize,
+        const vector<int>& cellnodes,
+        const vector<int>& zonepes,
+        const vector<int64_t>& zoneglobal) {
+
+    using Parallel::mype;
+
+    ownzfirst.resize(0);
+    ownzlast.resize(0);
+    ownsfirst.resize(0);
+    ownslast.resize(0);
+    numpown = nump;
+    if (!ghostzones) {
+        ownzfirst.push_back(0);
+        ownzlast.push_back(numz);
+        ownsfirst.push_back(0);
+        ownslast.push_back(nums);
+        return;
+    }
+
+    // find runs of owned zones
+    for (int z = 0; z < numz; ++z) {
+        if (zonepes[z] != mype) continue;
+        const int slast = cellstart[z] + cellsize[z];
+        if (!ownzlast.empty() && ownzlast.back() == z) {
+            ownzlast.back() = z + 1;
+            ownslast.back() = slast;
+        }
+        else {
+            ownzfirst.push_back(z);
+            ownzlast.push_back(z + 1);
+            ownsfirst.push_back(cellstart[z]);
+            ownslast.push_back(slast);
+        }
+    }
+
+    // for each point, find the first zone holding it, and its
+    // place in that zone.  Zones are numbered as generated, so
+    // that's the one with the lowest global number.  A point in
+    // any owned zone has all of its zones here, so its value is
+    // right on mype; other points are ghost points, and come from
+    // the owner of their first zone.
+    vector<int> mappz(nump, -1), mappzi(nump, -1);
+    vector<char> powned(nump, 0);
+    for (int z = 0; z < numz; ++z) {
+        for (int i = 0; i < cellsize[z]; ++i) {
+            int p = cellnodes[cellstart[z] + i];
+            if (mappz[p] < 0) {
+                mappz[p] = z;
+                mappzi[p] = i;
+            }
+            if (zonepes[z] == mype) powned[p] = 1;
+        }
+    }
+    // for statistics, count each point on the PE owning its first
+    // zone
+    numpown = 0;
+    for (int p = 0; p < nump; ++p)
+        if (powned[p] && zonepes[mappz[p]] == mype) numpown += 1;
+
+    // the neighbor PEs are the owners of the ghost zones; since
+    // each PE's zones are extended the same way, each neighbor
+    // also has ghosts from mype
+    mapghostpepe.resize(0);
+    for (int z = 0; z < numz; ++z)
+        if (zonepes[z] != mype) mapghostpepe.push_back(zonepes[z]);
+    sort(mapghostpepe.begin(), mapghostpepe.end());
+    mapghostpepe.erase(unique(mapghostpepe.begin(), mapghostpepe.end()),
+            mapghostpepe.end());
+    numghostpe = mapghostpepe.size();
+
+    // group the ghost zones and points by neighbor, in increasing
+    // order within each
+    vector<vector<int> > rz(numghostpe), rp(numghostpe);
+    for (int z = 0; z < numz; ++z) {
+        if (zonepes[z] == mype) continue;
+        int n = lower_bound(mapghostpepe.begin(), mapghostpepe.end(),
+                zonepes[z]) - mapghostpepe.begin();
+        rz[n].push_back(z);
+    }
+    for (int p = 0; p < nump; ++p) {
+        if (powned[p]) continue;
+        int n = lower_bound(mapghostpepe.begin(), mapghostpepe.end(),
+                zonepes[mappz[p]]) - mapghostpepe.begin();
+        rp[n].push_back(p);
+    }
+    ghostperz1.assign(1, 0);
+    ghostperp1.assign(1, 0);
+    mapghostrz.resize(0);
+    mapghostrp.resize(0);
+    for (int n = 0; n < numghostpe; ++n) {
+        mapghostrz.insert(mapghostrz.end(), rz[n].begin(), rz[n].end());
+        mapghostrp.insert(mapghostrp.end(), rp[n].begin(), rp[n].end());
+        ghostperz1.push_back(mapghostrz.size());
+        ghostperp1.push_back(mapghostrp.size());
+    }
+    numghostz = mapghostrz.size();
+    numghostp = mapghostrp.size();
+
+    // ask each neighbor for its values, naming zones by global
+    // number, and points by their first zone and place in it.
+    // Messages are sent as doubles, which hold the numbers exactly.
+    // First, the numbers of zones and points in each request...
+    vector<int> pefirst(numghostpe), pecount(numghostpe, 1);
+    for (int n = 0; n < numghostpe; ++n)
+        pefirst[n] = n;
+    vector<double> sbuf(2 * numghostpe), rbuf(2 * numghostpe);
+    for (int n = 0; n < numghostpe; ++n) {
+        sbuf[2 * n] = rz[n].size();
+        sbuf[2 * n + 1] = rp[n].size();
+    }
+    {
+        HaloExchange sizes(HaloExchange::p2p,
+                numghostpe, &mapghostpepe[0], &pefirst[0], &pecount[0],
+                &sbuf[0],
+                numghostpe, &mapghostpepe[0], &pefirst[0], &pecount[0],
+                &rbuf[0], 2, 200);
+        sizes.start();
+        sizes.finish();
+    }
+
+    // ...then the requests themselves
+    vector<int> sfirst(numghostpe), scount(numghostpe);
+    vector<int> rfirst(numghostpe), rcount(numghostpe);
+    int ssize = 0, rsize = 0;
+    for (int n = 0; n < numghostpe; ++n) {
+        sfirst[n] = ssize;
+        scount[n] = rz[n].size() + 2 * rp[n].size();
+        ssize += scount[n];
+        rfirst[n] = rsize;
+        rcount[n] = (int) rbuf[2 * n] + 2 * (int) rbuf[2 * n + 1];
+        rsize += rcount[n];
+    }
+    vector<double> sreq(ssize), rreq(rsize);
+    for (int n = 0; n < numghostpe; ++n) {
+        double* req = &sreq[sfirst[n]];
+        for (int i = 0; i < rz[n].size(); ++i)
+            *req++ = zoneglobal[rz[n][i]];
+        for (int i = 0; i < rp[n].size(); ++i) {
+            int p = rp[n][i];
+            *req++ = zoneglobal[mappz[p]];
+            *req++ = mappzi[p];
+        }
+    }
+    {
+        HaloExchange requests(HaloExchange::p2p,
+                numghostpe, &mapghostpepe[0], &sfirst[0], &scount[0],
+                &sreq[0],
+                numghostpe, &mapghostpepe[0], &rfirst[0], &rcount[0],
+                &rreq[0], 1, 201);
+        requests.start();
+        requests.finish();
+    }
+
+    // find the requested zones and points here
+    ghostpesz1.assign(1, 0);
+    ghostpesp1.assign(1, 0);
+    mapghostsz.resize(0);
+    mapghostsp.resize(0);
+    for (int n = 0; n < numghostpe; ++n) {
+        const double* req = &rreq[rfirst[n]];
+        const int nz = (int) rbuf[2 * n];
+        const int np = (int) rbuf[2 * n + 1];
+        for (int i = 0; i < nz + np; ++i) {
+            int64_t gz = (int64_t) *req++;
+            int z = lower_bound(zoneglobal.begin(), zoneglobal.end(), gz)
+                    - zoneglobal.begin();
+            if (z == numz || zoneglobal[z] != gz || zonepes[z] != mype) {
+                cerr << "Error:  PE " << mype << " doesn't own zone "
+                     << gz << " requested by PE " << mapghostpepe[n]
+                     << endl;
+                exit(1);
+            }
+            if (i < nz) {
+                mapghostsz.push_back(z);
+                continue;
+            }
+            int zi = (int) *req++;
+            mapghostsp.push_back(cellnodes[cellstart[z] + zi]);
+        }
+        ghostpesz1.push_back(mapghostsz.size());
+        ghostpesp1.push_back(mapghostsp.size());
+    }
+
+}
+
+
+void Mesh::getOwnedRuns(
+        const int zfirst,
+        const int zlast,
+        int& rfirst,
+        int& rlast) const {
+
+    rfirst = upper_bound(ownzlast.begin(), ownzlast.end(), zfirst)
+            - ownzlast.begin();
+    rlast = lower_bound(ownzfirst.begin(), ownzfirst.end(), zlast)
+            - ownzfirst.begin();
+
 }
 
 
@@ -334,39 +1198,245 @@ void Mesh::writeStats() {
 
     int64_t gnump = nump;
     // make sure that boundary points aren't double-counted;
-    // only count them if they are masters
+    // only count them if they are masters, or with ghost zones,
+    // if they are counted as owned (ghosts aren't counted at all)
     if (Parallel::numpe > 1) gnump -= numslv;
-    int64_t gnumz = numz;
+    if (ghostzones) gnump = numpown;
+    int64_t gnumz = numz - numghostz;
+    int64_t gnumghz = numghostz;
     int64_t gnums = nums;
     int64_t gnume = nume;
     int gnumpch = numpch;
     int gnumzch = numzch;
     int gnumsch = numsch;
+    int gnumsub = subsfirst.size();
+    int gnumpchsh = pchshared.size();
+    int gpbw0 = pbw0;
+    int gpbw = pbw;
+    double gpdist0 = pdist0;
+    double gpdist = pdist;
+
+    // boundary points exchanged with PEs on this node, and on
+    // other nodes:  slaves and proxies, or ghost points sent and
+    // received
+    int64_t gnumbndon = 0, gnumbndoff = 0;
+    const int mynode = Parallel::nodeOf(Parallel::mype);
+    if (ghostzones) {
+        for (int n = 0; n < numghostpe; ++n) {
+            int count = ghostperp1[n + 1] - ghostperp1[n] +
+                    ghostpesp1[n + 1] - ghostpesp1[n];
+            if (Parallel::nodeOf(mapghostpepe[n]) == mynode)
+                gnumbndon += count;
+            else
+                gnumbndoff += count;
+        }
+    }
+    else if (Parallel::numpe > 1) {
+        for (int mstrpe = 0; mstrpe < nummstrpe; ++mstrpe) {
+            if (Parallel::nodeOf(mapmstrpepe[mstrpe]) == mynode)
+                gnumbndon += mstrpenumslv[mstrpe];
+            else
+                gnumbndoff += mstrpenumslv[mstrpe];
+        }
+        for (int slvpe = 0; slvpe < numslvpe; ++slvpe) {
+            if (Parallel::nodeOf(mapslvpepe[slvpe]) == mynode)
+                gnumbndon += slvpenumprx[slvpe];
+            else
+                gnumbndoff += slvpenumprx[slvpe];
+        }
+    }
 
     Parallel::globalSum(gnump);
     Parallel::globalSum(gnumz);
+    Parallel::globalSum(gnumghz);
     Parallel::globalSum(gnums);
     Parallel::globalSum(gnume);
     Parallel::globalSum(gnumpch);
     Parallel::globalSum(gnumzch);
     Parallel::globalSum(gnumsch);
+    Parallel::globalSum(gnumsub);
+    Parallel::globalSum(gnumpchsh);
+    Parallel::globalMax(gpbw0);
+    Parallel::globalMax(gpbw);
+    Parallel::globalSum(gpdist0);
+    Parallel::globalSum(gpdist);
+    Parallel::globalSum(gnumbndon);
+    Parallel::globalSum(gnumbndoff);
 
     if (Parallel::mype > 0) return;
 
     cout << "--- Mesh Information ---" << endl;
     cout << "Points:  " << gnump << endl;
     cout << "Zones:  "  << gnumz << endl;
+    if (ghostzones)
+        cout << "Ghost zones:  " << gnumghz << endl;
     cout << "Sides:  "  << gnums << endl;
     cout << "Edges:  "  << gnume << endl;
     cout << "Side chunks:  " << gnumsch << endl;
     cout << "Point chunks:  " << gnumpch << endl;
+    if (Parallel::numpe > 1 && !ghostzones)
+        cout << "Point chunks with shared points:  " << gnumpchsh
+             << endl;
+    if (Parallel::numpe > 1) {
+        cout << "PE blocks:  " << gmesh->numpex << " x "
+             << gmesh->numpey;
+        if (gmesh->numnodex * gmesh->numnodey > 1)
+            cout << " (in " << gmesh->numnodex << " x "
+                 << gmesh->numnodey << " node blocks)";
+        cout << endl;
+        cout << "Boundary points on/off node:  " << gnumbndon << " / "
+             << gnumbndoff;
+        if (gnumbndoff > 0)
+            cout << " (ratio " << (double) gnumbndon / gnumbndoff
+                 << ")";
+        cout << endl;
+    }
     cout << "Zone chunks:  " << gnumzch << endl;
-    cout << "Chunk size:  " << chunksize << endl;
+    cout << "Side sub-chunks:  " << gnumsub << " (max size "
+         << subchsize << ")" << endl;
+    if (schsize == pchsize && pchsize == zchsize)
+        cout << "Chunk size:  " << schsize << endl;
+    else
+        cout << "Chunk sizes:  " << schsize << " (sides), "
+             << pchsize << " (points), " << zchsize << " (zones)"
+             << endl;
+    if (structured)
+        cout << "Inverse map:  structured" << endl;
+    else
+        cout << "Inverse map:  " << invmap << endl;
+    if (zonebatch) {
+        cout << "Zone batches:  " << numbat << " (sides per zone:";
+        for (int b = 0; b < numbat; ++b)
+            cout << " " << batnump[b];
+        cout << ")" << endl;
+    }
+    if (reorder != "none") {
+        cout << "Reordering:  " << reorder << endl;
+        cout << "Point index bandwidth:  " << gpbw0
+             << " before, " << gpbw << " after" << endl;
+        cout << "Avg point index distance:  " << gpdist0 / gnums
+             << " before, " << gpdist / gnums << " after" << endl;
+    }
     cout << "------------------------" << endl;
 
 }
 
 
+void Mesh::benchHalo(const int nrep) {
+    using Parallel::mype;
+
+    if (Parallel::numpe == 1) {
+        if (mype == 0)
+            cout << "Halo exchange benchmark:  only one PE" << endl;
+        return;
+    }
+    if (ghostzones) {
+        if (mype == 0)
+            cout << "Halo exchange benchmark:  no shared points "
+                 << "with ghostzones" << endl;
+        return;
+    }
+
+    const HaloExchange::Method methods[] = {
+        HaloExchange::p2p,
+        HaloExchange::persistent,
+        HaloExchange::neighbor,
+        HaloExchange::rma,
+        HaloExchange::shm
+    };
+    const int nummethods = sizeof(methods) / sizeof(methods[0]);
+    const HaloExchange::Method method0 = halomethod;
+
+    // sum a double and a double2, as the hydro cycle does; the
+    // test values differ between PEs and points, so that a wrong
+    // sum shows up
+    double* pm = Memory::alloc<double>(nump);
+    double2ptr pf = Memory::alloc2(nump);
+    vector<double> refm;
+    vector<double2> reff;
+
+    int64_t nummsg = 2 * (nummstrpe + numslvpe);
+    int64_t numbytes = 2 * (numslv + numprx) * 3 * sizeof(double);
+    Parallel::globalSum(nummsg);
+    Parallel::globalSum(numbytes);
+    if (mype == 0) {
+        cout << "--- Halo exchange benchmark ---" << endl;
+        cout << "Sums of 3 doubles per shared point, " << nrep
+             << " repetitions" << endl;
+        cout << "Messages per sum:  " << nummsg << endl;
+        cout << "Bytes per sum:  " << numbytes << endl;
+        cout << setw(12) << "method" << setw(14) << "us/sum"
+             << setw(12) << "check" << endl;
+    }
+
+    for (int i = 0; i < nummethods; ++i) {
+        // set up new exchanges for this method
+        halomethod = methods[i];
+        for (int j = 0; j < sharedsums.size(); ++j)
+            delete sharedsums[j];
+        sharedsums.resize(0);
+
+        for (int p = 0; p < nump; ++p) {
+            pm[p] = mype + 1. / (p + 1);
+            pf[p] = double2(mype * p, 1. / (mype + p + 1));
+        }
+        sumSharedPoints(pm, pf);
+        int nbad = 0;
+        if (i == 0) {
+            refm.assign(pm, pm + nump);
+            reff.assign(nump, double2());
+            for (int p = 0; p < nump; ++p)
+                reff[p] = pf[p];
+        }
+        else {
+            for (int p = 0; p < nump; ++p) {
+                double2 f = pf[p];
+                if (pm[p] != refm[p] || f.x != reff[p].x ||
+                        f.y != reff[p].y)
+                    nbad += 1;
+            }
+        }
+        Parallel::globalSum(nbad);
+
+        // time the sums on zero values, so that they don't grow,
+        // after one untimed sum; all PEs start together
+        for (int p = 0; p < nump; ++p) {
+            pm[p] = 0.;
+            pf[p] = double2(0., 0.);
+        }
+        sumSharedPoints(pm, pf);
+        int sync = 0;
+        Parallel::globalSum(sync);
+        const double tbegin = wallTime();
+        Exec::team([&]() {
+            for (int r = 0; r < nrep; ++r) {
+                startSharedSum(pm, pf);
+                finishSharedSums();
+            }
+        });
+        double t = wallTime() - tbegin;
+        Parallel::globalMax(t);
+
+        if (mype == 0) {
+            cout << setw(12) << HaloExchange::methodName(halomethod)
+                 << setw(14) << fixed << setprecision(2)
+                 << t / max(nrep, 1) * 1.e6
+                 << setw(12) << (nbad == 0 ? "ok" : "FAILED") << endl;
+            cout.unsetf(ios::floatfield);
+        }
+    }
+    if (mype == 0) cout << "-------------------------------" << endl;
+
+    halomethod = method0;
+    for (int j = 0; j < sharedsums.size(); ++j)
+        delete sharedsums[j];
+    sharedsums.resize(0);
+    Memory::free(pm);
+    Memory::free2(pf);
+
+}
+
+
 void Mesh::write(
         const string& probname,
         const int cycle,
@@ -442,16 +1512,66 @@ void Mesh::getPlaneChunks(
 }
 
 
+template <int N>
+void Mesh::calcCtrsBatch(
+        double2cptr px,
+        double2ptr ex,
+        double2ptr zx,
+        const int sfirst,
+        const int slast) {
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = sideZone<N>(s1);
+        const int n = zoneSides<N>(z);
+
+        double2 zc(0., 0.);
+        for (int i = 0; i < n; ++i) {
+            int p1 = sidePoint1<N>(s1, z, i);
+            int p2 = sidePoint2<N>(s1, z, i);
+            int e = sideEdge<N>(s1, z, i);
+            ex[e] = 0.5 * (px[p1] + px[p2]);
+            zc += px[p1];
+        }
+        zc /= (double) n;
+        zx[z] = zc;
+        s1 += n;
+    }
+
+}
+
+
 void Mesh::calcCtrs(
-        const double2* px,
-        double2* ex,
-        double2* zx,
+        double2cptr px,
+        double2ptr ex,
+        double2ptr zx,
         const int sfirst,
         const int slast) {
 
+    if (structured) {
+        calcCtrsBatch<rect>(px, ex, zx, sfirst, slast);
+        return;
+    }
+
+    if (numbat > 0) {
+        for (int b = 0; b < numbat; ++b) {
+            int sf = max(sfirst, batsfirst[b]);
+            int sl = min(slast, batslast[b]);
+            if (sf >= sl) continue;
+            switch (batnump[b]) {
+            case 3:  calcCtrsBatch<3>(px, ex, zx, sf, sl); break;
+            case 4:  calcCtrsBatch<4>(px, ex, zx, sf, sl); break;
+            case 6:  calcCtrsBatch<6>(px, ex, zx, sf, sl); break;
+            default: calcCtrsBatch<0>(px, ex, zx, sf, sl); break;
+            }
+        }
+        return;
+    }
+
     int zfirst = mapsz[sfirst];
     int zlast = (slast < nums ? mapsz[slast] : numz);
-    fill(&zx[zfirst], &zx[zlast], double2(0., 0.));
+    for (int z = zfirst; z < zlast; ++z)
+        zx[z] = double2(0., 0.);
 
     for (int s = sfirst; s < slast; ++s) {
         int p1 = mapsp1[s];
@@ -469,9 +1589,53 @@ void Mesh::calcCtrs(
 }
 
 
+template <int N>
+void Mesh::calcVolsBatch(
+        double2cptr px,
+        double2cptr zx,
+        double* sarea,
+        double* svol,
+        double* zarea,
+        double* zvol,
+        const int sfirst,
+        const int slast) {
+
+    const double third = 1. / 3.;
+    int count = 0;
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = sideZone<N>(s1);
+        const int n = zoneSides<N>(z);
+        const double2 zc = zx[z];
+
+        double za = 0.;
+        double zv = 0.;
+        for (int i = 0; i < n; ++i) {
+            int p1 = sidePoint1<N>(s1, z, i);
+            int p2 = sidePoint2<N>(s1, z, i);
+            double sa = 0.5 * cross(px[p2] - px[p1], zc - px[p1]);
+            double sv = third * sa * (px[p1].x + px[p2].x + zc.x);
+            sarea[s1 + i] = sa;
+            svol[s1 + i] = sv;
+            za += sa;
+            zv += sv;
+            if (sv <= 0.) count += 1;
+        }
+        zarea[z] = za;
+        zvol[z] = zv;
+        s1 += n;
+    }
+
+    if (count > 0) {
+        numsbad += count;
+    }
+
+}
+
+
 void Mesh::calcVols(
-        const double2* px,
-        const double2* zx,
+        double2cptr px,
+        double2cptr zx,
         double* sarea,
         double* svol,
         double* zarea,
@@ -479,6 +1643,35 @@ void Mesh::calcVols(
         const int sfirst,
         const int slast) {
 
+    if (structured) {
+        calcVolsBatch<rect>(px, zx, sarea, svol, zarea, zvol,
+                sfirst, slast);
+        return;
+    }
+
+    if (numbat > 0) {
+        for (int b = 0; b < numbat; ++b) {
+            int sf = max(sfirst, batsfirst[b]);
+            int sl = min(slast, batslast[b]);
+            if (sf >= sl) continue;
+            switch (batnump[b]) {
+            case 3:
+                calcVolsBatch<3>(px, zx, sarea, svol, zarea, zvol, sf, sl);
+                break;
+            case 4:
+                calcVolsBatch<4>(px, zx, sarea, svol, zarea, zvol, sf, sl);
+                break;
+            case 6:
+                calcVolsBatch<6>(px, zx, sarea, svol, zarea, zvol, sf, sl);
+                break;
+            default:
+                calcVolsBatch<0>(px, zx, sarea, svol, zarea, zvol, sf, sl);
+                break;
+            }
+        }
+        return;
+    }
+
     int zfirst = mapsz[sfirst];
     int zlast = (slast < nums ? mapsz[slast] : numz);
     fill(&zvol[zfirst], &zvol[zlast], 0.);
@@ -505,7 +1698,6 @@ void Mesh::calcVols(
     } // for s
 
     if (count > 0) {
-        #pragma omp atomic
         numsbad += count;
     }
 
@@ -516,7 +1708,8 @@ void Mesh::checkBadSides() {
 
     // if there were negative side volumes, error exit
     if (numsbad > 0) {
-        cerr << "Error: " << numsbad << " negative side volumes" << endl;
+        cerr << "Error: " << numsbad.load() << " negative side volumes"
+             << endl;
         cerr << "Exiting..." << endl;
         exit(1);
     }
@@ -524,6 +1717,26 @@ void Mesh::checkBadSides() {
 }
 
 
+template <int N>
+void Mesh::calcSideFracsBatch(
+        const double* sarea,
+        const double* zarea,
+        double* smf,
+        const int sfirst,
+        const int slast) {
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = sideZone<N>(s1);
+        const int n = zoneSides<N>(z);
+
+        for (int i = 0; i < n; ++i)
+            smf[s1 + i] = sarea[s1 + i] / zarea[z];
+        s1 += n;
+    }
+}
+
+
 void Mesh::calcSideFracs(
         const double* sarea,
         const double* zarea,
@@ -531,6 +1744,26 @@ void Mesh::calcSideFracs(
         const int sfirst,
         const int slast) {
 
+    if (structured) {
+        calcSideFracsBatch<rect>(sarea, zarea, smf, sfirst, slast);
+        return;
+    }
+
+    if (numbat > 0) {
+        for (int b = 0; b < numbat; ++b) {
+            int sf = max(sfirst, batsfirst[b]);
+            int sl = min(slast, batslast[b]);
+            if (sf >= sl) continue;
+            switch (batnump[b]) {
+            case 3:  calcSideFracsBatch<3>(sarea, zarea, smf, sf, sl); break;
+            case 4:  calcSideFracsBatch<4>(sarea, zarea, smf, sf, sl); break;
+            case 6:  calcSideFracsBatch<6>(sarea, zarea, smf, sf, sl); break;
+            default: calcSideFracsBatch<0>(sarea, zarea, smf, sf, sl); break;
+            }
+        }
+        return;
+    }
+
     #pragma ivdep
     for (int s = sfirst; s < slast; ++s) {
         int z = mapsz[s];
@@ -540,9 +1773,9 @@ void Mesh::calcSideFracs(
 
 
 void Mesh::calcSurfVecs(
-        const double2* zx,
-        const double2* ex,
-        double2* ssurf,
+        double2cptr zx,
+        double2cptr ex,
+        double2ptr ssurf,
         const int sfirst,
         const int slast) {
 
@@ -559,7 +1792,7 @@ void Mesh::calcSurfVecs(
 
 
 void Mesh::calcEdgeLen(
-        const double2* px,
+        double2cptr px,
         double* elen,
         const int sfirst,
         const int slast) {
@@ -575,12 +1808,58 @@ void Mesh::calcEdgeLen(
 }
 
 
+template <int N>
+void Mesh::calcCharLenBatch(
+        const double* sarea,
+        double* zdl,
+        const int sfirst,
+        const int slast) {
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = sideZone<N>(s1);
+        const int n = zoneSides<N>(z);
+        const double fac = (n == 3 ? 3. : 4.);
+
+        double zl = 1.e99;
+        for (int i = 0; i < n; ++i) {
+            int e = sideEdge<N>(s1, z, i);
+            double sdl = fac * sarea[s1 + i] / elen[e];
+            zl = min(zl, sdl);
+        }
+        zdl[z] = zl;
+        s1 += n;
+    }
+
+}
+
+
 void Mesh::calcCharLen(
         const double* sarea,
         double* zdl,
         const int sfirst,
         const int slast) {
 
+    if (structured) {
+        calcCharLenBatch<rect>(sarea, zdl, sfirst, slast);
+        return;
+    }
+
+    if (numbat > 0) {
+        for (int b = 0; b < numbat; ++b) {
+            int sf = max(sfirst, batsfirst[b]);
+            int sl = min(slast, batslast[b]);
+            if (sf >= sl) continue;
+            switch (batnump[b]) {
+            case 3:  calcCharLenBatch<3>(sarea, zdl, sf, sl); break;
+            case 4:  calcCharLenBatch<4>(sarea, zdl, sf, sl); break;
+            case 6:  calcCharLenBatch<6>(sarea, zdl, sf, sl); break;
+            default: calcCharLenBatch<0>(sarea, zdl, sf, sl); break;
+            }
+        }
+        return;
+    }
+
     int zfirst = mapsz[sfirst];
     int zlast = (slast < nums ? mapsz[slast] : numz);
     fill(&zdl[zfirst], &zdl[zlast], 1.e99);
@@ -598,193 +1877,682 @@ void Mesh::calcCharLen(
 }
 
 
-template <typename T>
-void Mesh::parallelGather(
-        const T* pvar,
-        T* prxvar) {
-#ifdef USE_MPI
-    // This routine gathers slave values for which MYPE owns the masters.
-    const int tagmpi = 100;
-    const int type_size = sizeof(T);
-//    std::vector<T> slvvar(numslv);
-    T* slvvar = Memory::alloc<T>(numslv);
+template <int N>
+void Mesh::calcGeometryBatch(
+        double2cptr px,
+        double2ptr ex,
+        double2ptr zx,
+        double* sarea,
+        double* svol,
+        double* zarea,
+        double* zvol,
+        double2ptr ssurf,
+        double* elen,
+        double* zdl,
+        const int sfirst,
+        const int slast) {
+
+    const double third = 1. / 3.;
+    int count = 0;
+
+    // sides of a zone are contiguous, so walk the chunk one zone
+    // at a time and keep zone quantities in registers
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = sideZone<N>(s1);
+        const int n = zoneSides<N>(z);
+        const int s2 = s1 + n;
+
+        // compute zone center
+        double2 zc(0., 0.);
+        for (int i = 0; i < n; ++i)
+            zc += px[sidePoint1<N>(s1, z, i)];
+        zc /= (double) n;
+
+        const double fac = (n == 3 ? 3. : 4.);
+        double za = 0.;
+        double zv = 0.;
+        double zl = 1.e99;
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            int p1 = sidePoint1<N>(s1, z, i);
+            int p2 = sidePoint2<N>(s1, z, i);
+            int e = sideEdge<N>(s1, z, i);
+
+            // edge center and length
+            double2 ec = 0.5 * (px[p1] + px[p2]);
+            double el = length(px[p2] - px[p1]);
+            ex[e] = ec;
+            elen[e] = el;
+
+            // side volumes, summed to zone
+            double sa = 0.5 * cross(px[p2] - px[p1], zc - px[p1]);
+            double sv = third * sa * (px[p1].x + px[p2].x + zc.x);
+            sarea[s] = sa;
+            svol[s] = sv;
+            za += sa;
+            zv += sv;
+
+            // check for negative side volumes
+            if (sv <= 0.) count += 1;
+
+            // surface vector and characteristic length
+            ssurf[s] = rotateCCW(ec - zc);
+            double sdl = fac * sa / el;
+            zl = min(zl, sdl);
+        }  // for i
+
+        zx[z] = zc;
+        zarea[z] = za;
+        zvol[z] = zv;
+        zdl[z] = zl;
+        s1 = s2;
+    }  // while s1
 
-    // Post receives for incoming messages from slaves.
-    // Store results in proxy buffer.
-//    vector<MPI_Request> request(numslvpe);
-    MPI_Request* request = Memory::alloc<MPI_Request>(numslvpe);
-    for (int slvpe = 0; slvpe < numslvpe; ++slvpe) {
-        int pe = mapslvpepe[slvpe];
-        int nprx = slvpenumprx[slvpe];
-        int prx1 = mapslvpeprx1[slvpe];
-        MPI_Irecv(&prxvar[prx1], nprx * type_size, MPI_BYTE,
-                pe, tagmpi, MPI_COMM_WORLD, &request[slvpe]);
+    if (count > 0) {
+        numsbad += count;
     }
 
-    // Load slave data buffer from points.
-    for (int slv = 0; slv < numslv; ++slv) {
-        int p = mapslvp[slv];
-        slvvar[slv] = pvar[p];
+}
+
+
+void Mesh::calcGeometry(
+        double2cptr px,
+        double2ptr ex,
+        double2ptr zx,
+        double* sarea,
+        double* svol,
+        double* zarea,
+        double* zvol,
+        double2ptr ssurf,
+        double* elen,
+        double* zdl,
+        const int sfirst,
+        const int slast) {
+
+    if (structured) {
+        calcGeometryBatch<rect>(px, ex, zx, sarea, svol, zarea, zvol,
+                ssurf, elen, zdl, sfirst, slast);
+        return;
     }
 
-    // Send slave data to master PEs.
-    for (int mstrpe = 0; mstrpe < nummstrpe; ++mstrpe) {
-        int pe = mapmstrpepe[mstrpe];
-        int nslv = mstrpenumslv[mstrpe];
-        int slv1 = mapmstrpeslv1[mstrpe];
-        MPI_Send(&slvvar[slv1], nslv * type_size, MPI_BYTE,
-                pe, tagmpi, MPI_COMM_WORLD);
-    }
-
-    // Wait for all receives to complete.
-//    vector<MPI_Status> status(numslvpe);
-    MPI_Status* status = Memory::alloc<MPI_Status>(numslvpe);
-    int ierr = MPI_Waitall(numslvpe, &request[0], &status[0]);
-    if (ierr != 0) {
-        cerr << "Error: parallelGather MPI error " << ierr <<
-                " on PE " << Parallel::mype << endl;
-        cerr << "Exiting..." << endl;
-        exit(1);
+    if (numbat > 0) {
+        for (int b = 0; b < numbat; ++b) {
+            int sf = max(sfirst, batsfirst[b]);
+            int sl = min(slast, batslast[b]);
+            if (sf >= sl) continue;
+            switch (batnump[b]) {
+            case 3:
+                calcGeometryBatch<3>(px, ex, zx, sarea, svol, zarea, zvol,
+                        ssurf, elen, zdl, sf, sl);
+                break;
+            case 4:
+                calcGeometryBatch<4>(px, ex, zx, sarea, svol, zarea, zvol,
+                        ssurf, elen, zdl, sf, sl);
+                break;
+            case 6:
+                calcGeometryBatch<6>(px, ex, zx, sarea, svol, zarea, zvol,
+                        ssurf, elen, zdl, sf, sl);
+                break;
+            default:
+                calcGeometryBatch<0>(px, ex, zx, sarea, svol, zarea, zvol,
+                        ssurf, elen, zdl, sf, sl);
+                break;
+            }
+        }
+        return;
     }
 
-    Memory::free(slvvar);
-    Memory::free(request);
-    Memory::free(status);
+    calcGeometryBatch<0>(px, ex, zx, sarea, svol, zarea, zvol,
+            ssurf, elen, zdl, sfirst, slast);
+
+}
+
+
+template <typename CPtr, typename PPtr>
+void Mesh::sumOnProcChunk(
+        const CPtr cvar,
+        const PPtr pvar,
+        const int pch) {
+
+    int pfirst = pchpfirst[pch];
+    int plast = pchplast[pch];
+    if (structured)
+        sumOnProcRect(cvar, pvar, pfirst, plast);
+    else if (mapslcc != NULL)
+        sumOnProcSell(cvar, pvar, pchslfirst[pch], pchsllast[pch]);
+    else if (mapccnext != NULL)
+        sumOnProcList(cvar, pvar, pfirst, plast);
+    else
+        sumOnProcCSR(cvar, pvar, pfirst, plast);
+
+}
+
+
+template <typename CPtr, typename PPtr>
+void Mesh::sumOnProcList(
+        const CPtr cvar,
+        const PPtr pvar,
+        const int pfirst,
+        const int plast) {
+
+    typedef typename decay<decltype(cvar[0])>::type T;
+
+    for (int p = pfirst; p < plast; ++p) {
+        T x = T();
+        for (int c = mappcfirst[p]; c >= 0; c = mapccnext[c]) {
+            x += cvar[c];
+        }
+        pvar[p] = x;
+    }  // for p
+
+}
+
+
+template <typename CPtr, typename PPtr>
+void Mesh::sumOnProcCSR(
+        const CPtr cvar,
+        const PPtr pvar,
+        const int pfirst,
+        const int plast) {
+
+    typedef typename decay<decltype(cvar[0])>::type T;
+
+    for (int p = pfirst; p < plast; ++p) {
+        T x = T();
+        for (int i = mappcoff[p]; i < mappcoff[p + 1]; ++i) {
+            x += cvar[mappc[i]];
+        }
+        pvar[p] = x;
+    }  // for p
+
+}
+
+
+template <typename CPtr, typename PPtr>
+void Mesh::sumOnProcRect(
+        const CPtr cvar,
+        const PPtr pvar,
+        const int pfirst,
+        const int plast) {
+
+    typedef typename decay<decltype(cvar[0])>::type T;
+
+    // each point has up to four corners, one in each neighboring
+    // zone; sum them in increasing corner order, as the CSR map does
+    const int npx = snzx + 1;
+    for (int p = pfirst; p < plast; ++p) {
+        int pj = p / npx;
+        int pi = p - pj * npx;
+        int zsw = (pj - 1) * snzx + pi - 1;
+        int znw = pj * snzx + pi - 1;
+        T x = T();
+        if (pj > 0) {
+            if (pi > 0)    x += cvar[4 * zsw + 2];
+            if (pi < snzx) x += cvar[4 * (zsw + 1) + 3];
+        }
+        if (pj < snzy) {
+            if (pi > 0)    x += cvar[4 * znw + 1];
+            if (pi < snzx) x += cvar[4 * (znw + 1)];
+        }
+        pvar[p] = x;
+    }  // for p
+
+}
+
+
+template <typename CPtr, typename PPtr>
+void Mesh::sumOnProcSell(
+        const CPtr cvar,
+        const PPtr pvar,
+        const int slfirst,
+        const int sllast) {
+
+    typedef typename decay<decltype(cvar[0])>::type T;
+
+    for (int sl = slfirst; sl < sllast; ++sl) {
+        const int* slcc = &mapslcc[slcfirst[sl]];
+        const int* slrp = &mapslrp[sl * sellc];
+        T x[sellc];
+        for (int i = 0; i < sellc; ++i)
+            x[i] = T();
+        // each column is one corner for each of the sellc points,
+        // so the inner loop runs across independent sums
+        for (int j = 0; j < slwidth[sl]; ++j) {
+            #pragma ivdep
+            for (int i = 0; i < sellc; ++i) {
+                int c = slcc[j * sellc + i];
+                if (c >= 0) x[i] += cvar[c];
+            }
+        }
+        for (int i = 0; i < sellc; ++i) {
+            int p = slrp[i];
+            if (p >= 0) pvar[p] = x[i];
+        }
+    }  // for sl
+
+}
+
+
+void Mesh::sumToPointsChunk(
+        const double* cvar,
+        double* pvar,
+        const int pch) {
+
+    sumOnProcChunk(cvar, pvar, pch);
+
+}
+
+
+void Mesh::sumToPointsChunk(
+        double2cptr cvar,
+        double2ptr pvar,
+        const int pch) {
+
+#ifdef USE_SOA
+    sumOnProcChunk(cvar.x, pvar.x, pch);
+    sumOnProcChunk(cvar.y, pvar.y, pch);
+#else
+    sumOnProcChunk(cvar, pvar, pch);
 #endif
+
 }
 
 
-template <typename T>
-void Mesh::parallelSum(
-        T* pvar,
-        T* prxvar) {
-#ifdef USE_MPI
-    // Compute sum of all (proxy/master) sets.
-    // Store results in master.
-    for (int prx = 0; prx < numprx; ++prx) {
-        int p = mapprxp[prx];
-        pvar[p] += prxvar[prx];
-    }
+void Mesh::sumToPointsChunk(
+        const double* cvar1,
+        double2cptr cvar2,
+        double* pvar1,
+        double2ptr pvar2,
+        const int pch) {
 
-    // Copy updated master data back to proxies.
-    for (int prx = 0; prx < numprx; ++prx) {
-        int p = mapprxp[prx];
-        prxvar[prx] = pvar[p];
-    }
+    const DoublePairCPtr cvar = { cvar1, cvar2 };
+    const DoublePairPtr pvar = { pvar1, pvar2 };
+    sumOnProcChunk(cvar, pvar, pch);
+
+}
+
+
+void Mesh::sumSharedPoints(double* pvar) {
+
+    const int width = 1;
+    postSharedSum(1, &pvar, &width);
+    completeSharedSums();
+
+}
+
+
+void Mesh::sumSharedPoints(double2ptr pvar) {
+
+#ifdef USE_SOA
+    double* pvars[2] = { pvar.x, pvar.y };
+    const int widths[2] = { 1, 1 };
+    postSharedSum(2, pvars, widths);
+#else
+    double* pvars[1] = { (double*) pvar };
+    const int widths[1] = { 2 };
+    postSharedSum(1, pvars, widths);
 #endif
+    completeSharedSums();
+
 }
 
 
-template <typename T>
-void Mesh::parallelScatter(
-        T* pvar,
-        const T* prxvar) {
-#ifdef USE_MPI
-    // This routine scatters master values on MYPE to all slave copies
-    // owned by other PEs.
-    const int tagmpi = 200;
-    const int type_size = sizeof(T);
-//    std::vector<T> slvvar(numslv);
-    T* slvvar = Memory::alloc<T>(numslv);
+void Mesh::sumSharedPoints(double* pvar1, double2ptr pvar2) {
 
-    // Post receives for incoming messages from masters.
-    // Store results in slave buffer.
-//    vector<MPI_Request> request(nummstrpe);
-    MPI_Request* request = Memory::alloc<MPI_Request>(nummstrpe);
-    for (int mstrpe = 0; mstrpe < nummstrpe; ++mstrpe) {
-        int pe = mapmstrpepe[mstrpe];
-        int nslv = mstrpenumslv[mstrpe];
-        int slv1 = mapmstrpeslv1[mstrpe];
-        MPI_Irecv(&slvvar[slv1], nslv * type_size, MPI_BYTE,
-                pe, tagmpi, MPI_COMM_WORLD,  &request[mstrpe]);
+#ifdef USE_SOA
+    double* pvars[3] = { pvar1, pvar2.x, pvar2.y };
+    const int widths[3] = { 1, 1, 1 };
+    postSharedSum(3, pvars, widths);
+#else
+    double* pvars[2] = { pvar1, (double*) pvar2 };
+    const int widths[2] = { 1, 2 };
+    postSharedSum(2, pvars, widths);
+#endif
+    completeSharedSums();
+
+}
+
+
+void Mesh::startSharedSum(double* pvar) {
+
+    const int width = 1;
+    startSharedSum(1, &pvar, &width);
+
+}
+
+
+void Mesh::startSharedSum(double2ptr pvar) {
+
+#ifdef USE_SOA
+    double* pvars[2] = { pvar.x, pvar.y };
+    const int widths[2] = { 1, 1 };
+    startSharedSum(2, pvars, widths);
+#else
+    double* pvars[1] = { (double*) pvar };
+    const int widths[1] = { 2 };
+    startSharedSum(1, pvars, widths);
+#endif
+
+}
+
+
+void Mesh::startSharedSum(double* pvar1, double2ptr pvar2) {
+
+#ifdef USE_SOA
+    double* pvars[3] = { pvar1, pvar2.x, pvar2.y };
+    const int widths[3] = { 1, 1, 1 };
+    startSharedSum(3, pvars, widths);
+#else
+    double* pvars[2] = { pvar1, (double*) pvar2 };
+    const int widths[2] = { 1, 2 };
+    startSharedSum(2, pvars, widths);
+#endif
+
+}
+
+
+void Mesh::startSharedSum(
+        const int numvars,
+        double* const* pvars,
+        const int* widths) {
+    if (Parallel::numpe == 1 || ghostzones) return;
+
+    if (numslv + numprx < packthreshold) {
+        #pragma omp master
+        postSharedSum(numvars, pvars, widths);
+        return;
     }
 
-    // Send updated slave data from proxy buffer back to slave PEs.
-    for (int slvpe = 0; slvpe < numslvpe; ++slvpe) {
-        int pe = mapslvpepe[slvpe];
-        int nprx = slvpenumprx[slvpe];
-        int prx1 = mapslvpeprx1[slvpe];
-        MPI_Send((void*)&prxvar[prx1], nprx * type_size, MPI_BYTE,
-                pe, tagmpi, MPI_COMM_WORLD);
-    }
-
-    // Wait for all receives to complete.
-//    vector<MPI_Status> status(nummstrpe);
-    MPI_Status* status = Memory::alloc<MPI_Status>(nummstrpe);
-    int ierr = MPI_Waitall(nummstrpe, &request[0], &status[0]);
-    if (ierr != 0) {
-        cerr << "Error: parallelScatter MPI error " << ierr <<
-                " on PE " << Parallel::mype << endl;
-        cerr << "Exiting..." << endl;
-        exit(1);
+    #pragma omp master
+    newSharedSum(numvars, pvars, widths);
+    #pragma omp barrier
+    SharedSum* ss = sharedsums[numsharedsums - 1];
+    const int numblk = (numslv + packblock - 1) / packblock;
+    Exec::parallelFor(numblk, [&](const int blk) {
+        packSharedSum(ss, blk * packblock,
+                min((blk + 1) * packblock, numslv));
+    });
+    #pragma omp master
+    ss->gather->start();
+
+}
+
+
+void Mesh::finishSharedSums() {
+    if (Parallel::numpe == 1 || ghostzones) return;
+
+    if (numslv + numprx < packthreshold) {
+        #pragma omp master
+        completeSharedSums();
+        #pragma omp barrier
+        return;
     }
 
-    // Store slave data from buffer back to points.
-    for (int slv = 0; slv < numslv; ++slv) {
-        int p = mapslvp[slv];
-        pvar[p] = slvvar[slv];
+    // finish the gathers and start the scatters for all sums,
+    // before waiting for any of the scatters
+    const int nsum = numsharedsums;
+    for (int i = 0; i < nsum; ++i) {
+        SharedSum* ss = sharedsums[i];
+        #pragma omp master
+        ss->gather->finish();
+        #pragma omp barrier
+        const int numblk = (nummstr + packblock - 1) / packblock;
+        Exec::parallelFor(numblk, [&](const int blk) {
+            sumSharedMasters(ss, blk * packblock,
+                    min((blk + 1) * packblock, nummstr));
+        });
+        #pragma omp master
+        ss->scatter->start();
+    }
+    for (int i = 0; i < nsum; ++i) {
+        SharedSum* ss = sharedsums[i];
+        #pragma omp master
+        ss->scatter->finish();
+        #pragma omp barrier
+        const int numblk = (numslv + packblock - 1) / packblock;
+        Exec::parallelFor(numblk, [&](const int blk) {
+            unpackSharedSum(ss, blk * packblock,
+                    min((blk + 1) * packblock, numslv));
+        });
     }
+    #pragma omp master
+    numsharedsums = 0;
+    #pragma omp barrier
 
-    Memory::free(slvvar);
-    Memory::free(request);
-    Memory::free(status);
-#endif
 }
 
 
-template <typename T>
-void Mesh::sumAcrossProcs(T* pvar) {
-    if (Parallel::numpe == 1) return;
-//    std::vector<T> prxvar(numprx);
-    T* prxvar = Memory::alloc<T>(numprx);
-    parallelGather(pvar, &prxvar[0]);
-    parallelSum(pvar, &prxvar[0]);
-    parallelScatter(pvar, &prxvar[0]);
-    Memory::free(prxvar);
+void Mesh::postSharedSum(
+        const int numvars,
+        double* const* pvars,
+        const int* widths) {
+    if (Parallel::numpe == 1 || ghostzones) return;
+
+    SharedSum* ss = newSharedSum(numvars, pvars, widths);
+    packSharedSum(ss, 0, numslv);
+    ss->gather->start();
+
 }
 
 
-template <typename T>
-void Mesh::sumOnProc(
-        const T* cvar,
-        T* pvar) {
+void Mesh::completeSharedSums() {
 
-    #pragma omp parallel for schedule(static)
-    for (int pch = 0; pch < numpch; ++pch) {
-        int pfirst = pchpfirst[pch];
-        int plast = pchplast[pch];
-        for (int p = pfirst; p < plast; ++p) {
-            T x = T();
-            for (int c = mappcfirst[p]; c >= 0; c = mapccnext[c]) {
-                x += cvar[c];
+    for (int i = 0; i < numsharedsums; ++i) {
+        SharedSum* ss = sharedsums[i];
+        ss->gather->finish();
+        sumSharedMasters(ss, 0, nummstr);
+        ss->scatter->start();
+    }
+    for (int i = 0; i < numsharedsums; ++i) {
+        SharedSum* ss = sharedsums[i];
+        ss->scatter->finish();
+        unpackSharedSum(ss, 0, numslv);
+    }
+    numsharedsums = 0;
+
+}
+
+
+Mesh::SharedSum* Mesh::newSharedSum(
+        const int numvars,
+        double* const* pvars,
+        const int* widths) {
+
+    if (numsharedsums == sharedsums.size())
+        sharedsums.push_back(new SharedSum);
+    SharedSum* ss = sharedsums[numsharedsums];
+    int width = 0;
+    for (int v = 0; v < numvars; ++v) {
+        ss->pvar[v] = pvars[v];
+        ss->pwidth[v] = widths[v];
+        width += widths[v];
+    }
+    ss->numvars = numvars;
+
+    // the exchanges are tied to the buffers, so they are only
+    // set up again if the buffers change size.  Each sum in
+    // progress has its own tags, so its messages aren't matched
+    // with another's.
+    if (ss->gather == NULL || width != ss->width) {
+        delete ss->gather;
+        delete ss->scatter;
+        ss->width = width;
+        ss->slvbuf.resize(numslv * width);
+        ss->prxbuf.resize(numprx * width);
+        const int tag = 300 + 2 * numsharedsums;
+        ss->gather = new HaloExchange(halomethod,
+                nummstrpe, mapmstrpepe, mapmstrpeslv1, mstrpenumslv,
+                ss->slvbuf.data(),
+                numslvpe, mapslvpepe, mapslvpeprx1, slvpenumprx,
+                ss->prxbuf.data(),
+                width, tag);
+        ss->scatter = new HaloExchange(halomethod,
+                numslvpe, mapslvpepe, mapslvpeprx1, slvpenumprx,
+                ss->prxbuf.data(),
+                nummstrpe, mapmstrpepe, mapmstrpeslv1, mstrpenumslv,
+                ss->slvbuf.data(),
+                width, tag + 1);
+    }
+
+    numsharedsums += 1;
+    return ss;
+
+}
+
+
+void Mesh::packSharedSum(
+        SharedSum* ss,
+        const int first,
+        const int last) {
+
+    // Load slave data buffer from points.
+    const int width = ss->width;
+    int off = 0;
+    for (int v = 0; v < ss->numvars; ++v) {
+        const double* pvar = ss->pvar[v];
+        const int pw = ss->pwidth[v];
+        double* slvbuf = ss->slvbuf.data() + off;
+        for (int slv = first; slv < last; ++slv) {
+            int p = mapslvp[slv];
+            for (int k = 0; k < pw; ++k)
+                slvbuf[slv * width + k] = pvar[p * pw + k];
+        }
+        off += pw;
+    }
+
+}
+
+
+void Mesh::sumSharedMasters(
+        SharedSum* ss,
+        const int first,
+        const int last) {
+
+    // Compute sum of all (proxy/master) sets, store results in
+    // master, and copy them back to proxies.  The proxies of each
+    // master are added in increasing order.
+    const int width = ss->width;
+    int off = 0;
+    for (int v = 0; v < ss->numvars; ++v) {
+        double* pvar = ss->pvar[v];
+        const int pw = ss->pwidth[v];
+        double* prxbuf = ss->prxbuf.data() + off;
+        for (int m = first; m < last; ++m) {
+            int p = mapmstrp[m];
+            for (int k = 0; k < pw; ++k) {
+                double x = pvar[p * pw + k];
+                for (int i = mstrprx1[m]; i < mstrprx1[m + 1]; ++i)
+                    x += prxbuf[mapmstrprx[i] * width + k];
+                pvar[p * pw + k] = x;
+                for (int i = mstrprx1[m]; i < mstrprx1[m + 1]; ++i)
+                    prxbuf[mapmstrprx[i] * width + k] = x;
             }
-            pvar[p] = x;
-        }  // for p
-    }  // for pch
+        }
+        off += pw;
+    }
 
 }
 
 
-template <>
-void Mesh::sumToPoints(
-        const double* cvar,
-        double* pvar) {
+void Mesh::unpackSharedSum(
+        SharedSum* ss,
+        const int first,
+        const int last) {
 
-    sumOnProc(cvar, pvar);
-    if (Parallel::numpe > 1)
-        sumAcrossProcs(pvar);
+    // Store slave data from buffer back to points.
+    const int width = ss->width;
+    int off = 0;
+    for (int v = 0; v < ss->numvars; ++v) {
+        double* pvar = ss->pvar[v];
+        const int pw = ss->pwidth[v];
+        const double* slvbuf = ss->slvbuf.data() + off;
+        for (int slv = first; slv < last; ++slv) {
+            int p = mapslvp[slv];
+            for (int k = 0; k < pw; ++k)
+                pvar[p * pw + k] = slvbuf[slv * width + k];
+        }
+        off += pw;
+    }
 
 }
 
 
-template <>
-void Mesh::sumToPoints(
-        const double2* cvar,
-        double2* pvar) {
+void Mesh::exchangeGhosts(
+        const int numzvars,
+        double* const* zvars,
+        const int numpvars,
+        const double2ptr* pvars) {
+    if (!ghostzones) return;
+
+    // each neighbor's block of a buffer holds the values at its
+    // zones, then at its points.  The exchange is tied to the
+    // buffers, so it is only set up again if they change size.
+    const int widthz = numzvars;
+    const int widthp = 2 * numpvars;
+    if (ghostexch == NULL || widthz != ghostwidthz ||
+            widthp != ghostwidthp) {
+        delete ghostexch;
+        ghostwidthz = widthz;
+        ghostwidthp = widthp;
+        vector<int> sfirst(numghostpe), scount(numghostpe);
+        vector<int> rfirst(numghostpe), rcount(numghostpe);
+        for (int n = 0; n < numghostpe; ++n) {
+            sfirst[n] = ghostpesz1[n] * widthz + ghostpesp1[n] * widthp;
+            scount[n] = ghostpesz1[n + 1] * widthz +
+                    ghostpesp1[n + 1] * widthp - sfirst[n];
+            rfirst[n] = ghostperz1[n] * widthz + ghostperp1[n] * widthp;
+            rcount[n] = ghostperz1[n + 1] * widthz +
+                    ghostperp1[n + 1] * widthp - rfirst[n];
+        }
+        ghostsbuf.resize(mapghostsz.size() * widthz +
+                mapghostsp.size() * widthp);
+        ghostrbuf.resize(numghostz * widthz + numghostp * widthp);
+        ghostexch = new HaloExchange(halomethod,
+                numghostpe, &mapghostpepe[0], &sfirst[0], &scount[0],
+                ghostsbuf.data(),
+                numghostpe, &mapghostpepe[0], &rfirst[0], &rcount[0],
+                ghostrbuf.data(),
+                1, 202);
+    }
 
-    sumOnProc(cvar, pvar);
-    if (Parallel::numpe > 1)
-        sumAcrossProcs(pvar);
+    // load the buffer from the zones and points sent
+    double* sbuf = ghostsbuf.data();
+    for (int n = 0; n < numghostpe; ++n) {
+        for (int i = ghostpesz1[n]; i < ghostpesz1[n + 1]; ++i) {
+            int z = mapghostsz[i];
+            for (int v = 0; v < numzvars; ++v)
+                *sbuf++ = zvars[v][z];
+        }
+        for (int i = ghostpesp1[n]; i < ghostpesp1[n + 1]; ++i) {
+            int p = mapghostsp[i];
+            for (int v = 0; v < numpvars; ++v) {
+                double2 x = pvars[v][p];
+                *sbuf++ = x.x;
+                *sbuf++ = x.y;
+            }
+        }
+    }
+
+    ghostexch->start();
+    ghostexch->finish();
+
+    // store the values received at the ghosts
+    const double* rbuf = ghostrbuf.data();
+    for (int n = 0; n < numghostpe; ++n) {
+        for (int i = ghostperz1[n]; i < ghostperz1[n + 1]; ++i) {
+            int z = mapghostrz[i];
+            for (int v = 0; v < numzvars; ++v)
+                zvars[v][z] = *rbuf++;
+        }
+        for (int i = ghostperp1[n]; i < ghostperp1[n + 1]; ++i) {
+            int p = mapghostrp[i];
+            for (int v = 0; v < numpvars; ++v) {
+                pvars[v][p] = double2(rbuf[0], rbuf[1]);
+                rbuf += 2;
+            }
+        }
+    }
 
 }
 
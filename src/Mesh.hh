@@ -15,8 +15,11 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
+#include <stdint.h>
 
-#include "Vec2.hh"
+#include "Vec2Ptr.hh"
+#include "HaloExchange.hh"
 
 // forward declarations
 class InputFile;
@@ -35,9 +38,29 @@ public:
 
     // parameters
     int chunksize;                 // max size for processing chunks
+    int schsize;                   // max sizes of side, point and
+    int pchsize;                   // zone chunks (normally all equal
+    int zchsize;                   // to chunksize)
+    int subchsize;                 // max size of side sub-chunks,
+                                   // sized to fit the L1 cache if 0
     std::vector<double> subregion; // bounding box for a subregion
                                    // if nonempty, should have 4 entries:
                                    // xmin, xmax, ymin, ymax
+    std::string reorder;           // point/zone renumbering for locality:
+                                   // none, hilbert, morton, or rcm
+    std::string invmap;            // layout of point-to-corner map:
+                                   // list, csr, or sell
+    bool fusegeom;                 // flag:  use fused geometry kernel
+                                   // in predictor?
+    bool zonebatch;                // flag:  sort zones into batches
+                                   // by number of sides?
+    bool structured;               // flag:  compute connectivity from
+                                   // indices (rect meshes only)?
+    bool firsttouch;               // flag:  place array pages near
+                                   // the threads that use them?
+    bool ghostzones;               // flag:  keep a layer of ghost zones
+                                   // from neighboring PEs, instead of
+                                   // summing at shared points?
     bool writexy;                  // flag:  write .xy file?
     bool writegold;                // flag:  write Ensight file?
 
@@ -47,7 +70,10 @@ public:
     int nump, nume, numz, nums, numc;
                        // number of points, edges, zones,
                        // sides, corners, resp.
-    int numsbad;       // number of bad sides (negative volume)
+    std::atomic<int> numsbad;
+                       // number of bad sides (negative volume)
+    // side maps; on a structured mesh these aren't built (they
+    // are NULL), and connectivity is computed from indices instead
     int* mapsp1;       // maps: side -> points 1 and 2
     int* mapsp2;
     int* mapsz;        // map: side -> zone
@@ -55,9 +81,22 @@ public:
     int* mapss3;       // map: side -> previous side
     int* mapss4;       // map: side -> next side
 
-    // point-to-corner inverse map is stored as a linked list...
+    // point-to-corner inverse map is stored in compressed-row
+    // form (corners for each point are in increasing order)...
+    // (not built on a structured mesh either)
+    int* mappcoff;     // map:  point -> first entry in mappc
+                       // (nump + 1 entries)
+    int* mappc;        // corners, grouped by point
+    // ...and optionally as a linked list...
     int* mappcfirst;   // map:  point -> first corner
     int* mapccnext;    // map:  corner -> next corner
+    // ...or in SELL-C-sigma form:  slices of sellc points, padded
+    // to the largest valence in the slice and stored column-major
+    int numsl;         // number of slices
+    int* mapslrp;      // map:  slice row -> point (-1 if padding)
+    int* slcfirst;     // index of first slice entry in mapslcc
+    int* slwidth;      // slice width (max corners per point)
+    int* mapslcc;      // map:  slice entry -> corner (-1 if padding)
 
     // mpi comm variables
     int nummstrpe;     // number of messages mype sends to master pes
@@ -72,16 +111,65 @@ public:
     int* mstrpenumslv; // number of slaves for each master pe
     int* mapmstrpeslv1;// map: master pe -> first slave in slave buffer
     int* mapslvp;      // map: slave -> corresponding (slave) point
+    int nummstr;       // number of masters (points with proxies)
+    int* mapmstrp;     // map: master -> corresponding point
+    int* mstrprx1;     // first proxy of each master in mapmstrprx
+                       // (nummstr + 1 entries)
+    int* mapmstrprx;   // proxies of each master, in increasing order
+    HaloExchange::Method halomethod;
+                       // method for exchanges at shared points
+                       // or ghosts
+
+    // ghost zone comm variables (ghostzones only):  ghost zones
+    // and points are computed on mype along with its own, but
+    // their values are only right once they have been copied from
+    // the PEs that own them.  Lists are grouped by neighbor PE.
+    int numghostz;     // number of ghost zones on mype
+    int numghostp;     // number of ghost points (points not in any
+                       // zone of mype's own)
+    int numghostpe;    // number of neighbor PEs
+    std::vector<int> mapghostpepe;
+                       // map: neighbor pe -> (global) pe
+    std::vector<int> ghostperz1;
+                       // first zone from each neighbor pe in
+                       // mapghostrz (numghostpe + 1 entries)
+    std::vector<int> ghostperp1;
+                       // first point from each in mapghostrp
+    std::vector<int> mapghostrz;
+                       // map: received ghost zone -> zone
+    std::vector<int> mapghostrp;
+                       // map: received ghost point -> point
+    std::vector<int> ghostpesz1;
+                       // first zone to each neighbor pe in
+                       // mapghostsz (numghostpe + 1 entries)
+    std::vector<int> ghostpesp1;
+                       // first point to each in mapghostsp
+    std::vector<int> mapghostsz;
+                       // map: sent zone -> zone
+    std::vector<int> mapghostsp;
+                       // map: sent point -> point
+    int numpown;       // number of points counted as mype's in
+                       // mesh statistics
 
     int* znump;        // number of points in zone
-
-    double2* px;       // point coordinates
-    double2* ex;       // edge center coordinates
-    double2* zx;       // zone center coordinates
-    double2* pxp;      // point coords, middle of cycle
-    double2* exp;      // edge ctr coords, middle of cycle
-    double2* zxp;      // zone ctr coords, middle of cycle
-    double2* px0;      // point coords, start of cycle
+    int snzx, snzy;    // number of zones in x, y directions
+                       // (structured mesh only)
+    int* mapzorig;     // map: zone -> zone as generated
+                       // (NULL if mesh was not reordered)
+
+    // locality metrics for point numbering, before and after
+    // reordering (see Reorder::calcLocality)
+    int pbw0, pbw;     // point index bandwidth
+    double pdist0, pdist;
+                       // sum of side point index distances
+
+    double2ptr px;     // point coordinates
+    double2ptr ex;     // edge center coordinates
+    double2ptr zx;     // zone center coordinates
+    double2ptr pxp;    // point coords, middle of cycle
+    double2ptr exp;    // edge ctr coords, middle of cycle
+    double2ptr zxp;    // zone ctr coords, middle of cycle
+    double2ptr px0;    // point coords, start of cycle
 
     double* sarea;     // side area
     double* svol;      // side volume
@@ -93,7 +181,7 @@ public:
     double* zvolp;     // zone volume, middle of cycle
     double* zvol0;     // zone volume, start of cycle
 
-    double2* ssurfp;   // side surface vector
+    double2ptr ssurfp; // side surface vector
     double* elen;      // edge length
     double* smf;       // side mass fraction
     double* zdl;       // zone characteristic length
@@ -109,12 +197,38 @@ public:
     int numzch;                    // number of zone chunks
     std::vector<int> zchzfirst;    // start/stop index for zone chunks
     std::vector<int> zchzlast;
+    std::vector<int> schsubfirst;  // first sub-chunk of each side
+                                   // chunk (numsch + 1 entries)
+    std::vector<int> subsfirst;    // start/stop index for side
+    std::vector<int> subslast;     // sub-chunks
+    std::vector<int> pchslfirst;   // start/stop index for slices in
+    std::vector<int> pchsllast;    // each point chunk (sell only)
+    std::vector<int> pchshared;    // point chunks with points shared
+                                   // with other PEs
+    std::vector<int> pchinterior;  // all other point chunks
+    std::vector<int> ownzfirst;    // start/stop index for runs of
+    std::vector<int> ownzlast;     // zones owned by mype (all zones,
+    std::vector<int> ownsfirst;    // unless ghostzones), and their
+    std::vector<int> ownslast;     // sides
+    int numbat;                    // number of zone batches
+    std::vector<int> batsfirst;    // start/stop side index for batches
+    std::vector<int> batslast;
+    std::vector<int> batnump;      // number of points per zone in batch
 
     Mesh(const InputFile* inp);
     ~Mesh();
 
     void init();
 
+    // renumber points and zones for locality
+    void reorderMesh(
+            std::vector<double2>& nodepos,
+            std::vector<int>& cellstart,
+            std::vector<int>& cellsize,
+            std::vector<int>& cellnodes,
+            std::vector<int>& slavepoints,
+            std::vector<int>& masterpoints);
+
     // populate mapping arrays
     void initSides(
             const std::vector<int>& cellstart,
@@ -122,11 +236,30 @@ public:
             const std::vector<int>& cellnodes);
     void initEdges();
 
+    // populate zone batch information
+    void initBatches();
+
     // populate chunk information
     void initChunks();
 
+    // change the chunk sizes after initialization, and rebuild
+    // the structures that depend on them
+    void setChunkSizes(
+            const int ssize,
+            const int psize,
+            const int zsize);
+
+    // after the chunks change, move the pages of the mesh arrays
+    // to the threads that now own them, keeping their contents
+    void redistribute();
+
     // populate inverse map
     void initInvMap();
+    void initSellMap();
+
+    // place pages of mesh arrays for NUMA locality
+    void initFirstTouch();
+    void distributeMaps();
 
     void initParallel(
             const std::vector<int>& slavemstrpes,
@@ -136,9 +269,33 @@ public:
             const std::vector<int>& masterslvcounts,
             const std::vector<int>& masterpoints);
 
+    // find the zones owned by mype, and with ghost zones, set up
+    // the lists of ghosts to exchange with the neighbor PEs
+    void initGhosts(
+            const std::vector<int>& cellstart,
+            const std::vector<int>& cellsize,
+            const std::vector<int>& cellnodes,
+            const std::vector<int>& zonepes,
+            const std::vector<int64_t>& zoneglobal);
+
+    // find the runs of owned zones that overlap zones
+    // [zfirst, zlast); the caller clips them to that range
+    void getOwnedRuns(
+            const int zfirst,
+            const int zlast,
+            int& rfirst,
+            int& rlast) const;
+
+    // sort point chunks into shared and interior ones
+    void initSharedChunks();
+
     // write mesh statistics
     void writeStats();
 
+    // time nrep sums at shared points with each exchange method,
+    // check that they agree, and report the results
+    void benchHalo(const int nrep);
+
     // write mesh
     void write(
             const std::string& probname,
@@ -161,16 +318,16 @@ public:
 
     // compute edge, zone centers
     void calcCtrs(
-            const double2* px,
-            double2* ex,
-            double2* zx,
+            double2cptr px,
+            double2ptr ex,
+            double2ptr zx,
             const int sfirst,
             const int slast);
 
     // compute side, corner, zone volumes
     void calcVols(
-            const double2* px,
-            const double2* zx,
+            double2cptr px,
+            double2cptr zx,
             double* sarea,
             double* svol,
             double* zarea,
@@ -183,6 +340,13 @@ public:
     void checkBadSides();
 
     // compute side mass fractions
+    template <int N>
+    void calcSideFracsBatch(
+            const double* sarea,
+            const double* zarea,
+            double* smf,
+            const int sfirst,
+            const int slast);
     void calcSideFracs(
             const double* sarea,
             const double* zarea,
@@ -192,15 +356,15 @@ public:
 
     // compute surface vectors for median mesh
     void calcSurfVecs(
-            const double2* zx,
-            const double2* ex,
-            double2* ssurf,
+            double2cptr zx,
+            double2cptr ex,
+            double2ptr ssurf,
             const int sfirst,
             const int slast);
 
     // compute edge lengths
     void calcEdgeLen(
-            const double2* px,
+            double2cptr px,
             double* elen,
             const int sfirst,
             const int slast);
@@ -212,31 +376,245 @@ public:
             const int sfirst,
             const int slast);
 
-    // sum corner variables to points (double or double2)
-    template <typename T>
-    void sumToPoints(
-            const T* cvar,
-            T* pvar);
-
-    // helper routines for sumToPoints
-    template <typename T>
-    void sumOnProc(
-            const T* cvar,
-            T* pvar);
-    template <typename T>
-    void sumAcrossProcs(T* pvar);
-    template <typename T>
-    void parallelGather(
-            const T* pvar,
-            T* prxvar);
-    template <typename T>
-    void parallelSum(
-            T* pvar,
-            T* prxvar);
-    template <typename T>
-    void parallelScatter(
-            T* pvar,
-            const T* prxvar);
+    // compute all predictor geometry (edge and zone centers,
+    // side and zone volumes, surface vectors, edge lengths,
+    // characteristic lengths) in a single pass over the sides;
+    // gives the same results as calling calcCtrs, calcVols,
+    // calcSurfVecs, calcEdgeLen, calcCharLen in sequence
+    void calcGeometry(
+            double2cptr px,
+            double2ptr ex,
+            double2ptr zx,
+            double* sarea,
+            double* svol,
+            double* zarea,
+            double* zvol,
+            double2ptr ssurf,
+            double* elen,
+            double* zdl,
+            const int sfirst,
+            const int slast);
+
+    // template argument for side kernels on a structured mesh:
+    // four sides per zone, with all connectivity computed from
+    // zone indices instead of read from the side maps
+    static const int rect = -4;
+
+    // connectivity for side kernels templated on the number of
+    // sides per zone; s1 is the first side of zone z, and i
+    // is the index of a side within the zone
+    template <int N>
+    int zoneSides(const int z) const {
+        return (N == rect ? 4 : (N > 0 ? N : znump[z]));
+    }
+    template <int N>
+    int sideZone(const int s1) const {
+        return (N == rect ? s1 / 4 : mapsz[s1]);
+    }
+    template <int N>
+    int sidePoint1(const int s1, const int z, const int i) const {
+        if (N != rect) return mapsp1[s1 + i];
+        // point (i, j) is numbered j * (snzx + 1) + i
+        const int p0 = z + z / snzx;
+        return p0 + (i == 0 ? 0 :
+                     i == 1 ? 1 :
+                     i == 2 ? snzx + 2 : snzx + 1);
+    }
+    template <int N>
+    int sidePoint2(const int s1, const int z, const int i) const {
+        if (N != rect) return mapsp2[s1 + i];
+        return sidePoint1<N>(s1, z, (i + 1) & 3);
+    }
+    template <int N>
+    int sideEdge(const int s1, const int z, const int i) const {
+        if (N != rect) return mapse[s1 + i];
+        // horizontal edges first, numbered like zones, then
+        // vertical edges, numbered like points
+        const int p0 = z + z / snzx;
+        const int numeh = (snzy + 1) * snzx;
+        return (i == 0 ? z :
+                i == 1 ? numeh + p0 + 1 :
+                i == 2 ? z + snzx : numeh + p0);
+    }
+
+    // zone and first point of any side s, for setup code which
+    // visits sides one at a time
+    int sideZoneAny(const int s) const {
+        return (structured ? sideZone<rect>(s) : mapsz[s]);
+    }
+    int sidePoint1Any(const int s) const {
+        if (!structured) return mapsp1[s];
+        const int z = s / 4;
+        return sidePoint1<rect>(4 * z, z, s - 4 * z);
+    }
+
+    // versions of the geometry routines for a range of sides
+    // within one zone batch; N is the number of sides per zone,
+    // 0 for a generic batch, or rect for a structured mesh
+    template <int N>
+    void calcCtrsBatch(
+            double2cptr px,
+            double2ptr ex,
+            double2ptr zx,
+            const int sfirst,
+            const int slast);
+    template <int N>
+    void calcVolsBatch(
+            double2cptr px,
+            double2cptr zx,
+            double* sarea,
+            double* svol,
+            double* zarea,
+            double* zvol,
+            const int sfirst,
+            const int slast);
+    template <int N>
+    void calcCharLenBatch(
+            const double* sarea,
+            double* zdl,
+            const int sfirst,
+            const int slast);
+    template <int N>
+    void calcGeometryBatch(
+            double2cptr px,
+            double2ptr ex,
+            double2ptr zx,
+            double* sarea,
+            double* svol,
+            double* zarea,
+            double* zvol,
+            double2ptr ssurf,
+            double* elen,
+            double* zdl,
+            const int sfirst,
+            const int slast);
+
+    // sum corner variables to the points of one point chunk,
+    // without summing shared points across PEs
+    void sumToPointsChunk(
+            const double* cvar,
+            double* pvar,
+            const int pch);
+    void sumToPointsChunk(
+            double2cptr cvar,
+            double2ptr pvar,
+            const int pch);
+    void sumToPointsChunk(
+            const double* cvar1,
+            double2cptr cvar2,
+            double* pvar1,
+            double2ptr pvar2,
+            const int pch);
+
+    // sum point variables at points shared with other PEs; used
+    // after sumToPointsChunk has been called for all point chunks.
+    // Must be called by one thread only, with no nonblocking sums
+    // (below) in progress.
+    void sumSharedPoints(double* pvar);
+    void sumSharedPoints(double2ptr pvar);
+    void sumSharedPoints(double* pvar1, double2ptr pvar2);
+
+    // nonblocking version of sumSharedPoints:  start the sums for
+    // one or more variables, once sumToPointsChunk has been called
+    // for the chunks in pchshared, then finish them all.  Other
+    // work can be done in between, as long as it doesn't use the
+    // variables at shared points.  Both must be called by all
+    // threads of a team region (or outside of one); MPI calls are
+    // made by the master thread, and on large meshes the buffers
+    // are packed and unpacked by all threads.  finishSharedSums
+    // ends with a barrier.
+    void startSharedSum(double* pvar);
+    void startSharedSum(double2ptr pvar);
+    void startSharedSum(double* pvar1, double2ptr pvar2);
+    void finishSharedSums();
+
+    // helper routines for sumToPointsChunk; CPtr and PPtr are
+    // pointers to the corner and point variables, or views which
+    // index several variables together
+    template <typename CPtr, typename PPtr>
+    void sumOnProcChunk(
+            const CPtr cvar,
+            const PPtr pvar,
+            const int pch);
+    template <typename CPtr, typename PPtr>
+    void sumOnProcList(
+            const CPtr cvar,
+            const PPtr pvar,
+            const int pfirst,
+            const int plast);
+    template <typename CPtr, typename PPtr>
+    void sumOnProcCSR(
+            const CPtr cvar,
+            const PPtr pvar,
+            const int pfirst,
+            const int plast);
+    template <typename CPtr, typename PPtr>
+    void sumOnProcRect(
+            const CPtr cvar,
+            const PPtr pvar,
+            const int pfirst,
+            const int plast);
+    template <typename CPtr, typename PPtr>
+    void sumOnProcSell(
+            const CPtr cvar,
+            const PPtr pvar,
+            const int slfirst,
+            const int sllast);
+
+    // sums at shared points in progress.  The first numsharedsums
+    // entries of sharedsums are in progress; the rest are kept for
+    // reuse, so that their buffers and messages are only set up
+    // once.
+    struct SharedSum;
+    std::vector<SharedSum*> sharedsums;
+    int numsharedsums;
+
+    // copy the values of zone variables zvars at ghost zones, and
+    // point variables pvars at ghost points, from the PEs that own
+    // them.  All variables are sent in one message per neighbor
+    // PE.  Must be called by one thread only.
+    void exchangeGhosts(
+            const int numzvars,
+            double* const* zvars,
+            const int numpvars,
+            const double2ptr* pvars);
+    std::vector<double> ghostsbuf;  // ghost values sent
+    std::vector<double> ghostrbuf;  // and received
+    HaloExchange* ghostexch;        // exchange for the ghost buffers
+    int ghostwidthz, ghostwidthp;   // doubles per zone and point in
+                                    // the ghost buffers
+
+    // helpers for the shared sums:  start a sum of numvars
+    // variables packed into one message, variable v with widths[v]
+    // doubles per point, or finish all sums in progress, on one
+    // thread only
+    void startSharedSum(
+            const int numvars,
+            double* const* pvars,
+            const int* widths);
+    void postSharedSum(
+            const int numvars,
+            double* const* pvars,
+            const int* widths);
+    void completeSharedSums();
+    // set up the next sum, and return it
+    SharedSum* newSharedSum(
+            const int numvars,
+            double* const* pvars,
+            const int* widths);
+    // steps of a sum, for slaves or masters in [first, last)
+    void packSharedSum(
+            SharedSum* ss,
+            const int first,
+            const int last);
+    void sumSharedMasters(
+            SharedSum* ss,
+            const int first,
+            const int last);
+    void unpackSharedSum(
+            SharedSum* ss,
+            const int first,
+            const int last);
 
 }; // class Mesh
 
@@ -12,48 +12,273 @@
 
 #include "Parallel.hh"
 
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
 #include <vector>
 #include <algorithm>
 #include <numeric>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "Vec2.hh"
 
 
 namespace Parallel {
 
+namespace {
+
+// PE count and number for the process, which each thread starts
+// with; in-process domains replace them on their own threads
 #ifdef USE_MPI
 // We're running under MPI, so set these to dummy values
 // that will be overwritten on MPI_Init.
-int numpe = 0;
-int mype = -1;
+int procnumpe = 0;
+int procmype = -1;
 #else
 // We're in serial mode, so only 1 PE.
-int numpe = 1;
-int mype = 0;
+int procnumpe = 1;
+int procmype = 0;
+#endif
+
+// node of each MPI PE, and number of nodes
+std::vector<int> procnode(1, 0);
+int procnumnode = 1;
+// PEs per node from PENNANT_PES_PER_NODE, or 0 if not set
+int envpernode = 0;
+
+}  // namespace
+
+thread_local int numpe = procnumpe;
+thread_local int mype = procmype;
+int numdomains = 1;
+
+
+namespace {
+
+// state shared by in-process domains:  a barrier, and a slot per
+// domain for an address that the others may read
+std::mutex domlock;
+std::condition_variable domcond;
+int domwaiting = 0;
+long domgen = 0;
+std::vector<const void*> domaddr;
+
+// wait until all domains get here
+void domainBarrier() {
+    std::unique_lock<std::mutex> lk(domlock);
+    const long gen = domgen;
+    domwaiting += 1;
+    if (domwaiting == numdomains) {
+        domwaiting = 0;
+        domgen += 1;
+        domcond.notify_all();
+        return;
+    }
+    while (domgen == gen)
+        domcond.wait(lk);
+}
+
+// publish address x for this domain; the other domains may read
+// it from domaddr until all have called endShare()
+void beginShare(const void* x) {
+    domaddr[mype] = x;
+    domainBarrier();
+}
+
+void endShare() {
+    domainBarrier();
+}
+
+// combine x over all domains, in PE order, so that every domain
+// gets the same result
+template <typename T, typename Op>
+void reduceDomains(T& x, const Op& op) {
+    beginShare(&x);
+    T y = *static_cast<const T*>(domaddr[0]);
+    for (int pe = 1; pe < numpe; ++pe)
+        y = op(y, *static_cast<const T*>(domaddr[pe]));
+    endShare();
+    x = y;
+}
+
+// the smaller value of a and b, or the one from the lower PE for
+// equal values, as MPI_MINLOC does
+MinLoc minLoc(const MinLoc& a, const MinLoc& b) {
+    if (b.x < a.x || (b.x == a.x && b.pe < a.pe)) return b;
+    return a;
+}
+
+}  // namespace
+
+
+#ifdef USE_MPI
+namespace {
+
+// MPI type and operation for MinLoc, and the reduction in progress
+MPI_Datatype minloctype = MPI_DATATYPE_NULL;
+MPI_Op minlocop = MPI_OP_NULL;
+MPI_Request minlocreq = MPI_REQUEST_NULL;
+
+// the PEs on this node
+MPI_Comm nodecomm = MPI_COMM_NULL;
+
+void minLocOp(void* invec, void* inoutvec, int* len, MPI_Datatype*) {
+    const MinLoc* in = static_cast<const MinLoc*>(invec);
+    MinLoc* inout = static_cast<MinLoc*>(inoutvec);
+    for (int i = 0; i < *len; ++i)
+        inout[i] = minLoc(inout[i], in[i]);
+}
+
+void initMinLoc() {
+    if (minloctype != MPI_DATATYPE_NULL) return;
+    int lens[3] = { 1, 1, 2 };
+    MPI_Aint disps[3] = { offsetof(MinLoc, x), offsetof(MinLoc, pe),
+            offsetof(MinLoc, info) };
+    MPI_Datatype types[3] = { MPI_DOUBLE, MPI_INT, MPI_INT };
+    MPI_Datatype t;
+    MPI_Type_create_struct(3, lens, disps, types, &t);
+    MPI_Type_create_resized(t, 0, sizeof(MinLoc), &minloctype);
+    MPI_Type_free(&t);
+    MPI_Type_commit(&minloctype);
+    MPI_Op_create(&minLocOp, 1, &minlocop);
+}
+
+}  // namespace
 #endif
 
 
 void init() {
 #ifdef USE_MPI
-    MPI_Init(0, 0);
-    MPI_Comm_size(MPI_COMM_WORLD, &numpe);
-    MPI_Comm_rank(MPI_COMM_WORLD, &mype);
+    // MPI calls are made by one thread at a time, but some of
+    // them are inside OpenMP parallel regions or tasks
+    int provided;
+    MPI_Init_thread(0, 0, MPI_THREAD_SERIALIZED, &provided);
+    MPI_Comm_size(MPI_COMM_WORLD, &procnumpe);
+    MPI_Comm_rank(MPI_COMM_WORLD, &procmype);
+    numpe = procnumpe;
+    mype = procmype;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, mype,
+            MPI_INFO_NULL, &nodecomm);
+
+    // name each node by its lowest PE, then number the names
+    int leader = mype;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, nodecomm);
+    procnode.resize(numpe);
+    MPI_Allgather(&leader, 1, MPI_INT, &procnode[0], 1, MPI_INT,
+            MPI_COMM_WORLD);
+    std::vector<int> leaders(procnode);
+    std::sort(leaders.begin(), leaders.end());
+    leaders.erase(std::unique(leaders.begin(), leaders.end()),
+            leaders.end());
+    procnumnode = leaders.size();
+    for (int pe = 0; pe < numpe; ++pe)
+        procnode[pe] = std::lower_bound(leaders.begin(), leaders.end(),
+                procnode[pe]) - leaders.begin();
 #endif
+
+    const char* s = getenv("PENNANT_PES_PER_NODE");
+    if (s != NULL) envpernode = std::max(atoi(s), 0);
 }  // init
 
 
 void final() {
 #ifdef USE_MPI
+    if (minloctype != MPI_DATATYPE_NULL) {
+        MPI_Op_free(&minlocop);
+        MPI_Type_free(&minloctype);
+    }
+    MPI_Comm_free(&nodecomm);
     MPI_Finalize();
 #endif
 }  // final
 
 
+#ifdef USE_MPI
+MPI_Comm nodeComm() {
+    return nodecomm;
+}
+#endif
+
+
+int numNodes() {
+    if (envpernode > 0) return (numpe + envpernode - 1) / envpernode;
+    // in-process domains are all on this process's node
+    if (numdomains > 1) return 1;
+    return procnumnode;
+}
+
+
+int nodeOf(const int pe) {
+    if (envpernode > 0) return pe / envpernode;
+    if (numdomains > 1) return 0;
+    return procnode[pe];
+}
+
+
+void runDomains(const int n, const std::function<void()>& body) {
+    if (n < 1) {
+        if (mype == 0)
+            std::cerr << "Error:  domains must be at least 1" << std::endl;
+        exit(1);
+    }
+    if (n == 1) {
+        body();
+        return;
+    }
+    // domains only talk to each other, so they can't be combined
+    // with MPI PEs
+    if (procnumpe > 1) {
+        if (mype == 0)
+            std::cerr << "Error:  domains requires a single MPI PE"
+                      << std::endl;
+        exit(1);
+    }
+
+    numdomains = n;
+    domaddr.resize(n);
+    std::vector<std::thread> threads;
+    for (int d = 0; d < n; ++d) {
+        threads.push_back(std::thread([&body, n, d]() {
+            numpe = n;
+            mype = d;
+#ifdef _OPENMP
+            // the domain's thread does all of its work
+            omp_set_num_threads(1);
+#endif
+            body();
+        }));
+    }
+    for (int d = 0; d < n; ++d)
+        threads[d].join();
+}
+
+
+void shareAddress(void* x, void** y) {
+    beginShare(x);
+    for (int pe = 0; pe < numpe; ++pe)
+        y[pe] = const_cast<void*>(domaddr[pe]);
+    endShare();
+}
+
+
 void globalMinLoc(double& x, int& xpe) {
     if (numpe == 1) {
         xpe = 0;
         return;
     }
+    if (numdomains > 1) {
+        MinLoc m;
+        m.x = x;
+        globalMinLoc(m);
+        x = m.x;
+        xpe = m.pe;
+        return;
+    }
 #ifdef USE_MPI
     struct doubleInt {
         double d;
@@ -69,8 +294,51 @@ void globalMinLoc(double& x, int& xpe) {
 }
 
 
+void globalMinLoc(MinLoc& m) {
+    m.pe = mype;
+    if (numpe == 1) return;
+    if (numdomains > 1) {
+        reduceDomains(m, minLoc);
+        return;
+    }
+#ifdef USE_MPI
+    initMinLoc();
+    MPI_Allreduce(MPI_IN_PLACE, &m, 1, minloctype, minlocop,
+            MPI_COMM_WORLD);
+#endif
+}
+
+
+void startGlobalMinLoc(MinLoc& m) {
+    m.pe = mype;
+    if (numpe == 1) return;
+    // domains don't have a nonblocking reduction, so do it now
+    if (numdomains > 1) {
+        reduceDomains(m, minLoc);
+        return;
+    }
+#ifdef USE_MPI
+    initMinLoc();
+    MPI_Iallreduce(MPI_IN_PLACE, &m, 1, minloctype, minlocop,
+            MPI_COMM_WORLD, &minlocreq);
+#endif
+}
+
+
+void finishGlobalMinLoc() {
+#ifdef USE_MPI
+    if (minlocreq != MPI_REQUEST_NULL)
+        MPI_Wait(&minlocreq, MPI_STATUS_IGNORE);
+#endif
+}
+
+
 void globalSum(int& x) {
     if (numpe == 1) return;
+    if (numdomains > 1) {
+        reduceDomains(x, std::plus<int>());
+        return;
+    }
 #ifdef USE_MPI
     int y;
     MPI_Allreduce(&x, &y, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
@@ -81,6 +349,10 @@ void globalSum(int& x) {
 
 void globalSum(int64_t& x) {
     if (numpe == 1) return;
+    if (numdomains > 1) {
+        reduceDomains(x, std::plus<int64_t>());
+        return;
+    }
 #ifdef USE_MPI
     int64_t y;
     MPI_Allreduce(&x, &y, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
@@ -91,6 +363,10 @@ void globalSum(int64_t& x) {
 
 void globalSum(double& x) {
     if (numpe == 1) return;
+    if (numdomains > 1) {
+        reduceDomains(x, std::plus<double>());
+        return;
+    }
 #ifdef USE_MPI
     double y;
     MPI_Allreduce(&x, &y, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
@@ -99,11 +375,67 @@ void globalSum(double& x) {
 }
 
 
+void globalMax(int& x) {
+    if (numpe == 1) return;
+    if (numdomains > 1) {
+        reduceDomains(x, [](const int a, const int b) {
+            return std::max(a, b);
+        });
+        return;
+    }
+#ifdef USE_MPI
+    int y;
+    MPI_Allreduce(&x, &y, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    x = y;
+#endif
+}
+
+
+void globalMax(double& x) {
+    if (numpe == 1) return;
+    if (numdomains > 1) {
+        reduceDomains(x, [](const double a, const double b) {
+            return std::max(a, b);
+        });
+        return;
+    }
+#ifdef USE_MPI
+    double y;
+    MPI_Allreduce(&x, &y, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    x = y;
+#endif
+}
+
+
+void broadcast(int* x, const int n) {
+    if (numpe == 1) return;
+    if (numdomains > 1) {
+        beginShare(x);
+        const int* x0 = static_cast<const int*>(domaddr[0]);
+        if (mype > 0) std::copy(x0, x0 + n, x);
+        endShare();
+        return;
+    }
+#ifdef USE_MPI
+    MPI_Bcast(x, n, MPI_INT, 0, MPI_COMM_WORLD);
+#endif
+}
+
+
 void gather(int x, int* y) {
     if (numpe == 1) {
         y[0] = x;
         return;
     }
+    if (numdomains > 1) {
+        beginShare(&x);
+        if (mype == 0) {
+            for (int pe = 0; pe < numpe; ++pe)
+                y[pe] = *static_cast<const int*>(domaddr[pe]);
+        }
+        endShare();
+        return;
+    }
 #ifdef USE_MPI
     MPI_Gather(&x, 1, MPI_INT, y, 1, MPI_INT, 0, MPI_COMM_WORLD);
 #endif
@@ -115,6 +447,12 @@ void scatter(const int* x, int& y) {
         y = x[0];
         return;
     }
+    if (numdomains > 1) {
+        beginShare(x);
+        y = static_cast<const int*>(domaddr[0])[mype];
+        endShare();
+        return;
+    }
 #ifdef USE_MPI
     MPI_Scatter((void*) x, 1, MPI_INT, &y, 1, MPI_INT, 0, MPI_COMM_WORLD);
 #endif
@@ -130,6 +468,18 @@ void gathervImpl(
         std::copy(x, x + numx, y);
         return;
     }
+    if (numdomains > 1) {
+        beginShare(x);
+        if (mype == 0) {
+            T* yp = y;
+            for (int pe = 0; pe < numpe; ++pe) {
+                const T* xpe = static_cast<const T*>(domaddr[pe]);
+                yp = std::copy(xpe, xpe + numy[pe], yp);
+            }
+        }
+        endShare();
+        return;
+    }
 #ifdef USE_MPI
     const int type_size = sizeof(T);
     int sendcount = type_size * numx;
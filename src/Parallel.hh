@@ -14,6 +14,7 @@
 #define PARALLEL_HH_
 
 #include <stdint.h>
+#include <functional>
 
 #ifdef USE_MPI
 #include "mpi.h"
@@ -23,22 +24,77 @@
 // Namespace Parallel provides helper functions and variables for
 // running in distributed parallel mode using MPI, or for stubbing
 // these out if not using MPI.
+//
+// A process may also run several PEs itself, as in-process domains
+// (see runDomains):  each domain is a PE with its own thread, and
+// the functions below then communicate through shared memory
+// instead of MPI.  numpe and mype are per thread, so that each
+// domain sees its own values.
 
 namespace Parallel {
-    extern int numpe;           // number of MPI PEs in use
-                                // (1 if not using MPI)
-    extern int mype;            // PE number for my rank
-                                // (0 if not using MPI)
+    extern thread_local int numpe;
+                                // number of PEs in use (1 if not
+                                // using MPI or domains)
+    extern thread_local int mype;
+                                // PE number for my rank or domain
+                                // (0 if not using MPI or domains)
+    extern int numdomains;      // number of in-process domains
+                                // (1 if not using them)
 
     void init();                // initialize MPI
     void final();               // finalize MPI
+#ifdef USE_MPI
+    MPI_Comm nodeComm();        // communicator of the PEs on my
+                                // node, which can share memory
+#endif
+    int numNodes();             // number of nodes the PEs are on
+    int nodeOf(const int pe);   // node number of a PE; nodes are
+                                // numbered in order of their
+                                // lowest PEs.  Both may be set by
+                                // PENNANT_PES_PER_NODE (PE pe is
+                                // then on node pe / the value)
+                                // instead of by the MPI layout.
+
+    void runDomains(const int n, const std::function<void()>& body);
+                                // run body() once on each of n
+                                // in-process domains, each on its
+                                // own thread, and wait for them;
+                                // with n == 1, just call body()
+    void shareAddress(void* x, void** y);
+                                // for in-process domains:  put the
+                                // address x from each PE in y[pe],
+                                // on all PEs
 
     void globalMinLoc(double& x, int& xpe);
                                 // find minimum over all PEs, and
                                 // report which PE had the minimum
+
+    // a minimum over all PEs, with the PE that had it (the lowest
+    // one, on a tie) and two ints of information from that PE, so
+    // that one reduction also tells why it is the minimum
+    struct MinLoc {
+        double x;
+        int pe;
+        int info[2];
+    };
+    void globalMinLoc(MinLoc& m);
+                                // find minimum over all PEs; sets
+                                // m.pe to mype first
+    void startGlobalMinLoc(MinLoc& m);
+                                // nonblocking version:  start the
+                                // reduction, then the result is in
+                                // m after finishGlobalMinLoc (m must
+                                // not be used in between)
+    void finishGlobalMinLoc();
+
     void globalSum(int& x);     // find sum over all PEs - overloaded
     void globalSum(int64_t& x);
     void globalSum(double& x);
+    void globalMax(int& x);     // find maximum over all PEs
+    void globalMax(double& x);  //   - overloaded
+    void broadcast(int* x, const int n);
+                                // copy list of ints from PE 0
+                                // to all PEs
     void gather(const int x, int* y);
                                 // gather list of ints from all PEs
     void scatter(const int* x, int& y);
@@ -16,6 +16,7 @@
 #include "InputFile.hh"
 #include "Hydro.hh"
 #include "Mesh.hh"
+#include "Simd.hh"
 
 using namespace std;
 
@@ -40,7 +41,8 @@ void PolyGas::calcStateAtHalf(
         const int zfirst,
         const int zlast) {
 
-    double* z0per = Memory::alloc<double>(zlast - zfirst);
+    Memory::ArenaScope scratch;
+    double* z0per = scratch.alloc<double>(zlast - zfirst);
 
     const double dth = 0.5 * dt;
 
@@ -48,8 +50,25 @@ void PolyGas::calcStateAtHalf(
     calcEOS(zr0, ze, zp, z0per, zss, zfirst, zlast);
 
     // now advance pressure to the half-step
+    using namespace Simd;
+    const int zvlast = zlast - (zlast - zfirst) % width;
+    const vdouble vone = set1(1.), vhalf = set1(0.5), vdth = set1(dth);
+    for (int z = zfirst; z < zvlast; z += width) {
+        int z0 = z - zfirst;
+        vdouble vzr0 = load(&zr0[z]);
+        vdouble vzss = load(&zss[z]);
+        vdouble vz0per = load(&z0per[z0]);
+        vdouble zminv = vone / load(&zm[z]);
+        vdouble dv = (load(&zvolp[z]) - load(&zvol0[z])) * zminv;
+        vdouble bulk = vzr0 * vzss * vzss;
+        vdouble denom = vone + vhalf * vz0per * dv;
+        vdouble src = load(&zwrate[z]) * vdth * zminv;
+        store(&zp[z], load(&zp[z]) +
+                (vz0per * src - vzr0 * bulk * dv) / denom);
+    }
+
     #pragma ivdep
-    for (int z = zfirst; z < zlast; ++z) {
+    for (int z = zvlast; z < zlast; ++z) {
         int z0 = z - zfirst;
         double zminv = 1. / zm[z];
         double dv = (zvolp[z] - zvol0[z]) * zminv;
@@ -58,8 +77,6 @@ void PolyGas::calcStateAtHalf(
         double src = zwrate[z] * dth * zminv;
         zp[z] += (z0per[z0] * src - zr0[z] * bulk * dv) / denom;
     }
-
-    Memory::free(z0per);
 }
 
 
@@ -75,8 +92,24 @@ void PolyGas::calcEOS(
     const double gm1 = gamma - 1.;
     const double ss2 = max(ssmin * ssmin, 1.e-99);
 
+    using namespace Simd;
+    const int zvlast = zlast - (zlast - zfirst) % width;
+    const vdouble vgm1 = set1(gm1), vss2 = set1(ss2), vzero = set1(0.);
+    for (int z = zfirst; z < zvlast; z += width) {
+        int z0 = z - zfirst;
+        vdouble rx = load(&zr[z]);
+        vdouble ex = max(load(&ze[z]), vzero);
+        vdouble px = vgm1 * rx * ex;
+        vdouble prex = vgm1 * ex;
+        vdouble perx = vgm1 * rx;
+        vdouble csqd = max(vss2, prex + perx * px / (rx * rx));
+        store(&zp[z], px);
+        store(&z0per[z0], perx);
+        store(&zss[z], Simd::sqrt(csqd));
+    }
+
     #pragma ivdep
-    for (int z = zfirst; z < zlast; ++z) {
+    for (int z = zvlast; z < zlast; ++z) {
         int z0 = z - zfirst;
         double rx = zr[z];
         double ex = max(ze[z], 0.0);
@@ -94,15 +127,42 @@ void PolyGas::calcEOS(
 
 void PolyGas::calcForce(
         const double* zp,
-        const double2* ssurfp,
-        double2* sf,
+        double2cptr ssurfp,
+        double2ptr sf,
         const int sfirst,
         const int slast) {
 
     const Mesh* mesh = hydro->mesh;
+    if (mesh->structured) {
+        calcForceBatch<Mesh::rect>(zp, ssurfp, sf, sfirst, slast);
+        return;
+    }
+    if (mesh->numbat > 0) {
+        for (int b = 0; b < mesh->numbat; ++b) {
+            int bf = max(sfirst, mesh->batsfirst[b]);
+            int bl = min(slast, mesh->batslast[b]);
+            if (bf >= bl) continue;
+            switch (mesh->batnump[b]) {
+            case 3:  calcForceBatch<3>(zp, ssurfp, sf, bf, bl); break;
+            case 4:  calcForceBatch<4>(zp, ssurfp, sf, bf, bl); break;
+            case 6:  calcForceBatch<6>(zp, ssurfp, sf, bf, bl); break;
+            default: calcForceBatch<0>(zp, ssurfp, sf, bf, bl); break;
+            }
+        }
+        return;
+    }
+
+    using namespace Simd;
+    const int svlast = slast - (slast - sfirst) % width;
+    for (int s = sfirst; s < svlast; s += width) {
+        vdouble r = -gather(zp, &mesh->mapsz[s]);
+        vdouble sx, sy;
+        load2(ssurfp, s, sx, sy);
+        store2(sf, s, sx * r, sy * r);
+    }
 
     #pragma ivdep
-    for (int s = sfirst; s < slast; ++s) {
+    for (int s = svlast; s < slast; ++s) {
         int z = mesh->mapsz[s];
         double2 sfx = -zp[z] * ssurfp[s];
         sf[s] = sfx;
@@ -111,5 +171,25 @@ void PolyGas::calcForce(
 }
 
 
+template <int N>
+void PolyGas::calcForceBatch(
+        const double* zp,
+        double2cptr ssurfp,
+        double2ptr sf,
+        const int sfirst,
+        const int slast) {
 
+    const Mesh* mesh = hydro->mesh;
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+        const double r = -zp[z];
+
+        for (int i = 0; i < n; ++i)
+            sf[s1 + i] = r * ssurfp[s1 + i];
+        s1 += n;
+    }
+}
 
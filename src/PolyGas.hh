@@ -13,7 +13,7 @@
 #ifndef POLYGAS_HH_
 #define POLYGAS_HH_
 
-#include "Vec2.hh"
+#include "Vec2Ptr.hh"
 
 // forward declarations
 class InputFile;
@@ -56,8 +56,18 @@ public:
 
     void calcForce(
             const double* zp,
-            const double2* ssurfp,
-            double2* sf,
+            double2cptr ssurfp,
+            double2ptr sf,
+            const int sfirst,
+            const int slast);
+
+    // calcForce for a range of sides within one zone batch, or
+    // on a structured mesh (N = Mesh::rect)
+    template <int N>
+    void calcForceBatch(
+            const double* zp,
+            double2cptr ssurfp,
+            double2ptr sf,
             const int sfirst,
             const int slast);
 
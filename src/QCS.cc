@@ -13,6 +13,7 @@
 #include "QCS.hh"
 
 #include <cmath>
+#include <algorithm>
 #include "Memory.hh"
 #include "InputFile.hh"
 #include "Vec2.hh"
@@ -26,6 +27,7 @@ QCS::QCS(const InputFile* inp, Hydro* h) : hydro(h) {
     qgamma = inp->getDouble("qgamma", 5. / 3.);
     q1 = inp->getDouble("q1", 0.);
     q2 = inp->getDouble("q2", 2.);
+    fused = inp->getInt("fuseqcs", 0);
 
 }
 
@@ -33,19 +35,55 @@ QCS::~QCS() {}
 
 
 void QCS::calcForce(
-        double2* sf,
+        double2ptr sf,
         const int sfirst,
         const int slast) {
+
+    const Mesh* mesh = hydro->mesh;
+    if (mesh->structured) {
+        calcForceBatch<Mesh::rect>(sf, sfirst, slast);
+        return;
+    }
+    if (mesh->numbat == 0) {
+        calcForceBatch<0>(sf, sfirst, slast);
+        return;
+    }
+
+    for (int b = 0; b < mesh->numbat; ++b) {
+        int bf = max(sfirst, mesh->batsfirst[b]);
+        int bl = min(slast, mesh->batslast[b]);
+        if (bf >= bl) continue;
+        switch (mesh->batnump[b]) {
+        case 3:  calcForceBatch<3>(sf, bf, bl); break;
+        case 4:  calcForceBatch<4>(sf, bf, bl); break;
+        case 6:  calcForceBatch<6>(sf, bf, bl); break;
+        default: calcForceBatch<0>(sf, bf, bl); break;
+        }
+    }
+}
+
+
+template <int N>
+void QCS::calcForceBatch(
+        double2ptr sf,
+        const int sfirst,
+        const int slast) {
+    if (fused) {
+        calcForceFusedBatch<N>(sf, sfirst, slast);
+        return;
+    }
+
     int cfirst = sfirst;
     int clast = slast;
 
     // declare temporary variables
-    double* c0area = Memory::alloc<double>(clast - cfirst);
-    double* c0evol = Memory::alloc<double>(clast - cfirst);
-    double* c0du = Memory::alloc<double>(clast - cfirst);
-    double* c0div = Memory::alloc<double>(clast - cfirst);
-    double* c0cos = Memory::alloc<double>(clast - cfirst);
-    double2* c0qe = Memory::alloc<double2>(2 * (clast - cfirst));
+    Memory::ArenaScope scratch;
+    double* c0area = scratch.alloc<double>(clast - cfirst);
+    double* c0evol = scratch.alloc<double>(clast - cfirst);
+    double* c0du = scratch.alloc<double>(clast - cfirst);
+    double* c0div = scratch.alloc<double>(clast - cfirst);
+    double* c0cos = scratch.alloc<double>(clast - cfirst);
+    double2* c0qe = scratch.alloc<double2>(2 * (clast - cfirst));
 
     // [1] Find the right, left, top, bottom  edges to use for the
     //     limiters
@@ -56,7 +94,7 @@ void QCS::calcForce(
     // [2.2] Compute the cos angle for c
     // [2.3] Find the evolution factor c0evol(c) and the Delta u(c) = du(c)
     // [2.4] Find the weights c0w(c)
-    setCornerDiv(c0area, c0div, c0evol, c0du, c0cos, sfirst, slast);
+    setCornerDiv<N>(c0area, c0div, c0evol, c0du, c0cos, sfirst, slast);
 
     // [3] Find the limiters Psi(c)
     // *** NOT IMPLEMENTED IN PENNANT ***
@@ -67,20 +105,181 @@ void QCS::calcForce(
     //       e1=[n0,n1], e2=[n1,n2]
     //       c0qe(2,c) = cmu(c).( u(n2)-u(n1) ) / l_{n1->n2}
     //       c0qe(1,c) = cmu(c).( u(n1)-u(n0) ) / l_{n0->n1}
-    setQCnForce(c0div, c0du, c0evol, c0qe, sfirst, slast);
+    setQCnForce<N>(c0div, c0du, c0evol, c0qe, sfirst, slast);
 
     // [5] Compute the Q forces
-    setForce(c0area, c0qe, c0cos, sf, sfirst, slast);
+    setForce<N>(c0area, c0qe, c0cos, sf, sfirst, slast);
 
     // [6] Set velocity difference to use to compute timestep
-    setVelDiff(sfirst, slast);
-
-    Memory::free(c0area);
-    Memory::free(c0evol);
-    Memory::free(c0du);
-    Memory::free(c0div);
-    Memory::free(c0cos);
-    Memory::free(c0qe);
+    setVelDiff<N>(sfirst, slast);
+}
+
+
+template <int N>
+void QCS::calcForceFusedBatch(
+        double2ptr sf,
+        const int sfirst,
+        const int slast) {
+
+    // this is the same arithmetic as the separate routines below,
+    // in the same order, so results are identical; see them for
+    // the details of each step
+
+    const Mesh* mesh = hydro->mesh;
+
+    double2cptr pu = hydro->pu;
+    double2cptr px = mesh->pxp;
+    double2cptr ex = mesh->exp;
+    double2cptr zx = mesh->zxp;
+    const double* elen = mesh->elen;
+    const double* zrp = hydro->zrp;
+    const double* zss = hydro->zss;
+    double* zdu = hydro->zdu;
+
+    const double gammap1 = qgamma + 1.0;
+
+    // values for the current zone:  velocity and position of its
+    // points, center and length of its edges (point i and edge i
+    // are the first point and the edge of side i), and for its
+    // corners, weight, cos angle, and Q vectors on the two edges.
+    // Each point and edge value is loaded once here, instead of
+    // once per step.  The arrays are sized for the largest zone
+    // expected; a generic range with a bigger zone switches to
+    // arrays from the scratch arena.
+    const int maxn = (N > 0 ? N : (N == Mesh::rect ? 4 : 8));
+    double2 upbuf[maxn], xpbuf[maxn], xebuf[maxn];
+    double lebuf[maxn], wbuf[maxn], cosbuf[maxn];
+    double2 qebuf[2 * maxn];
+    double2* zup = upbuf;
+    double2* zxp = xpbuf;
+    double2* zxe = xebuf;
+    double* zle = lebuf;
+    double* c0w = wbuf;
+    double* c0cos = cosbuf;
+    double2* c0qe = qebuf;
+    int cap = maxn;
+    Memory::ArenaScope scratch;
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+        if (n > cap) {
+            zup = scratch.alloc<double2>(n);
+            zxp = scratch.alloc<double2>(n);
+            zxe = scratch.alloc<double2>(n);
+            zle = scratch.alloc<double>(n);
+            c0w = scratch.alloc<double>(n);
+            c0cos = scratch.alloc<double>(n);
+            c0qe = scratch.alloc<double2>(2 * n);
+            cap = n;
+        }
+
+        // [2.1] Zone-centered velocity
+        double2 zuc(0., 0.);
+        for (int i = 0; i < n; ++i) {
+            int p = mesh->sidePoint1<N>(s1, z, i);
+            int e = mesh->sideEdge<N>(s1, z, i);
+            zup[i] = pu[p];
+            zxp[i] = px[p];
+            zxe[i] = ex[e];
+            zle[i] = elen[e];
+            zuc += zup[i];
+        }
+        zuc /= (double) n;
+
+        const double2 zxz = zx[z];
+        const double ztmp1 = q1 * zss[z];
+        const double zr = zrp[z];
+
+        for (int i = 0; i < n; ++i) {
+            // corner i is at point i, between edges i3 and i
+            int i3 = (i == 0 ? n - 1 : i - 1);
+            int i2 = (i + 1 == n ? 0 : i + 1);
+
+            // [2] Corner divergence and related quantities
+            double2 up0 = zup[i];
+            double2 xp0 = zxp[i];
+            double2 up1 = 0.5 * (zup[i] + zup[i2]);
+            double2 xp1 = zxe[i];
+            double2 up2 = zuc;
+            double2 xp2 = zxz;
+            double2 up3 = 0.5 * (zup[i3] + zup[i]);
+            double2 xp3 = zxe[i3];
+
+            double cvolume = 0.5 * cross(xp2 - xp0, xp3 - xp1);
+
+            double2 v1 = xp3 - xp0;
+            double2 v2 = xp1 - xp0;
+            double de1 = zle[i3];
+            double de2 = zle[i];
+            double minelen = min(de1, de2);
+            double ccos = ((minelen < 1.e-12) ?
+                    0. :
+                    4. * dot(v1, v2) / (de1 * de2));
+
+            double cdiv = (cross(up2 - up0, xp3 - xp1) -
+                    cross(up3 - up1, xp2 - xp0)) /
+                    (2.0 * cvolume);
+
+            double2 dxx1 = 0.5 * (xp1 + xp2 - xp0 - xp3);
+            double2 dxx2 = 0.5 * (xp2 + xp3 - xp0 - xp1);
+            double dx1 = length(dxx1);
+            double dx2 = length(dxx2);
+
+            double2 duav = 0.25 * (up0 + up1 + up2 + up3);
+
+            double test1 = abs(dot(dxx1, duav) * dx2);
+            double test2 = abs(dot(dxx2, duav) * dx1);
+            double num = (test1 > test2 ? dx1 : dx2);
+            double den = (test1 > test2 ? dx2 : dx1);
+            double r = num / den;
+            double evol = sqrt(4.0 * cvolume * r);
+            evol = min(evol, 2.0 * minelen);
+
+            double dv1 = length2(up1 + up2 - up0 - up3);
+            double dv2 = length2(up2 + up3 - up0 - up1);
+            double du = sqrt(max(dv1, dv2));
+
+            double cevol = (cdiv < 0.0 ? evol : 0.);
+            double cdu   = (cdiv < 0.0 ? du   : 0.);
+
+            // [4] Q vectors on the corner's edges
+            double ztmp2 = q2 * 0.25 * gammap1 * cdu;
+            double zkur = ztmp2 + sqrt(ztmp2 * ztmp2 + ztmp1 * ztmp1);
+            double rmu = zkur * zr * cevol;
+            rmu = ((cdiv > 0.0) ? 0. : rmu);
+
+            c0qe[2 * i]     = rmu * (zup[i] - zup[i3]) / de1;
+            c0qe[2 * i + 1] = rmu * (zup[i2] - zup[i]) / de2;
+
+            // [5.1] Corner weights
+            double csin2 = 1.0 - ccos * ccos;
+            c0w[i]   = ((csin2 < 1.e-4) ? 0. : cvolume / csin2);
+            c0cos[i] = ((csin2 < 1.e-4) ? 0. : ccos);
+        }  // for i
+
+        // [5.2] Forces on sides, and [6] velocity difference
+        double ztmp = 0.;
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            int i2 = (i + 1 == n ? 0 : i + 1);
+            double el = zle[i];
+
+            sf[s] = (c0w[i] * (c0qe[2*i+1] + c0cos[i] * c0qe[2*i]) +
+                     c0w[i2] * (c0qe[2*i2] + c0cos[i2] * c0qe[2*i2+1]))
+                / el;
+
+            double2 dx = zxp[i2] - zxp[i];
+            double2 du = zup[i2] - zup[i];
+            double dux = dot(du, dx);
+            dux = (el > 0. ? abs(dux) / el : 0.);
+            ztmp = max(ztmp, dux);
+        }  // for i
+
+        zdu[z] = q1 * zss[z] + 2. * q2 * ztmp;
+        s1 += n;
+    }  // while s1
 }
 
 
@@ -89,6 +288,7 @@ void QCS::calcForce(
 //     [2.2] Compute the cos angle for c
 //     [2.3] Find the evolution factor c0evol(c)
 //           and the Delta u(c) = du(c)
+template <int N>
 void QCS::setCornerDiv(
             double* c0area,
             double* c0div,
@@ -99,120 +299,112 @@ void QCS::setCornerDiv(
             const int slast) {
 
     const Mesh* mesh = hydro->mesh;
-    const int nums = mesh->nums;
-    const int numz = mesh->numz;
 
-    const double2* pu = hydro->pu;
-    const double2* px = mesh->pxp;
-    const double2* ex = mesh->exp;
-    const double2* zx = mesh->zxp;
+    double2cptr pu = hydro->pu;
+    double2cptr px = mesh->pxp;
+    double2cptr ex = mesh->exp;
+    double2cptr zx = mesh->zxp;
     const double* elen = mesh->elen;
-    const int* znump = mesh->znump;
 
     int cfirst = sfirst;
-    int clast = slast;
-    int zfirst = mesh->mapsz[sfirst];
-    int zlast = (slast < nums ? mesh->mapsz[slast] : numz);
-
-    double2* z0uc = Memory::alloc<double2>(zlast - zfirst);
     double2 up0, up1, up2, up3;
     double2 xp0, xp1, xp2, xp3;
 
-    // [1] Compute a zone-centered velocity
-    fill(&z0uc[0], &z0uc[zlast-zfirst], double2(0., 0.));
-    for (int c = cfirst; c < clast; ++c) {
-        int p = mesh->mapsp1[c];
-        int z = mesh->mapsz[c];
-        int z0 = z - zfirst;
-        z0uc[z0] += pu[p];
-    }
-
-    for (int z = zfirst; z < zlast; ++z) {
-        int z0 = z - zfirst;
-        z0uc[z0] /= (double) znump[z];
-    }
-
-    // [2] Divergence at the corner
-    #pragma ivdep
-    for (int c = cfirst; c < clast; ++c) {
-        int s2 = c;
-        int s = mesh->mapss3[s2];
-        // Associated zone, corner, point
-        int z = mesh->mapsz[s];
-        int z0 = z - zfirst;
-        int c0 = c - cfirst;
-        int p = mesh->mapsp2[s];
-        // Points
-        int p1 = mesh->mapsp1[s];
-        int p2 = mesh->mapsp2[s2];
-        // Edges
-        int e1 = mesh->mapse[s];
-        int e2 = mesh->mapse[s2];
-
-        // Velocities and positions
-        // 0 = point p
-        up0 = pu[p];
-        xp0 = px[p];
-        // 1 = edge e2
-        up1 = 0.5 * (pu[p] + pu[p2]);
-        xp1 = ex[e2];
-        // 2 = zone center z
-        up2 = z0uc[z0];
-        xp2 = zx[z];
-        // 3 = edge e1
-        up3 = 0.5 * (pu[p1] + pu[p]);
-        xp3 = ex[e1];
-
-        // compute 2d cartesian volume of corner
-        double cvolume = 0.5 * cross(xp2 - xp0, xp3 - xp1);
-        c0area[c0] = cvolume;
-
-        // compute cosine angle
-        double2 v1 = xp3 - xp0;
-        double2 v2 = xp1 - xp0;
-        double de1 = elen[e1];
-        double de2 = elen[e2];
-        double minelen = min(de1, de2);
-        c0cos[c0] = ((minelen < 1.e-12) ?
-                0. :
-                4. * dot(v1, v2) / (de1 * de2));
-
-        // compute divergence of corner
-        c0div[c0] = (cross(up2 - up0, xp3 - xp1) -
-                cross(up3 - up1, xp2 - xp0)) /
-                (2.0 * cvolume);
-
-        // compute evolution factor
-        double2 dxx1 = 0.5 * (xp1 + xp2 - xp0 - xp3);
-        double2 dxx2 = 0.5 * (xp2 + xp3 - xp0 - xp1);
-        double dx1 = length(dxx1);
-        double dx2 = length(dxx2);
-
-        // average corner-centered velocity
-        double2 duav = 0.25 * (up0 + up1 + up2 + up3);
-
-        double test1 = abs(dot(dxx1, duav) * dx2);
-        double test2 = abs(dot(dxx2, duav) * dx1);
-        double num = (test1 > test2 ? dx1 : dx2);
-        double den = (test1 > test2 ? dx2 : dx1);
-        double r = num / den;
-        double evol = sqrt(4.0 * cvolume * r);
-        evol = min(evol, 2.0 * minelen);
-
-        // compute delta velocity
-        double dv1 = length2(up1 + up2 - up0 - up3);
-        double dv2 = length2(up2 + up3 - up0 - up1);
-        double du = sqrt(max(dv1, dv2));
-
-        c0evol[c0] = (c0div[c0] < 0.0 ? evol : 0.);
-        c0du[c0]   = (c0div[c0] < 0.0 ? du   : 0.);
-    }  // for s
-
-    Memory::free(z0uc);
+    // sides (and corners) of a zone are contiguous, so walk the
+    // range one zone at a time; the previous side in the zone is
+    // then s1 + (i - 1) mod n, without going through mapss3
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+
+        // [1] Compute a zone-centered velocity
+        double2 zuc(0., 0.);
+        for (int i = 0; i < n; ++i)
+            zuc += pu[mesh->sidePoint1<N>(s1, z, i)];
+        zuc /= (double) n;
+
+        // [2] Divergence at the corner
+        #pragma ivdep
+        for (int i = 0; i < n; ++i) {
+            int c = s1 + i;
+            int i3 = (i == 0 ? n - 1 : i - 1);
+            // Associated corner, point
+            int c0 = c - cfirst;
+            int p = mesh->sidePoint2<N>(s1, z, i3);
+            // Points
+            int p1 = mesh->sidePoint1<N>(s1, z, i3);
+            int p2 = mesh->sidePoint2<N>(s1, z, i);
+            // Edges
+            int e1 = mesh->sideEdge<N>(s1, z, i3);
+            int e2 = mesh->sideEdge<N>(s1, z, i);
+
+            // Velocities and positions
+            // 0 = point p
+            up0 = pu[p];
+            xp0 = px[p];
+            // 1 = edge e2
+            up1 = 0.5 * (pu[p] + pu[p2]);
+            xp1 = ex[e2];
+            // 2 = zone center z
+            up2 = zuc;
+            xp2 = zx[z];
+            // 3 = edge e1
+            up3 = 0.5 * (pu[p1] + pu[p]);
+            xp3 = ex[e1];
+
+            // compute 2d cartesian volume of corner
+            double cvolume = 0.5 * cross(xp2 - xp0, xp3 - xp1);
+            c0area[c0] = cvolume;
+
+            // compute cosine angle
+            double2 v1 = xp3 - xp0;
+            double2 v2 = xp1 - xp0;
+            double de1 = elen[e1];
+            double de2 = elen[e2];
+            double minelen = min(de1, de2);
+            c0cos[c0] = ((minelen < 1.e-12) ?
+                    0. :
+                    4. * dot(v1, v2) / (de1 * de2));
+
+            // compute divergence of corner
+            c0div[c0] = (cross(up2 - up0, xp3 - xp1) -
+                    cross(up3 - up1, xp2 - xp0)) /
+                    (2.0 * cvolume);
+
+            // compute evolution factor
+            double2 dxx1 = 0.5 * (xp1 + xp2 - xp0 - xp3);
+            double2 dxx2 = 0.5 * (xp2 + xp3 - xp0 - xp1);
+            double dx1 = length(dxx1);
+            double dx2 = length(dxx2);
+
+            // average corner-centered velocity
+            double2 duav = 0.25 * (up0 + up1 + up2 + up3);
+
+            double test1 = abs(dot(dxx1, duav) * dx2);
+            double test2 = abs(dot(dxx2, duav) * dx1);
+            double num = (test1 > test2 ? dx1 : dx2);
+            double den = (test1 > test2 ? dx2 : dx1);
+            double r = num / den;
+            double evol = sqrt(4.0 * cvolume * r);
+            evol = min(evol, 2.0 * minelen);
+
+            // compute delta velocity
+            double dv1 = length2(up1 + up2 - up0 - up3);
+            double dv2 = length2(up2 + up3 - up0 - up1);
+            double du = sqrt(max(dv1, dv2));
+
+            c0evol[c0] = (c0div[c0] < 0.0 ? evol : 0.);
+            c0du[c0]   = (c0div[c0] < 0.0 ? du   : 0.);
+        }  // for i
+
+        s1 += n;
+    }  // while s1
 }
 
 
 // Routine number [4]  in the full algorithm CS2DQforce(...)
+template <int N>
 void QCS::setQCnForce(
         const double* c0div,
         const double* c0du,
@@ -223,65 +415,61 @@ void QCS::setQCnForce(
 
     const Mesh* mesh = hydro->mesh;
 
-    const double2* pu = hydro->pu;
+    double2cptr pu = hydro->pu;
     const double* zrp = hydro->zrp;
     const double* zss = hydro->zss;
     const double* elen = mesh->elen;
 
     int cfirst = sfirst;
-    int clast = slast;
-
-    double* c0rmu = Memory::alloc<double>(clast - cfirst);
 
     const double gammap1 = qgamma + 1.0;
 
-    // [4.1] Compute the c0rmu (real Kurapatenko viscous scalar)
-    #pragma ivdep
-    for (int c = cfirst; c < clast; ++c) {
-        int c0 = c - cfirst;
-        int z = mesh->mapsz[c];
-
-        // Kurapatenko form of the viscosity
-        double ztmp2 = q2 * 0.25 * gammap1 * c0du[c0];
-        double ztmp1 = q1 * zss[z];
-        double zkur = ztmp2 + sqrt(ztmp2 * ztmp2 + ztmp1 * ztmp1);
-        // Compute c0rmu for each corner
-        double rmu = zkur * zrp[z] * c0evol[c0];
-        c0rmu[c0] = ((c0div[c0] > 0.0) ? 0. : rmu);
-
-    } // for c
-
-    // [4.2] Compute the c0qe for each corner
-    #pragma ivdep
-    for (int c = cfirst; c < clast; ++c) {
-        int s4 = c;
-        int s = mesh->mapss3[s4];
-        int c0 = c - cfirst;
-        int p = mesh->mapsp2[s];
-        // Associated point and edge 1
-        int p1 = mesh->mapsp1[s];
-        int e1 = mesh->mapse[s];
-        // Associated point and edge 2
-        int p2 = mesh->mapsp2[s4];
-        int e2 = mesh->mapse[s4];
-
-        // Compute: c0qe(1,2,3)=edge 1, y component (2nd), 3rd corner
-        //          c0qe(2,1,3)=edge 2, x component (1st)
-        c0qe[2 * c0]     = c0rmu[c0] * (pu[p] - pu[p1]) / elen[e1];
-        c0qe[2 * c0 + 1] = c0rmu[c0] * (pu[p2] - pu[p]) / elen[e2];
-
-    } // for s
-
-    Memory::free(c0rmu);
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+
+        #pragma ivdep
+        for (int i = 0; i < n; ++i) {
+            int c = s1 + i;
+            int c0 = c - cfirst;
+
+            // [4.1] Compute the rmu (real Kurapatenko viscous scalar)
+            // Kurapatenko form of the viscosity
+            double ztmp2 = q2 * 0.25 * gammap1 * c0du[c0];
+            double ztmp1 = q1 * zss[z];
+            double zkur = ztmp2 + sqrt(ztmp2 * ztmp2 + ztmp1 * ztmp1);
+            double rmu = zkur * zrp[z] * c0evol[c0];
+            rmu = ((c0div[c0] > 0.0) ? 0. : rmu);
+
+            // [4.2] Compute the c0qe for each corner
+            int i3 = (i == 0 ? n - 1 : i - 1);
+            int p = mesh->sidePoint2<N>(s1, z, i3);
+            // Associated point and edge 1
+            int p1 = mesh->sidePoint1<N>(s1, z, i3);
+            int e1 = mesh->sideEdge<N>(s1, z, i3);
+            // Associated point and edge 2
+            int p2 = mesh->sidePoint2<N>(s1, z, i);
+            int e2 = mesh->sideEdge<N>(s1, z, i);
+
+            // Compute: c0qe(1,2,3)=edge 1, y component (2nd), 3rd corner
+            //          c0qe(2,1,3)=edge 2, x component (1st)
+            c0qe[2 * c0]     = rmu * (pu[p] - pu[p1]) / elen[e1];
+            c0qe[2 * c0 + 1] = rmu * (pu[p2] - pu[p]) / elen[e2];
+        }  // for i
+
+        s1 += n;
+    }  // while s1
 }
 
 
 // Routine number [5]  in the full algorithm CS2DQforce(...)
+template <int N>
 void QCS::setForce(
         const double* c0area,
         const double2* c0qe,
         double* c0cos,
-        double2* sfq,
+        double2ptr sfq,
         const int sfirst,
         const int slast) {
 
@@ -291,7 +479,8 @@ void QCS::setForce(
     int cfirst = sfirst;
     int clast = slast;
 
-    double* c0w = Memory::alloc<double>(clast - cfirst);
+    Memory::ArenaScope scratch;
+    double* c0w = scratch.alloc<double>(clast - cfirst);
 
     // [5.1] Preparation of extra variables
     #pragma ivdep
@@ -303,67 +492,68 @@ void QCS::setForce(
     } // for c
 
     // [5.2] Set-Up the forces on corners
-    #pragma ivdep
-    for (int s = sfirst; s < slast; ++s) {
-        // Associated corners 1 and 2, and edge
-        int c1 = s;
-        int c10 = c1 - cfirst;
-        int c2 = mesh->mapss4[s];
-        int c20 = c2 - cfirst;
-        int e = mesh->mapse[s];
-        // Edge length for c1, c2 contribution to s
-        double el = elen[e];
-
-        sfq[s] = (c0w[c10] * (c0qe[2*c10+1] + c0cos[c10] * c0qe[2*c10]) +
-                  c0w[c20] * (c0qe[2*c20] + c0cos[c20] * c0qe[2*c20+1]))
-            / el;
-
-    } // for s
-
-    Memory::free(c0w);
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+
+        #pragma ivdep
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            // Associated corners 1 and 2, and edge
+            int c1 = s;
+            int c10 = c1 - cfirst;
+            int c2 = s1 + (i + 1 == n ? 0 : i + 1);
+            int c20 = c2 - cfirst;
+            int e = mesh->sideEdge<N>(s1, z, i);
+            // Edge length for c1, c2 contribution to s
+            double el = elen[e];
+
+            sfq[s] = (c0w[c10] * (c0qe[2*c10+1] + c0cos[c10] * c0qe[2*c10]) +
+                      c0w[c20] * (c0qe[2*c20] + c0cos[c20] * c0qe[2*c20+1]))
+                / el;
+        }  // for i
+
+        s1 += n;
+    }  // while s1
 }
 
 
 // Routine number [6] in the full algorithm
+template <int N>
 void QCS::setVelDiff(
         const int sfirst,
         const int slast) {
 
     const Mesh* mesh = hydro->mesh;
-    const int nums = mesh->nums;
-    const int numz = mesh->numz;
-    int zfirst = mesh->mapsz[sfirst];
-    int zlast = (slast < nums ? mesh->mapsz[slast] : numz);
-    const double2* px = mesh->pxp;
-    const double2* pu = hydro->pu;
+    double2cptr px = mesh->pxp;
+    double2cptr pu = hydro->pu;
     const double* zss = hydro->zss;
     double* zdu = hydro->zdu;
     const double* elen = mesh->elen;
 
-    double* z0tmp = Memory::alloc<double>(zlast - zfirst);
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
 
-    fill(&z0tmp[0], &z0tmp[zlast-zfirst], 0.);
-    for (int s = sfirst; s < slast; ++s) {
-        int p1 = mesh->mapsp1[s];
-        int p2 = mesh->mapsp2[s];
-        int z = mesh->mapsz[s];
-        int e = mesh->mapse[s];
-        int z0 = z - zfirst;
+        double ztmp = 0.;
+        for (int i = 0; i < n; ++i) {
+            int p1 = mesh->sidePoint1<N>(s1, z, i);
+            int p2 = mesh->sidePoint2<N>(s1, z, i);
+            int e = mesh->sideEdge<N>(s1, z, i);
 
-        double2 dx = px[p2] - px[p1];
-        double2 du = pu[p2] - pu[p1];
-        double lenx = elen[e];
-        double dux = dot(du, dx);
-        dux = (lenx > 0. ? abs(dux) / lenx : 0.);
+            double2 dx = px[p2] - px[p1];
+            double2 du = pu[p2] - pu[p1];
+            double lenx = elen[e];
+            double dux = dot(du, dx);
+            dux = (lenx > 0. ? abs(dux) / lenx : 0.);
 
-        z0tmp[z0] = max(z0tmp[z0], dux);
-    }
+            ztmp = max(ztmp, dux);
+        }
 
-    for (int z = zfirst; z < zlast; ++z) {
-        int z0 = z - zfirst;
-        zdu[z] = q1 * zss[z] + 2. * q2 * z0tmp[z0];
+        zdu[z] = q1 * zss[z] + 2. * q2 * ztmp;
+        s1 += n;
     }
-
-    Memory::free(z0tmp);
 }
 
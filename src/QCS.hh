@@ -13,7 +13,7 @@
 #ifndef QCS_HH_
 #define QCS_HH_
 
-#include "Vec2.hh"
+#include "Vec2Ptr.hh"
 
 // forward declarations
 class InputFile;
@@ -29,15 +29,36 @@ public:
     double qgamma;                 // gamma coefficient for Q model
     double q1, q2;                 // linear and quadratic coefficients
                                    // for Q model
+    bool fused;                    // flag:  use one-pass kernel?
 
     QCS(const InputFile* inp, Hydro* h);
     ~QCS();
 
     void calcForce(
-            double2* sf,
+            double2ptr sf,
             const int sfirst,
             const int slast);
 
+    // compute the Q force for a range of sides within one zone
+    // batch; N is the number of sides per zone in the batch, 0
+    // for a generic (mixed) range, or Mesh::rect for a structured
+    // mesh
+    template <int N>
+    void calcForceBatch(
+            double2ptr sf,
+            const int sfirst,
+            const int slast);
+
+    // one-pass version of calcForceBatch:  does all the steps
+    // for one zone at a time, keeping the corner values for the
+    // zone in small local arrays
+    template <int N>
+    void calcForceFusedBatch(
+            double2ptr sf,
+            const int sfirst,
+            const int slast);
+
+    template <int N>
     void setCornerDiv(
             double* c0area,
             double* c0div,
@@ -47,6 +68,7 @@ public:
             const int sfirst,
             const int slast);
 
+    template <int N>
     void setQCnForce(
             const double* c0div,
             const double* c0du,
@@ -55,14 +77,16 @@ public:
             const int sfirst,
             const int slast);
 
+    template <int N>
     void setForce(
             const double* c0area,
             const double2* c0qe,
             double* c0cos,
-            double2* sfqq,
+            double2ptr sfqq,
             const int sfirst,
             const int slast);
 
+    template <int N>
     void setVelDiff(
             const int sfirst,
             const int slast);
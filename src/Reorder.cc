@@ -0,0 +1,364 @@
+/*
+ * Reorder.cc
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#include "Reorder.hh"
+
+#include <stdint.h>
+#include <cstdlib>
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+
+namespace Reorder {
+
+// number of bits per coordinate used for curve keys
+const int sfcbits = 16;
+
+
+// Morton (Z-order) key:  interleave the bits of x and y
+static uint64_t mortonKey(const uint32_t x, const uint32_t y) {
+    uint64_t key = 0;
+    for (int b = 0; b < sfcbits; ++b) {
+        key |= (uint64_t) ((x >> b) & 1) << (2 * b);
+        key |= (uint64_t) ((y >> b) & 1) << (2 * b + 1);
+    }
+    return key;
+}
+
+
+// Hilbert key:  distance along the Hilbert curve filling
+// a 2^sfcbits by 2^sfcbits grid
+static uint64_t hilbertKey(uint32_t x, uint32_t y) {
+    const uint32_t n = 1u << sfcbits;
+    uint64_t key = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        key += (uint64_t) s * s * ((3 * rx) ^ ry);
+        // rotate quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return key;
+}
+
+
+void calcZoneOrderSFC(
+        const vector<double2>& pointpos,
+        const vector<int>& zonestart,
+        const vector<int>& zonesize,
+        const vector<int>& zonepoints,
+        const bool hilbert,
+        vector<int>& zoneorder) {
+
+    const int nump = pointpos.size();
+    const int numz = zonestart.size();
+
+    // find bounding box of mesh
+    double2 xmin(1.e99, 1.e99), xmax(-1.e99, -1.e99);
+    for (int p = 0; p < nump; ++p) {
+        xmin.x = min(xmin.x, pointpos[p].x);
+        xmin.y = min(xmin.y, pointpos[p].y);
+        xmax.x = max(xmax.x, pointpos[p].x);
+        xmax.y = max(xmax.y, pointpos[p].y);
+    }
+    // use the same scale in both directions, so the curve
+    // isn't distorted on long, thin meshes
+    const double len = max(max(xmax.x - xmin.x, xmax.y - xmin.y), 1.e-99);
+    const double scale = ((1u << sfcbits) - 1) / len;
+
+    // compute a curve key for each zone center
+    vector<pair<uint64_t, int> > zkey(numz);
+    for (int z = 0; z < numz; ++z) {
+        double2 zctr(0., 0.);
+        for (int n = 0; n < zonesize[z]; ++n)
+            zctr += pointpos[zonepoints[zonestart[z] + n]];
+        zctr /= (double) zonesize[z];
+        uint32_t ix = (uint32_t) ((zctr.x - xmin.x) * scale);
+        uint32_t iy = (uint32_t) ((zctr.y - xmin.y) * scale);
+        uint64_t key = (hilbert ? hilbertKey(ix, iy) : mortonKey(ix, iy));
+        zkey[z] = make_pair(key, z);
+    }
+
+    // sort zones by key; ties are broken by original zone index
+    sort(zkey.begin(), zkey.end());
+    zoneorder.resize(numz);
+    for (int z = 0; z < numz; ++z)
+        zoneorder[z] = zkey[z].second;
+
+}
+
+
+void calcPointOrderRCM(
+        const int nump,
+        const vector<int>& zonestart,
+        const vector<int>& zonesize,
+        const vector<int>& zonepoints,
+        vector<int>& pointorder) {
+
+    const int numz = zonestart.size();
+
+    // build point-to-point adjacency from the zone edges,
+    // stored in compressed-row form
+    vector<pair<int, int> > pppair;
+    pppair.reserve(2 * zonepoints.size());
+    for (int z = 0; z < numz; ++z) {
+        int sbase = zonestart[z];
+        int size = zonesize[z];
+        for (int n = 0; n < size; ++n) {
+            int p1 = zonepoints[sbase + n];
+            int p2 = zonepoints[sbase + (n + 1 == size ? 0 : n + 1)];
+            pppair.push_back(make_pair(p1, p2));
+            pppair.push_back(make_pair(p2, p1));
+        }
+    }
+    sort(pppair.begin(), pppair.end());
+    pppair.erase(unique(pppair.begin(), pppair.end()), pppair.end());
+
+    vector<int> adjfirst(nump + 1, 0), adj(pppair.size());
+    for (int i = 0; i < pppair.size(); ++i) {
+        adjfirst[pppair[i].first + 1] += 1;
+        adj[i] = pppair[i].second;
+    }
+    for (int p = 0; p < nump; ++p)
+        adjfirst[p + 1] += adjfirst[p];
+    pppair.resize(0);
+
+    vector<int> degree(nump);
+    for (int p = 0; p < nump; ++p)
+        degree[p] = adjfirst[p + 1] - adjfirst[p];
+
+    // candidate start points, lowest degree first
+    vector<pair<int, int> > dpstart(nump);
+    for (int p = 0; p < nump; ++p)
+        dpstart[p] = make_pair(degree[p], p);
+    sort(dpstart.begin(), dpstart.end());
+
+    vector<int> level(nump, -1);
+    vector<char> visited(nump, 0);
+    vector<int> queue;
+    queue.reserve(nump);
+    pointorder.resize(0);
+    pointorder.reserve(nump);
+
+    int istart = 0;
+    while (pointorder.size() < nump) {
+        while (visited[dpstart[istart].second]) ++istart;
+        int pstart = dpstart[istart].second;
+
+        // look for a pseudo-peripheral start point:  repeatedly
+        // move to the lowest-degree point in the last BFS level,
+        // as long as that increases the depth of the level structure
+        int depth = -1;
+        for (int iter = 0; iter < 4; ++iter) {
+            queue.resize(0);
+            queue.push_back(pstart);
+            level[pstart] = 0;
+            for (int i = 0; i < queue.size(); ++i) {
+                int p = queue[i];
+                for (int j = adjfirst[p]; j < adjfirst[p + 1]; ++j) {
+                    int p2 = adj[j];
+                    if (level[p2] < 0 && !visited[p2]) {
+                        level[p2] = level[p] + 1;
+                        queue.push_back(p2);
+                    }
+                }
+            }
+            int lastlevel = level[queue.back()];
+            int pnext = queue.back();
+            for (int i = queue.size() - 1;
+                    i >= 0 && level[queue[i]] == lastlevel; --i) {
+                if (degree[queue[i]] < degree[pnext]) pnext = queue[i];
+            }
+            for (int i = 0; i < queue.size(); ++i)
+                level[queue[i]] = -1;
+            if (lastlevel <= depth) break;
+            depth = lastlevel;
+            pstart = pnext;
+        }
+
+        // Cuthill-McKee BFS from the start point, visiting
+        // neighbors in order of increasing degree
+        int first = pointorder.size();
+        pointorder.push_back(pstart);
+        visited[pstart] = 1;
+        vector<pair<int, int> > nbrs;
+        for (int i = first; i < pointorder.size(); ++i) {
+            int p = pointorder[i];
+            nbrs.resize(0);
+            for (int j = adjfirst[p]; j < adjfirst[p + 1]; ++j) {
+                int p2 = adj[j];
+                if (!visited[p2]) {
+                    visited[p2] = 1;
+                    nbrs.push_back(make_pair(degree[p2], p2));
+                }
+            }
+            sort(nbrs.begin(), nbrs.end());
+            for (int j = 0; j < nbrs.size(); ++j)
+                pointorder.push_back(nbrs[j].second);
+        }
+    }  // while pointorder.size()...
+
+    reverse(pointorder.begin(), pointorder.end());
+
+}
+
+
+void calcPointOrderFromZones(
+        const int nump,
+        const vector<int>& zoneorder,
+        const vector<int>& zonestart,
+        const vector<int>& zonesize,
+        const vector<int>& zonepoints,
+        vector<int>& pointorder) {
+
+    const int numz = zoneorder.size();
+
+    vector<char> seen(nump, 0);
+    pointorder.resize(0);
+    pointorder.reserve(nump);
+    for (int zn = 0; zn < numz; ++zn) {
+        int z = zoneorder[zn];
+        for (int n = 0; n < zonesize[z]; ++n) {
+            int p = zonepoints[zonestart[z] + n];
+            if (seen[p]) continue;
+            seen[p] = 1;
+            pointorder.push_back(p);
+        }
+    }
+    // keep any points not attached to a zone, at the end
+    for (int p = 0; p < nump; ++p)
+        if (!seen[p]) pointorder.push_back(p);
+
+}
+
+
+void calcZoneOrderFromPoints(
+        const vector<int>& pointorder,
+        const vector<int>& zonestart,
+        const vector<int>& zonesize,
+        const vector<int>& zonepoints,
+        vector<int>& zoneorder) {
+
+    const int nump = pointorder.size();
+    const int numz = zonestart.size();
+
+    vector<int> mappnew(nump);
+    for (int pn = 0; pn < nump; ++pn)
+        mappnew[pointorder[pn]] = pn;
+
+    vector<pair<int, int> > zkey(numz);
+    for (int z = 0; z < numz; ++z) {
+        int pmin = nump;
+        for (int n = 0; n < zonesize[z]; ++n)
+            pmin = min(pmin, mappnew[zonepoints[zonestart[z] + n]]);
+        zkey[z] = make_pair(pmin, z);
+    }
+    sort(zkey.begin(), zkey.end());
+    zoneorder.resize(numz);
+    for (int z = 0; z < numz; ++z)
+        zoneorder[z] = zkey[z].second;
+
+}
+
+
+void sortZonesBySize(
+        const vector<int>& zonesize,
+        vector<int>& zoneorder) {
+
+    const int numz = zoneorder.size();
+
+    vector<pair<int, int> > zkey(numz);
+    for (int zn = 0; zn < numz; ++zn)
+        zkey[zn] = make_pair(zonesize[zoneorder[zn]], zn);
+    sort(zkey.begin(), zkey.end());
+    vector<int> neworder(numz);
+    for (int zn = 0; zn < numz; ++zn)
+        neworder[zn] = zoneorder[zkey[zn].second];
+    zoneorder.swap(neworder);
+
+}
+
+
+void apply(
+        const vector<int>& zoneorder,
+        const vector<int>& pointorder,
+        vector<double2>& pointpos,
+        vector<int>& zonestart,
+        vector<int>& zonesize,
+        vector<int>& zonepoints,
+        vector<int>& mappnew) {
+
+    const int nump = pointorder.size();
+    const int numz = zoneorder.size();
+
+    mappnew.resize(nump);
+    for (int pn = 0; pn < nump; ++pn)
+        mappnew[pointorder[pn]] = pn;
+
+    vector<double2> newpos(nump);
+    for (int pn = 0; pn < nump; ++pn)
+        newpos[pn] = pointpos[pointorder[pn]];
+    pointpos.swap(newpos);
+
+    // each zone keeps its own point ordering, so that side
+    // orientation (and hence all side-based results) is unchanged
+    vector<int> newstart(numz), newsize(numz), newpoints;
+    newpoints.reserve(zonepoints.size());
+    for (int zn = 0; zn < numz; ++zn) {
+        int z = zoneorder[zn];
+        newstart[zn] = newpoints.size();
+        newsize[zn] = zonesize[z];
+        for (int n = 0; n < zonesize[z]; ++n)
+            newpoints.push_back(mappnew[zonepoints[zonestart[z] + n]]);
+    }
+    zonestart.swap(newstart);
+    zonesize.swap(newsize);
+    zonepoints.swap(newpoints);
+
+}
+
+
+void calcLocality(
+        const vector<int>& zonestart,
+        const vector<int>& zonesize,
+        const vector<int>& zonepoints,
+        int& bandwidth,
+        double& dist) {
+
+    const int numz = zonestart.size();
+
+    bandwidth = 0;
+    dist = 0.;
+    for (int z = 0; z < numz; ++z) {
+        int sbase = zonestart[z];
+        int size = zonesize[z];
+        for (int n = 0; n < size; ++n) {
+            int p1 = zonepoints[sbase + n];
+            int p2 = zonepoints[sbase + (n + 1 == size ? 0 : n + 1)];
+            int d = abs(p2 - p1);
+            bandwidth = max(bandwidth, d);
+            dist += d;
+        }
+    }
+
+}
+
+
+}  // namespace Reorder
+
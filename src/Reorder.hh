@@ -0,0 +1,96 @@
+/*
+ * Reorder.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef REORDER_HH_
+#define REORDER_HH_
+
+#include <vector>
+
+#include "Vec2.hh"
+
+
+// Namespace Reorder provides helper functions for renumbering the
+// points and zones of a mesh, before the side maps are built from
+// them.  All orderings are returned as lists of old indices in
+// their new order, i.e. as maps:  new index -> old index.
+
+namespace Reorder {
+
+    // order zones along a space-filling curve (Hilbert or Morton)
+    // through the zone centers
+    void calcZoneOrderSFC(
+            const std::vector<double2>& pointpos,
+            const std::vector<int>& zonestart,
+            const std::vector<int>& zonesize,
+            const std::vector<int>& zonepoints,
+            const bool hilbert,
+            std::vector<int>& zoneorder);
+
+    // order points using reverse Cuthill-McKee on the graph
+    // formed by the zone edges
+    void calcPointOrderRCM(
+            const int nump,
+            const std::vector<int>& zonestart,
+            const std::vector<int>& zonesize,
+            const std::vector<int>& zonepoints,
+            std::vector<int>& pointorder);
+
+    // order points by first use, walking zones in the given order
+    void calcPointOrderFromZones(
+            const int nump,
+            const std::vector<int>& zoneorder,
+            const std::vector<int>& zonestart,
+            const std::vector<int>& zonesize,
+            const std::vector<int>& zonepoints,
+            std::vector<int>& pointorder);
+
+    // order zones by their lowest-numbered point, using the
+    // given point order
+    void calcZoneOrderFromPoints(
+            const std::vector<int>& pointorder,
+            const std::vector<int>& zonestart,
+            const std::vector<int>& zonesize,
+            const std::vector<int>& zonepoints,
+            std::vector<int>& zoneorder);
+
+    // stable-sort a zone order by number of points per zone,
+    // so that zones of equal degree are contiguous
+    void sortZonesBySize(
+            const std::vector<int>& zonesize,
+            std::vector<int>& zoneorder);
+
+    // renumber the mesh arrays in place; also return the
+    // inverse point map (old index -> new index) so that callers
+    // can renumber any other point lists they hold
+    void apply(
+            const std::vector<int>& zoneorder,
+            const std::vector<int>& pointorder,
+            std::vector<double2>& pointpos,
+            std::vector<int>& zonestart,
+            std::vector<int>& zonesize,
+            std::vector<int>& zonepoints,
+            std::vector<int>& mappnew);
+
+    // compute locality metrics for the point numbering:
+    // bandwidth is the maximum index distance between the two
+    // points of any side, dist is the sum of those distances
+    // over all sides
+    void calcLocality(
+            const std::vector<int>& zonestart,
+            const std::vector<int>& zonesize,
+            const std::vector<int>& zonepoints,
+            int& bandwidth,
+            double& dist);
+
+}  // namespace Reorder
+
+
+#endif /* REORDER_HH_ */
@@ -0,0 +1,367 @@
+/*
+ * Simd.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef SIMD_HH_
+#define SIMD_HH_
+
+#include "Vec2Ptr.hh"
+
+// Namespace Simd provides a small wrapper around x86 vector
+// intrinsics, used by the explicitly vectorized physics kernels.
+// The widest instruction set enabled by the compiler flags is
+// selected at build time:  AVX-512 (8 doubles), AVX2 (4 doubles)
+// or SSE2 (2 doubles), with a scalar fallback (1 double) for other
+// targets or when SIMD_NONE is defined.
+//
+// All operations round exactly as the corresponding scalar code
+// does, so vectorized kernels give bitwise identical results.  In
+// particular, max(a, b) and min(a, b) have the same semantics as
+// std::max and std::min (the first argument is returned if the
+// two are equal or unordered).
+
+#if !defined(SIMD_NONE) && defined(__AVX512F__)
+#define SIMD_AVX512
+#include <immintrin.h>
+#elif !defined(SIMD_NONE) && defined(__AVX2__)
+#define SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(SIMD_NONE) && defined(__SSE2__)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#else
+#include <cmath>
+#endif
+
+
+namespace Simd {
+
+#if defined(SIMD_AVX512)
+
+const int width = 8;
+const char* const name = "avx512";
+
+struct vdouble { __m512d v; };
+struct vmask { __mmask8 m; };
+
+inline vdouble make(const __m512d v) { vdouble r; r.v = v; return r; }
+
+inline vdouble set1(const double x) { return make(_mm512_set1_pd(x)); }
+inline vdouble load(const double* p) { return make(_mm512_loadu_pd(p)); }
+inline void store(double* p, const vdouble a) { _mm512_storeu_pd(p, a.v); }
+inline vdouble gather(const double* base, const int* idx) {
+    __m256i vi = _mm256_loadu_si256((const __m256i*) idx);
+    return make(_mm512_i32gather_pd(vi, base, 8));
+}
+inline vdouble iota(const double x0) {
+    return make(_mm512_add_pd(_mm512_set1_pd(x0),
+            _mm512_set_pd(7., 6., 5., 4., 3., 2., 1., 0.)));
+}
+
+inline vdouble operator+(const vdouble a, const vdouble b)
+    { return make(_mm512_add_pd(a.v, b.v)); }
+inline vdouble operator-(const vdouble a, const vdouble b)
+    { return make(_mm512_sub_pd(a.v, b.v)); }
+inline vdouble operator*(const vdouble a, const vdouble b)
+    { return make(_mm512_mul_pd(a.v, b.v)); }
+inline vdouble operator/(const vdouble a, const vdouble b)
+    { return make(_mm512_div_pd(a.v, b.v)); }
+inline vdouble operator-(const vdouble a)
+    { return make(_mm512_castsi512_pd(_mm512_xor_si512(
+            _mm512_castpd_si512(a.v),
+            _mm512_castpd_si512(_mm512_set1_pd(-0.))))); }
+inline vdouble max(const vdouble a, const vdouble b)
+    { return make(_mm512_max_pd(b.v, a.v)); }
+inline vdouble min(const vdouble a, const vdouble b)
+    { return make(_mm512_min_pd(b.v, a.v)); }
+inline vdouble sqrt(const vdouble a)
+    { return make(_mm512_sqrt_pd(a.v)); }
+inline vdouble abs(const vdouble a)
+    { return make(_mm512_castsi512_pd(_mm512_andnot_si512(
+            _mm512_castpd_si512(_mm512_set1_pd(-0.)),
+            _mm512_castpd_si512(a.v)))); }
+
+inline vmask operator<(const vdouble a, const vdouble b)
+    { vmask r; r.m = _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); return r; }
+inline vmask operator>(const vdouble a, const vdouble b)
+    { vmask r; r.m = _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); return r; }
+// select(m, a, b) = (m ? a : b), lane by lane
+inline vdouble select(const vmask m, const vdouble a, const vdouble b)
+    { return make(_mm512_mask_blend_pd(m.m, b.v, a.v)); }
+
+// load/store W consecutive double2 elements, as x and y vectors
+inline void load2(double2cptr p, const int i, vdouble& x, vdouble& y) {
+#ifdef USE_SOA
+    x = load(&p.x[i]);
+    y = load(&p.y[i]);
+#else
+    const double* q = (const double*) &p[i];
+    __m512d a = _mm512_loadu_pd(q);
+    __m512d b = _mm512_loadu_pd(q + 8);
+    x = make(_mm512_permutex2var_pd(a,
+            _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0), b));
+    y = make(_mm512_permutex2var_pd(a,
+            _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1), b));
+#endif
+}
+inline void store2(double2ptr p, const int i,
+        const vdouble x, const vdouble y) {
+#ifdef USE_SOA
+    store(&p.x[i], x);
+    store(&p.y[i], y);
+#else
+    double* q = (double*) &p[i];
+    _mm512_storeu_pd(q, _mm512_permutex2var_pd(x.v,
+            _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0), y.v));
+    _mm512_storeu_pd(q + 8, _mm512_permutex2var_pd(x.v,
+            _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4), y.v));
+#endif
+}
+
+#elif defined(SIMD_AVX2)
+
+const int width = 4;
+const char* const name = "avx2";
+
+struct vdouble { __m256d v; };
+struct vmask { __m256d m; };
+
+inline vdouble make(const __m256d v) { vdouble r; r.v = v; return r; }
+
+inline vdouble set1(const double x) { return make(_mm256_set1_pd(x)); }
+inline vdouble load(const double* p) { return make(_mm256_loadu_pd(p)); }
+inline void store(double* p, const vdouble a) { _mm256_storeu_pd(p, a.v); }
+inline vdouble gather(const double* base, const int* idx) {
+    __m128i vi = _mm_loadu_si128((const __m128i*) idx);
+    return make(_mm256_i32gather_pd(base, vi, 8));
+}
+inline vdouble iota(const double x0) {
+    return make(_mm256_add_pd(_mm256_set1_pd(x0),
+            _mm256_set_pd(3., 2., 1., 0.)));
+}
+
+inline vdouble operator+(const vdouble a, const vdouble b)
+    { return make(_mm256_add_pd(a.v, b.v)); }
+inline vdouble operator-(const vdouble a, const vdouble b)
+    { return make(_mm256_sub_pd(a.v, b.v)); }
+inline vdouble operator*(const vdouble a, const vdouble b)
+    { return make(_mm256_mul_pd(a.v, b.v)); }
+inline vdouble operator/(const vdouble a, const vdouble b)
+    { return make(_mm256_div_pd(a.v, b.v)); }
+inline vdouble operator-(const vdouble a)
+    { return make(_mm256_xor_pd(a.v, _mm256_set1_pd(-0.))); }
+inline vdouble max(const vdouble a, const vdouble b)
+    { return make(_mm256_max_pd(b.v, a.v)); }
+inline vdouble min(const vdouble a, const vdouble b)
+    { return make(_mm256_min_pd(b.v, a.v)); }
+inline vdouble sqrt(const vdouble a)
+    { return make(_mm256_sqrt_pd(a.v)); }
+inline vdouble abs(const vdouble a)
+    { return make(_mm256_andnot_pd(_mm256_set1_pd(-0.), a.v)); }
+
+inline vmask operator<(const vdouble a, const vdouble b)
+    { vmask r; r.m = _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); return r; }
+inline vmask operator>(const vdouble a, const vdouble b)
+    { vmask r; r.m = _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); return r; }
+inline vdouble select(const vmask m, const vdouble a, const vdouble b)
+    { return make(_mm256_blendv_pd(b.v, a.v, m.m)); }
+
+inline void load2(double2cptr p, const int i, vdouble& x, vdouble& y) {
+#ifdef USE_SOA
+    x = load(&p.x[i]);
+    y = load(&p.y[i]);
+#else
+    const double* q = (const double*) &p[i];
+    __m256d a = _mm256_loadu_pd(q);
+    __m256d b = _mm256_loadu_pd(q + 4);
+    // unpack gives lanes in order 0, 2, 1, 3
+    x = make(_mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), 0xd8));
+    y = make(_mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), 0xd8));
+#endif
+}
+inline void store2(double2ptr p, const int i,
+        const vdouble x, const vdouble y) {
+#ifdef USE_SOA
+    store(&p.x[i], x);
+    store(&p.y[i], y);
+#else
+    double* q = (double*) &p[i];
+    __m256d tx = _mm256_permute4x64_pd(x.v, 0xd8);
+    __m256d ty = _mm256_permute4x64_pd(y.v, 0xd8);
+    _mm256_storeu_pd(q, _mm256_unpacklo_pd(tx, ty));
+    _mm256_storeu_pd(q + 4, _mm256_unpackhi_pd(tx, ty));
+#endif
+}
+
+#elif defined(SIMD_SSE2)
+
+const int width = 2;
+const char* const name = "sse2";
+
+struct vdouble { __m128d v; };
+struct vmask { __m128d m; };
+
+inline vdouble make(const __m128d v) { vdouble r; r.v = v; return r; }
+
+inline vdouble set1(const double x) { return make(_mm_set1_pd(x)); }
+inline vdouble load(const double* p) { return make(_mm_loadu_pd(p)); }
+inline void store(double* p, const vdouble a) { _mm_storeu_pd(p, a.v); }
+inline vdouble gather(const double* base, const int* idx)
+    { return make(_mm_set_pd(base[idx[1]], base[idx[0]])); }
+inline vdouble iota(const double x0)
+    { return make(_mm_set_pd(x0 + 1., x0)); }
+
+inline vdouble operator+(const vdouble a, const vdouble b)
+    { return make(_mm_add_pd(a.v, b.v)); }
+inline vdouble operator-(const vdouble a, const vdouble b)
+    { return make(_mm_sub_pd(a.v, b.v)); }
+inline vdouble operator*(const vdouble a, const vdouble b)
+    { return make(_mm_mul_pd(a.v, b.v)); }
+inline vdouble operator/(const vdouble a, const vdouble b)
+    { return make(_mm_div_pd(a.v, b.v)); }
+inline vdouble operator-(const vdouble a)
+    { return make(_mm_xor_pd(a.v, _mm_set1_pd(-0.))); }
+inline vdouble max(const vdouble a, const vdouble b)
+    { return make(_mm_max_pd(b.v, a.v)); }
+inline vdouble min(const vdouble a, const vdouble b)
+    { return make(_mm_min_pd(b.v, a.v)); }
+inline vdouble sqrt(const vdouble a)
+    { return make(_mm_sqrt_pd(a.v)); }
+inline vdouble abs(const vdouble a)
+    { return make(_mm_andnot_pd(_mm_set1_pd(-0.), a.v)); }
+
+inline vmask operator<(const vdouble a, const vdouble b)
+    { vmask r; r.m = _mm_cmplt_pd(a.v, b.v); return r; }
+inline vmask operator>(const vdouble a, const vdouble b)
+    { vmask r; r.m = _mm_cmpgt_pd(a.v, b.v); return r; }
+inline vdouble select(const vmask m, const vdouble a, const vdouble b)
+    { return make(_mm_or_pd(_mm_and_pd(m.m, a.v),
+            _mm_andnot_pd(m.m, b.v))); }
+
+inline void load2(double2cptr p, const int i, vdouble& x, vdouble& y) {
+#ifdef USE_SOA
+    x = load(&p.x[i]);
+    y = load(&p.y[i]);
+#else
+    const double* q = (const double*) &p[i];
+    __m128d a = _mm_loadu_pd(q);
+    __m128d b = _mm_loadu_pd(q + 2);
+    x = make(_mm_unpacklo_pd(a, b));
+    y = make(_mm_unpackhi_pd(a, b));
+#endif
+}
+inline void store2(double2ptr p, const int i,
+        const vdouble x, const vdouble y) {
+#ifdef USE_SOA
+    store(&p.x[i], x);
+    store(&p.y[i], y);
+#else
+    double* q = (double*) &p[i];
+    _mm_storeu_pd(q, _mm_unpacklo_pd(x.v, y.v));
+    _mm_storeu_pd(q + 2, _mm_unpackhi_pd(x.v, y.v));
+#endif
+}
+
+#else  // scalar fallback
+
+const int width = 1;
+const char* const name = "none";
+
+struct vdouble { double v; };
+struct vmask { bool m; };
+
+inline vdouble make(const double v) { vdouble r; r.v = v; return r; }
+
+inline vdouble set1(const double x) { return make(x); }
+inline vdouble load(const double* p) { return make(*p); }
+inline void store(double* p, const vdouble a) { *p = a.v; }
+inline vdouble gather(const double* base, const int* idx)
+    { return make(base[*idx]); }
+inline vdouble iota(const double x0) { return make(x0); }
+
+inline vdouble operator+(const vdouble a, const vdouble b)
+    { return make(a.v + b.v); }
+inline vdouble operator-(const vdouble a, const vdouble b)
+    { return make(a.v - b.v); }
+inline vdouble operator*(const vdouble a, const vdouble b)
+    { return make(a.v * b.v); }
+inline vdouble operator/(const vdouble a, const vdouble b)
+    { return make(a.v / b.v); }
+inline vdouble operator-(const vdouble a)
+    { return make(-a.v); }
+inline vdouble max(const vdouble a, const vdouble b)
+    { return make(a.v < b.v ? b.v : a.v); }
+inline vdouble min(const vdouble a, const vdouble b)
+    { return make(b.v < a.v ? b.v : a.v); }
+inline vdouble sqrt(const vdouble a)
+    { return make(std::sqrt(a.v)); }
+inline vdouble abs(const vdouble a)
+    { return make(std::fabs(a.v)); }
+
+inline vmask operator<(const vdouble a, const vdouble b)
+    { vmask r; r.m = (a.v < b.v); return r; }
+inline vmask operator>(const vdouble a, const vdouble b)
+    { vmask r; r.m = (a.v > b.v); return r; }
+inline vdouble select(const vmask m, const vdouble a, const vdouble b)
+    { return make(m.m ? a.v : b.v); }
+
+inline void load2(double2cptr p, const int i, vdouble& x, vdouble& y) {
+    double2 v = p[i];
+    x = make(v.x);
+    y = make(v.y);
+}
+inline void store2(double2ptr p, const int i,
+        const vdouble x, const vdouble y) {
+    p[i] = double2(x.v, y.v);
+}
+
+#endif  // SIMD_*
+
+
+// combine the lanes of a vector of running minima (and the
+// indices where they were found) into a scalar minimum and index;
+// ties go to the lowest index, as in a sequential search using <
+inline void reduceMinLoc(
+        const vdouble v,
+        const vdouble idx,
+        double& vmin,
+        int& imin) {
+    double vv[width], vi[width];
+    store(vv, v);
+    store(vi, idx);
+    for (int l = 0; l < width; ++l) {
+        if (vv[l] < vmin || (vv[l] == vmin && (int) vi[l] < imin)) {
+            vmin = vv[l];
+            imin = (int) vi[l];
+        }
+    }
+}
+
+
+// same as reduceMinLoc, for a maximum
+inline void reduceMaxLoc(
+        const vdouble v,
+        const vdouble idx,
+        double& vmax,
+        int& imax) {
+    double vv[width], vi[width];
+    store(vv, v);
+    store(vi, idx);
+    for (int l = 0; l < width; ++l) {
+        if (vv[l] > vmax || (vv[l] == vmax && (int) vi[l] < imax)) {
+            vmax = vv[l];
+            imax = (int) vi[l];
+        }
+    }
+}
+
+}  // namespace Simd
+
+#endif /* SIMD_HH_ */
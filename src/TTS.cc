@@ -16,6 +16,7 @@
 #include "InputFile.hh"
 #include "Mesh.hh"
 #include "Hydro.hh"
+#include "Simd.hh"
 
 using namespace std;
 
@@ -36,8 +37,8 @@ void TTS::calcForce(
         const double* zss,
         const double* sarea,
         const double* smf,
-        const double2* ssurfp,
-        double2* sf,
+        double2cptr ssurfp,
+        double2ptr sf,
         const int sfirst,
         const int slast) {
 
@@ -54,9 +55,59 @@ void TTS::calcForce(
     //           svfac stores (sv/zv)
 
     const Mesh* mesh = hydro->mesh;
+    if (mesh->structured) {
+        calcForceBatch<Mesh::rect>(zarea, zr, zss, sarea, smf, ssurfp, sf,
+                sfirst, slast);
+        return;
+    }
+    if (mesh->numbat > 0) {
+        for (int b = 0; b < mesh->numbat; ++b) {
+            int bf = max(sfirst, mesh->batsfirst[b]);
+            int bl = min(slast, mesh->batslast[b]);
+            if (bf >= bl) continue;
+            switch (mesh->batnump[b]) {
+            case 3:
+                calcForceBatch<3>(zarea, zr, zss, sarea, smf, ssurfp, sf,
+                        bf, bl);
+                break;
+            case 4:
+                calcForceBatch<4>(zarea, zr, zss, sarea, smf, ssurfp, sf,
+                        bf, bl);
+                break;
+            case 6:
+                calcForceBatch<6>(zarea, zr, zss, sarea, smf, ssurfp, sf,
+                        bf, bl);
+                break;
+            default:
+                calcForceBatch<0>(zarea, zr, zss, sarea, smf, ssurfp, sf,
+                        bf, bl);
+                break;
+            }
+        }
+        return;
+    }
+
+    using namespace Simd;
+    const int svlast = slast - (slast - sfirst) % width;
+    const vdouble valfa = set1(alfa), vssmin = set1(ssmin);
+    for (int s = sfirst; s < svlast; s += width) {
+        const int* z = &mesh->mapsz[s];
+        vdouble vzr = gather(zr, z);
+
+        vdouble svfacinv = gather(zarea, z) / load(&sarea[s]);
+        vdouble srho = vzr * load(&smf[s]) * svfacinv;
+        vdouble sstmp = max(gather(zss, z), vssmin);
+        sstmp = valfa * sstmp * sstmp;
+        vdouble sdp = sstmp * (srho - vzr);
+        vdouble sx, sy;
+        load2(ssurfp, s, sx, sy);
+        vdouble nsdp = -sdp;
+        store2(sf, s, sx * nsdp, sy * nsdp);
+
+    }
 
     #pragma ivdep
-    for (int s = sfirst; s < slast; ++s) {
+    for (int s = svlast; s < slast; ++s) {
         int z = mesh->mapsz[s];
 
         double svfacinv = zarea[z] / sarea[s];
@@ -71,3 +122,37 @@ void TTS::calcForce(
 
 }
 
+
+template <int N>
+void TTS::calcForceBatch(
+        const double* zarea,
+        const double* zr,
+        const double* zss,
+        const double* sarea,
+        const double* smf,
+        double2cptr ssurfp,
+        double2ptr sf,
+        const int sfirst,
+        const int slast) {
+
+    const Mesh* mesh = hydro->mesh;
+
+    int s1 = sfirst;
+    while (s1 < slast) {
+        const int z = mesh->sideZone<N>(s1);
+        const int n = mesh->zoneSides<N>(z);
+        double sstmp = max(zss[z], ssmin);
+        sstmp = alfa * sstmp * sstmp;
+
+        for (int i = 0; i < n; ++i) {
+            int s = s1 + i;
+            double svfacinv = zarea[z] / sarea[s];
+            double srho = zr[z] * smf[s] * svfacinv;
+            double sdp = sstmp * (srho - zr[z]);
+            sf[s] = -sdp * ssurfp[s];
+        }
+        s1 += n;
+    }
+
+}
+
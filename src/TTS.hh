@@ -13,7 +13,7 @@
 #ifndef TTS_HH_
 #define TTS_HH_
 
-#include "Vec2.hh"
+#include "Vec2Ptr.hh"
 
 // forward declarations
 class InputFile;
@@ -38,11 +38,25 @@ void calcForce(
         const double* zss,
         const double* sarea,
         const double* smf,
-        const double2* ssurfp,
-        double2* sf,
+        double2cptr ssurfp,
+        double2ptr sf,
         const int sfirst,
         const int slast);
 
+    // calcForce for a range of sides within one zone batch, or
+    // on a structured mesh (N = Mesh::rect)
+    template <int N>
+    void calcForceBatch(
+            const double* zarea,
+            const double* zr,
+            const double* zss,
+            const double* sarea,
+            const double* smf,
+            double2cptr ssurfp,
+            double2ptr sf,
+            const int sfirst,
+            const int slast);
+
 }; // class TTS
 
 
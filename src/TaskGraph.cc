@@ -0,0 +1,61 @@
+/*
+ * TaskGraph.cc
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#include "TaskGraph.hh"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+
+TaskGraph::TaskGraph() {}
+
+
+int TaskGraph::addTask(const int kind, const int index) {
+    taskkind.push_back(kind);
+    taskindex.push_back(index);
+    return taskkind.size() - 1;
+}
+
+
+void TaskGraph::addDep(const int pred, const int succ) {
+    deppred.push_back(pred);
+    depsucc.push_back(succ);
+}
+
+
+void TaskGraph::finalize() {
+
+    const int numt = numTasks();
+
+    // sort and remove duplicate dependencies
+    vector<pair<int, int> > deps(deppred.size());
+    for (int i = 0; i < deps.size(); ++i)
+        deps[i] = make_pair(deppred[i], depsucc[i]);
+    sort(deps.begin(), deps.end());
+    deps.erase(unique(deps.begin(), deps.end()), deps.end());
+    deppred.resize(0);
+    depsucc.resize(0);
+
+    succfirst.assign(numt + 1, 0);
+    succ.resize(deps.size());
+    npred.assign(numt, 0);
+    for (int i = 0; i < deps.size(); ++i) {
+        succfirst[deps[i].first + 1] += 1;
+        succ[i] = deps[i].second;
+        npred[deps[i].second] += 1;
+    }
+    for (int t = 0; t < numt; ++t)
+        succfirst[t + 1] += succfirst[t];
+
+}
+
@@ -0,0 +1,117 @@
+/*
+ * TaskGraph.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef TASKGRAPH_HH_
+#define TASKGRAPH_HH_
+
+#include <vector>
+
+
+// Class TaskGraph holds a fixed dependency graph of tasks, which
+// can be run any number of times.  Each task is identified by a
+// kind and an index (e.g. a phase and a chunk number), which are
+// passed to the runTask method of the object given to run().
+//
+// A task starts as soon as all of its predecessors are done,
+// without any global barriers:  under OpenMP, each finished task
+// releases its successors as OpenMP tasks, so they are scheduled
+// (and load balanced) by the runtime's task scheduler.  Without
+// OpenMP, tasks are run in order from a ready list.
+
+class TaskGraph {
+public:
+
+    TaskGraph();
+
+    // add a task; returns its id
+    int addTask(const int kind, const int index);
+
+    // require task pred to finish before task succ starts;
+    // duplicate dependencies are allowed
+    void addDep(const int pred, const int succ);
+
+    // build the successor lists; must be called after all tasks
+    // and dependencies are added, and before run()
+    void finalize();
+
+    int numTasks() const { return taskkind.size(); }
+    int numDeps() const { return succ.size(); }
+
+    // run all tasks, calling obj->runTask(kind, index) for each;
+    // returns when all are done
+    template <typename T>
+    void run(T* obj);
+
+private:
+
+    std::vector<int> taskkind;       // kind of each task
+    std::vector<int> taskindex;      // index of each task
+    std::vector<int> deppred;        // dependencies added so far
+    std::vector<int> depsucc;
+    std::vector<int> succfirst;      // successors of each task,
+    std::vector<int> succ;           // in compressed-row form
+    std::vector<int> npred;          // number of predecessors
+    std::vector<int> nwait;          // predecessors not yet done,
+                                     // during a run
+
+    template <typename T>
+    void spawn(T* obj, const int t);
+
+}; // class TaskGraph
+
+
+template <typename T>
+void TaskGraph::run(T* obj) {
+
+    nwait = npred;
+#ifdef _OPENMP
+    // the barrier at the end of the region waits for all tasks,
+    // including those spawned by other tasks
+    #pragma omp parallel
+    #pragma omp single
+    {
+        for (int t = 0; t < numTasks(); ++t)
+            if (npred[t] == 0) spawn(obj, t);
+    }
+#else
+    std::vector<int> ready;
+    for (int t = 0; t < numTasks(); ++t)
+        if (npred[t] == 0) ready.push_back(t);
+    for (int i = 0; i < ready.size(); ++i) {
+        int t = ready[i];
+        obj->runTask(taskkind[t], taskindex[t]);
+        for (int j = succfirst[t]; j < succfirst[t + 1]; ++j)
+            if (--nwait[succ[j]] == 0) ready.push_back(succ[j]);
+    }
+#endif
+
+}
+
+
+template <typename T>
+void TaskGraph::spawn(T* obj, const int t) {
+
+    #pragma omp task firstprivate(obj, t)
+    {
+        obj->runTask(taskkind[t], taskindex[t]);
+        for (int j = succfirst[t]; j < succfirst[t + 1]; ++j) {
+            int s = succ[j];
+            int n;
+            #pragma omp atomic capture
+            n = --nwait[s];
+            if (n == 0) spawn(obj, s);
+        }
+    }
+
+}
+
+
+#endif /* TASKGRAPH_HH_ */
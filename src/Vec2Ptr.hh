@@ -0,0 +1,171 @@
+/*
+ * Vec2Ptr.hh
+ *
+ *  Created on: Oct 16, 2026
+ *
+ * Copyright (c) 2026, Triad National Security, LLC.
+ * All rights reserved.
+ * Use of this source code is governed by a BSD-style open-source
+ * license; see top-level LICENSE file for full license text.
+ */
+
+#ifndef VEC2PTR_HH_
+#define VEC2PTR_HH_
+
+#include "Vec2.hh"
+#include "Memory.hh"
+
+// Arrays of double2 are accessed through the types double2ptr
+// and double2cptr (the const version).  By default these are
+// just double2* and const double2*, and the array is stored as
+// interleaved (x, y) pairs.  If USE_SOA is defined, the x and y
+// components are stored in two separate arrays instead; indexing
+// then yields a proxy which converts to and from double2, so that
+// the usual double2 arithmetic still works on array elements.
+
+#ifdef USE_SOA
+
+// reference to one element of an SoA double2 array
+struct double2ref
+{
+    double& x;
+    double& y;
+
+    inline double2ref(double& x_, double& y_) : x(x_), y(y_) {}
+
+    inline operator double2() const
+    {
+        return(double2(x, y));
+    }
+
+    inline double2ref& operator=(const double2& v2)
+    {
+        x = v2.x;
+        y = v2.y;
+        return(*this);
+    }
+
+    inline double2ref& operator=(const double2ref& v2)
+    {
+        x = v2.x;
+        y = v2.y;
+        return(*this);
+    }
+
+    inline double2ref& operator+=(const double2& v2)
+    {
+        x += v2.x;
+        y += v2.y;
+        return(*this);
+    }
+
+    inline double2ref& operator-=(const double2& v2)
+    {
+        x -= v2.x;
+        y -= v2.y;
+        return(*this);
+    }
+
+    inline double2ref& operator*=(const double& r)
+    {
+        x *= r;
+        y *= r;
+        return(*this);
+    }
+
+    inline double2ref& operator/=(const double& r)
+    {
+        x /= r;
+        y /= r;
+        return(*this);
+    }
+
+}; // double2ref
+
+
+struct double2ptr
+{
+    double* x;
+    double* y;
+
+    inline double2ptr() : x(0), y(0) {}
+    inline double2ptr(double* x_, double* y_) : x(x_), y(y_) {}
+
+    inline double2ref operator[](const int i) const
+    {
+        return(double2ref(x[i], y[i]));
+    }
+
+}; // double2ptr
+
+
+struct double2cptr
+{
+    const double* x;
+    const double* y;
+
+    inline double2cptr() : x(0), y(0) {}
+    inline double2cptr(const double* x_, const double* y_) : x(x_), y(y_) {}
+    inline double2cptr(const double2ptr& p) : x(p.x), y(p.y) {}
+
+    inline double2 operator[](const int i) const
+    {
+        return(double2(x[i], y[i]));
+    }
+
+}; // double2cptr
+
+
+namespace Memory {
+
+inline double2ptr alloc2(const int count) {
+    // one block holds both components, so the y array follows
+    // the x array in memory
+    double* p = alloc<double>(2 * count);
+    return(double2ptr(p, p + count));
+}
+
+inline void free2(double2ptr ptr) {
+    free(ptr.x);
+}
+
+// allocate a scratch array from the given scope, indexed by
+// first <= i < last
+inline double2ptr scratch2(
+        ArenaScope& scope,
+        const int first,
+        const int last) {
+    const int count = last - first;
+    double* p = scope.alloc<double>(2 * count);
+    return(double2ptr(p - first, p + count - first));
+}
+
+};  // namespace Memory
+
+#else  // USE_SOA
+
+typedef double2* double2ptr;
+typedef const double2* double2cptr;
+
+namespace Memory {
+
+inline double2ptr alloc2(const int count) {
+    return(alloc<double2>(count));
+}
+
+inline void free2(double2ptr ptr) {
+    free(ptr);
+}
+
+inline double2ptr scratch2(
+        ArenaScope& scope,
+        const int first,
+        const int last) {
+    return(scope.alloc<double2>(last - first) - first);
+}
+
+};  // namespace Memory
+
+#endif  // USE_SOA
+
+#endif /* VEC2PTR_HH_ */
@@ -34,7 +34,40 @@ void WriteXY::write(
 
     using Parallel::numpe;
     using Parallel::mype;
-    const int numz = mesh->numz;
+    int numz = mesh->numz;
+    const int* mapzorig = mesh->mapzorig;
+
+    // if the mesh was reordered, put zones back in the order
+    // they were generated, so output is independent of ordering;
+    // with ghost zones, write only the zones this PE owns
+    vector<double> ozr, oze, ozp;
+    if (mesh->ghostzones) {
+        for (int r = 0; r < mesh->ownzfirst.size(); ++r) {
+            int zfirst = mesh->ownzfirst[r];
+            int zlast = mesh->ownzlast[r];
+            ozr.insert(ozr.end(), &zr[zfirst], &zr[zlast]);
+            oze.insert(oze.end(), &ze[zfirst], &ze[zlast]);
+            ozp.insert(ozp.end(), &zp[zfirst], &zp[zlast]);
+        }
+        numz = ozr.size();
+        zr = &ozr[0];
+        ze = &oze[0];
+        zp = &ozp[0];
+    }
+    else if (mapzorig != NULL) {
+        ozr.resize(numz);
+        oze.resize(numz);
+        ozp.resize(numz);
+        for (int z = 0; z < numz; ++z) {
+            int zo = mapzorig[z];
+            ozr[zo] = zr[z];
+            oze[zo] = ze[z];
+            ozp[zo] = zp[z];
+        }
+        zr = &ozr[0];
+        ze = &oze[0];
+        zp = &ozp[0];
+    }
 
     int gnumz = numz;
     Parallel::globalSum(gnumz);
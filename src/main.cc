@@ -15,6 +15,8 @@
 #include <iostream>
 
 #include "Parallel.hh"
+#include "Exec.hh"
+#include "Affinity.hh"
 #include "InputFile.hh"
 #include "Driver.hh"
 
@@ -40,9 +42,17 @@ int main(const int argc, const char** argv)
     if (probname.substr(len - 4, 4) == ".pnt")
         probname = probname.substr(0, len - 4);
 
-    Driver drv(&inp, probname);
-
-    drv.run();
+    // the backend and the process's CPUs are shared by all
+    // in-process domains, so set them up before they start
+    Exec::select(inp.getString("exec", "omp"));
+    Affinity::init();
+
+    // each in-process domain runs the whole problem on its part
+    // of the mesh
+    Parallel::runDomains(inp.getInt("domains", 1), [&]() {
+        Driver drv(&inp, probname);
+        drv.run();
+    });
 
     Parallel::final();
 
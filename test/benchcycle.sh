@@ -0,0 +1,82 @@
+#!/bin/bash
+#
+# benchcycle.sh
+#
+# Measure the run time per hydro cycle on small meshes, where
+# thread fork/join and barrier overhead is a large fraction of
+# each cycle (as in strong scaling with few zones per rank).
+# Runs a Sedov problem on square meshes of the given numbers of
+# zones per side, and prints microseconds per cycle.
+#
+# usage (from the top-level PENNANT directory):
+#     test/benchcycle.sh [zones per side ...]
+#
+# The binary to time is given by BIN (default build/pennant).
+# If BASE is set to a second binary (e.g. one built from an
+# earlier revision), both are timed and the ratio is printed.
+# Other settings:  NCYC (cycles per run, default 1000), NREP
+# (repetitions; the best time is reported, default 3), CHUNK (the
+# chunksize, default 64).  Set OMP_NUM_THREADS as usual.
+
+sizes=${@:-"4 8 16 32 64"}
+bin=${BIN:-build/pennant}
+base=$BASE
+ncyc=${NCYC:-1000}
+nrep=${NREP:-3}
+chunk=${CHUNK:-64}
+top=$(pwd)
+
+# make binary paths absolute, since runs are in a scratch directory
+abspath() {
+    case $1 in
+        /*) echo $1 ;;
+        *)  echo $top/$1 ;;
+    esac
+}
+bin=$(abspath $bin)
+[ -n "$base" ] && base=$(abspath $base)
+
+rundir=$(mktemp -d)
+trap "rm -rf $rundir" EXIT
+
+# best time per cycle in microseconds, for binary $1 on deck $2
+timecycle() {
+    local best= t
+    for rep in $(seq $nrep); do
+        t=$(cd $rundir && $1 $2 |
+                sed -n 's/^hydro cycle run time= *//p')
+        if [ -z "$best" ] || awk "BEGIN {exit !($t < $best)}"; then
+            best=$t
+        fi
+    done
+    awk "BEGIN {print $best / $ncyc * 1.e6}"
+}
+
+if [ -n "$base" ]; then
+    printf "%8s %8s %14s %14s %8s\n" nz zones "base us/cyc" "us/cyc" \
+            "speedup"
+else
+    printf "%8s %8s %14s\n" nz zones "us/cyc"
+fi
+for nz in $sizes; do
+    # one-zone energy source at the origin, as in sedovsmall
+    len=$(awk "BEGIN {print $nz * 0.125}")
+    deck=sedov$nz.pnt
+    sed -e "s/^cstop .*/cstop   $ncyc/" \
+        -e "s/^tstop .*/tstop   1.e99/" \
+        -e "s/^meshparams .*/meshparams $nz $nz $len $len/" \
+        -e "s/^bcx .*/bcx     0.0 $len/" \
+        -e "s/^bcy .*/bcy     0.0 $len/" \
+        -e "s/^writexy .*/writexy 0/" \
+        -e "s/^chunksize .*/chunksize $chunk/" \
+        $top/test/sedovsmall/sedovsmall.pnt > $rundir/$deck
+
+    t=$(timecycle $bin $deck)
+    if [ -n "$base" ]; then
+        tb=$(timecycle $base $deck)
+        printf "%8d %8d %14.2f %14.2f %8.3f\n" $nz $((nz * nz)) $tb $t \
+                $(awk "BEGIN {print $tb / $t}")
+    else
+        printf "%8d %8d %14.2f\n" $nz $((nz * nz)) $t
+    fi
+done
@@ -0,0 +1,58 @@
+#!/bin/bash
+#
+# benchhalo.sh
+#
+# Time the exchange that sums values at points shared between MPI
+# PEs, by itself, with each halo exchange method (see the
+# haloexchange input parameter).  Generates square Sedov meshes
+# with the given numbers of zones per side, decomposes them over
+# each number of PEs, and prints microseconds per sum of three
+# doubles per shared point (the corner mass and force sums of one
+# hydro cycle).
+#
+# usage (from the top-level PENNANT directory):
+#     test/benchhalo.sh [zones per side ...]
+#
+# The binary to time is given by BIN (default build/pennant).
+# Other settings:  NP (numbers of PEs, default "2 4 8"), NREP (sums
+# per timing, default 1000), MPIRUN (the MPI launcher and its
+# options, default mpirun).  Set OMP_NUM_THREADS as usual.
+
+sizes=${@:-"64 256 1024"}
+bin=${BIN:-build/pennant}
+nps=${NP:-"2 4 8"}
+nrep=${NREP:-1000}
+mpirun=${MPIRUN:-mpirun}
+top=$(pwd)
+
+case $bin in
+    /*) ;;
+    *)  bin=$top/$bin ;;
+esac
+
+rundir=$(mktemp -d)
+trap "rm -rf $rundir" EXIT
+
+printf "%8s %6s %10s %12s %12s %12s %12s %12s\n" nz np "bytes/sum" \
+        p2p persistent neighbor rma shm
+for nz in $sizes; do
+    len=$(awk "BEGIN {print $nz * 0.125}")
+    deck=halo$nz.pnt
+    sed -e "s/^meshparams .*/meshparams $nz $nz $len $len/" \
+        -e "s/^bcx .*/bcx     0.0 $len/" \
+        -e "s/^bcy .*/bcy     0.0 $len/" \
+        $top/test/sedovsmall/sedovsmall.pnt > $rundir/$deck
+    echo "benchhalo $nrep" >> $rundir/$deck
+
+    for np in $nps; do
+        out=$(cd $rundir && $mpirun -np $np $bin $deck)
+        if echo "$out" | grep -q FAILED; then
+            echo "$out" | grep FAILED
+        fi
+        bytes=$(echo "$out" | sed -n 's/^Bytes per sum: *//p')
+        times=$(echo "$out" |
+                awk '$1 ~ /^(p2p|persistent|neighbor|rma|shm)$/ {print $2}')
+        printf "%8d %6d %10s %12s %12s %12s %12s %12s\n" $nz $np \
+                "$bytes" $times
+    done
+done
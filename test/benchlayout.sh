@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+# benchlayout.sh
+#
+# Compare hydro cycle run times for the AoS (default) and SoA
+# storage layouts of double2 arrays.  Builds both versions of the
+# code, then runs each test problem with each binary.
+#
+# usage (from the top-level PENNANT directory):
+#     test/benchlayout.sh [problem ...]
+#
+# The default problems are the small standard tests; any directory
+# name under test/ can be given.  Extra make arguments (e.g.
+# compiler settings) can be passed in MAKEARGS, and the number of
+# repetitions of each run in NREP (the best time is reported).
+
+problems=${@:-"sedovsmall sedov nohsmall noh leblanc"}
+nrep=${NREP:-3}
+top=$(pwd)
+builddir=$top/build
+
+for layout in aos soa; do
+    make -s BUILDDIR=$builddir/$layout LAYOUT=$layout $MAKEARGS || exit 1
+done
+
+rundir=$(mktemp -d)
+trap "rm -rf $rundir" EXIT
+
+printf "%-16s %14s %14s %8s\n" problem "aos time" "soa time" "aos/soa"
+for prob in $problems; do
+    cp $top/test/$prob/$prob.pnt $rundir/
+    for layout in aos soa; do
+        best=
+        for rep in $(seq $nrep); do
+            t=$(cd $rundir && $builddir/$layout/pennant $prob.pnt |
+                    sed -n 's/^hydro cycle run time= *//p')
+            if [ -z "$best" ] || awk "BEGIN {exit !($t < $best)}"; then
+                best=$t
+            fi
+        done
+        eval time_$layout=$best
+    done
+    printf "%-16s %14.6e %14.6e %8.3f\n" $prob $time_aos $time_soa \
+            $(awk "BEGIN {print $time_aos / $time_soa}")
+done